@@ -42,7 +42,11 @@ end
 
 include("types.jl")
 export fmiEvaluateRes
+export fmiEvaluateResBatch
+export fmiEvaluateJacobianBatch
+export fmiGetNNTelemetry
 export fmiEvaluateEq
+export fmiEvaluateEqBatch
 export EqInfo
 export MinMaxBoundaryValues
 export ProfilingInfo
@@ -50,6 +54,8 @@ export OMOptions
 export DataGenOptions
 export RandomMethod
 export RandomWalkMethod
+export OrtOptions
+export ResidualCheckOptions
 export getInnerEquations
 export getIterationVars
 export getMinMax
@@ -64,8 +70,20 @@ export generateFMU
 export addEqInterface2FMU
 include("genTrainData.jl")
 export generateTrainingData
+export readSampleFile
+export fmiSampleEq
 include("integrateNN.jl")
 export buildWithOnnx
+include("residualLog.jl")
+export readResidualLog
+export convertResidualLog
+include("domainGate.jl")
+export writeDomainIndex
+include("aotCodegen.jl")
+export readDenseNetwork
+export aotModelCode
+include("quantize.jl")
+export quantizeOnnx
 include("main.jl")
 export main
 
@@ -0,0 +1,558 @@
+#
+# Copyright (c) 2023 Andreas Heuermann
+#
+# This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+#
+
+# Ahead-of-time translation of dense feed-forward ONNX models into C.
+# Supports the same subset of ONNX as `onnxWrapper/denseMLP.c`.
+
+const ONNX_FLOAT = 1
+const ONNX_DOUBLE = 11
+
+"""
+Protobuf reader of bytes `pos:stop` of `data`.
+"""
+mutable struct ProtoReader
+  data::Vector{UInt8}
+  pos::Int
+  stop::Int
+end
+
+ProtoReader(data::Vector{UInt8}) = ProtoReader(data, 1, length(data))
+
+hasField(r::ProtoReader) = r.pos <= r.stop
+
+function readVarint(r::ProtoReader)::UInt64
+  value = UInt64(0)
+  shift = 0
+  while r.pos <= r.stop && shift < 64
+    byte = r.data[r.pos]
+    r.pos += 1
+    value |= UInt64(byte & 0x7f) << shift
+    if byte & 0x80 == 0
+      return value
+    end
+    shift += 7
+  end
+  error("Can't parse ONNX model: truncated varint.")
+end
+
+function readKey(r::ProtoReader)::Tuple{Int, Int}
+  key = readVarint(r)
+  return Int(key >> 3), Int(key & 0x07)
+end
+
+function readRaw(r::ProtoReader, len::Integer)::Vector{UInt8}
+  if r.pos + len - 1 > r.stop
+    error("Can't parse ONNX model: truncated field.")
+  end
+  bytes = r.data[r.pos:r.pos+len-1]
+  r.pos += len
+  return bytes
+end
+
+function readSubMessage(r::ProtoReader)::ProtoReader
+  len = Int(readVarint(r))
+  if r.pos + len - 1 > r.stop
+    error("Can't parse ONNX model: truncated field.")
+  end
+  sub = ProtoReader(r.data, r.pos, r.pos + len - 1)
+  r.pos += len
+  return sub
+end
+
+readBytes(r::ProtoReader) = readRaw(r, Int(readVarint(r)))
+readString(r::ProtoReader) = String(readBytes(r))
+
+function skipField(r::ProtoReader, wireType::Integer)
+  if wireType == 0
+    readVarint(r)
+  elseif wireType == 1
+    readRaw(r, 8)
+  elseif wireType == 2
+    readBytes(r)
+  elseif wireType == 5
+    readRaw(r, 4)
+  else
+    error("Can't parse ONNX model: wire type $(wireType) not supported.")
+  end
+end
+
+"""
+Little endian values of type `T` stored in `bytes`.
+"""
+function littleEndianValues(::Type{T}, bytes::Vector{UInt8})::Vector{T} where T
+  if length(bytes) % sizeof(T) != 0
+    error("Can't parse ONNX model: tensor data isn't a multiple of $(sizeof(T)) bytes.")
+  end
+  return ltoh.(collect(reinterpret(T, bytes)))
+end
+
+"""
+Initializer of ONNX graph. `values` is empty for element types other than float and double.
+"""
+struct OnnxTensor
+  dims::Vector{Int}
+  values::Vector{Float64}
+end
+
+struct OnnxNode
+  opType::String
+  inputs::Vector{String}
+  outputs::Vector{String}
+  attributes::Dict{String, Float64}
+end
+
+struct OnnxGraph
+  nodes::Vector{OnnxNode}
+  initializers::Dict{String, OnnxTensor}
+  inputs::Vector{Pair{String, Int}}   # Name => element type
+  outputs::Vector{Pair{String, Int}}
+end
+
+function parseTensor(r::ProtoReader)::Pair{String, OnnxTensor}
+  name = ""
+  dims = Int[]
+  dataType = 0
+  raw = nothing
+  floats = Float32[]
+  doubles = Float64[]
+  while hasField(r)
+    field, wireType = readKey(r)
+    if field == 1 && wireType == 0
+      push!(dims, Int(readVarint(r)))
+    elseif field == 1 && wireType == 2
+      sub = readSubMessage(r)
+      while hasField(sub)
+        push!(dims, Int(readVarint(sub)))
+      end
+    elseif field == 2 && wireType == 0
+      dataType = Int(readVarint(r))
+    elseif field == 4 && (wireType == 2 || wireType == 5)
+      append!(floats, littleEndianValues(Float32, wireType == 2 ? readBytes(r) : readRaw(r, 4)))
+    elseif field == 8 && wireType == 2
+      name = readString(r)
+    elseif field == 9 && wireType == 2
+      raw = readBytes(r)
+    elseif field == 10 && (wireType == 2 || wireType == 1)
+      append!(doubles, littleEndianValues(Float64, wireType == 2 ? readBytes(r) : readRaw(r, 8)))
+    else
+      skipField(r, wireType)
+    end
+  end
+
+  values = Float64[]
+  if dataType == ONNX_FLOAT
+    values = Float64.(raw === nothing ? floats : littleEndianValues(Float32, raw))
+  elseif dataType == ONNX_DOUBLE
+    values = raw === nothing ? doubles : littleEndianValues(Float64, raw)
+  end
+  if length(values) != prod(dims)
+    values = Float64[]
+  end
+  return name => OnnxTensor(dims, values)
+end
+
+function parseAttribute(r::ProtoReader)::Pair{String, Float64}
+  name = ""
+  value = NaN
+  while hasField(r)
+    field, wireType = readKey(r)
+    if field == 1 && wireType == 2
+      name = readString(r)
+    elseif field == 2 && wireType == 5
+      value = Float64(littleEndianValues(Float32, readRaw(r, 4))[1])
+    elseif field == 3 && wireType == 0
+      value = Float64(reinterpret(Int64, readVarint(r)))
+    else
+      skipField(r, wireType)
+    end
+  end
+  return name => value
+end
+
+function parseNode(r::ProtoReader)::OnnxNode
+  opType = ""
+  inputs = String[]
+  outputs = String[]
+  attributes = Dict{String, Float64}()
+  while hasField(r)
+    field, wireType = readKey(r)
+    if field == 1 && wireType == 2
+      push!(inputs, readString(r))
+    elseif field == 2 && wireType == 2
+      push!(outputs, readString(r))
+    elseif field == 4 && wireType == 2
+      opType = readString(r)
+    elseif field == 5 && wireType == 2
+      push!(attributes, parseAttribute(readSubMessage(r)))
+    else
+      skipField(r, wireType)
+    end
+  end
+  return OnnxNode(opType, inputs, outputs, attributes)
+end
+
+"""
+Name and element type of ValueInfoProto.
+"""
+function parseValueInfo(r::ProtoReader)::Pair{String, Int}
+  name = ""
+  elemType = 0
+  while hasField(r)
+    field, wireType = readKey(r)
+    if field == 1 && wireType == 2
+      name = readString(r)
+    elseif field == 2 && wireType == 2
+      # TypeProto.tensor_type.elem_type
+      typeProto = readSubMessage(r)
+      while hasField(typeProto)
+        field, wireType = readKey(typeProto)
+        if field == 1 && wireType == 2
+          tensorType = readSubMessage(typeProto)
+          while hasField(tensorType)
+            field, wireType = readKey(tensorType)
+            if field == 1 && wireType == 0
+              elemType = Int(readVarint(tensorType))
+            else
+              skipField(tensorType, wireType)
+            end
+          end
+        else
+          skipField(typeProto, wireType)
+        end
+      end
+    else
+      skipField(r, wireType)
+    end
+  end
+  return name => elemType
+end
+
+function parseGraph(r::ProtoReader)::OnnxGraph
+  graph = OnnxGraph(OnnxNode[], Dict{String, OnnxTensor}(), Pair{String, Int}[], Pair{String, Int}[])
+  while hasField(r)
+    field, wireType = readKey(r)
+    if field == 1 && wireType == 2
+      push!(graph.nodes, parseNode(readSubMessage(r)))
+    elseif field == 5 && wireType == 2
+      push!(graph.initializers, parseTensor(readSubMessage(r)))
+    elseif field == 11 && wireType == 2
+      push!(graph.inputs, parseValueInfo(readSubMessage(r)))
+    elseif field == 12 && wireType == 2
+      push!(graph.outputs, parseValueInfo(readSubMessage(r)))
+    else
+      skipField(r, wireType)
+    end
+  end
+  return graph
+end
+
+"""
+Dense layer `activation(weights * x + bias)`.
+"""
+mutable struct DenseLayer
+  weights::Matrix{Float64}
+  bias::Vector{Float64}
+  activation::Symbol      # :none, :tanh, :relu or :sigmoid
+end
+
+"""
+Chain of dense layers evaluated in float or double precision.
+"""
+struct DenseNetwork
+  layers::Vector{DenseLayer}
+  isDouble::Bool
+end
+
+"""
+Dense layer of Gemm or MatMul node. Returns reason if node isn't supported.
+"""
+function denseLayer(graph::OnnxGraph, node::OnnxNode)::Union{DenseLayer, String}
+  isGemm = node.opType == "Gemm"
+  B = length(node.inputs) > 1 ? get(graph.initializers, node.inputs[2], nothing) : nothing
+  C = isGemm && length(node.inputs) > 2 ? get(graph.initializers, node.inputs[3], nothing) : nothing
+  transB = isGemm && get(node.attributes, "transB", 0.0) != 0
+  alpha = isGemm ? get(node.attributes, "alpha", 1.0) : 1.0
+  beta = isGemm ? get(node.attributes, "beta", 1.0) : 1.0
+
+  if B === nothing || length(B.dims) != 2 || isempty(B.values)
+    return "weights are no 2D initializer"
+  end
+  if isGemm && get(node.attributes, "transA", 0.0) != 0
+    return "Gemm with transA"
+  end
+  if isGemm && length(node.inputs) > 2 && (C === nothing || isempty(C.values))
+    return "bias of Gemm is no initializer"
+  end
+
+  nIn = transB ? B.dims[2] : B.dims[1]
+  nOut = transB ? B.dims[1] : B.dims[2]
+  if C !== nothing && !in(length(C.values), (1, nOut))
+    return "bias of Gemm can't be broadcast"
+  end
+
+  # Initializers are row-major
+  weights = alpha .* (transB ? permutedims(reshape(B.values, nIn, nOut)) : reshape(B.values, nOut, nIn))
+  bias = C === nothing ? zeros(nOut) : beta .* (length(C.values) == 1 ? fill(C.values[1], nOut) : C.values)
+  return DenseLayer(weights, bias, :none)
+end
+
+"""
+Translate chain of ONNX nodes from `input` to `output` into dense layers.
+Returns reason if graph isn't supported.
+"""
+function denseLayers(graph::OnnxGraph, input::String, output::String)::Union{Vector{DenseLayer}, String}
+  layers = DenseLayer[]
+  current = input
+  layerOpen = false         # Last layer can still get bias or activation
+  activations = Dict("Tanh" => :tanh, "Relu" => :relu, "Sigmoid" => :sigmoid)
+
+  for node in graph.nodes
+    if length(node.outputs) != 1 || isempty(node.inputs)
+      return "node with multiple outputs or without inputs"
+    end
+    consumesCurrent = node.inputs[1] == current
+    if node.opType == "Add" && length(node.inputs) == 2 && !consumesCurrent
+      # Bias can be first input of Add
+      consumesCurrent = node.inputs[2] == current
+    end
+    if !consumesCurrent
+      return "graph is no chain of layers"
+    end
+
+    if node.opType == "Gemm" || node.opType == "MatMul"
+      layer = denseLayer(graph, node)
+      if layer isa String
+        return layer
+      end
+      push!(layers, layer)
+      layerOpen = true
+    elseif node.opType == "Add"
+      biasName = node.inputs[1] == current ? node.inputs[2] : node.inputs[1]
+      bias = get(graph.initializers, biasName, nothing)
+      if !layerOpen || last(layers).activation != :none
+        return "Add is no bias of a dense layer"
+      end
+      nOut = length(last(layers).bias)
+      if bias === nothing || !in(length(bias.values), (1, nOut))
+        return "bias of Add is no initializer or can't be broadcast"
+      end
+      last(layers).bias .+= length(bias.values) == 1 ? bias.values[1] : bias.values
+    elseif haskey(activations, node.opType)
+      if !layerOpen
+        return "activation without dense layer"
+      end
+      last(layers).activation = activations[node.opType]
+      layerOpen = false
+    elseif node.opType != "Identity"
+      return "unsupported operator $(node.opType)"
+    end
+    current = node.outputs[1]
+  end
+
+  if current != output
+    return "graph output isn't produced by last node"
+  end
+  if isempty(layers)
+    return "no dense layer"
+  end
+  return layers
+end
+
+"""
+    readDenseNetwork(onnxFile, nInputs, nOutputs)
+
+Read dense feed-forward network from ONNX model.
+
+Supported are models with one float or double input and output and a chain
+of `Gemm` or `MatMul` nodes with constant weights, optionally followed by
+`Add` of a constant bias and a `Tanh`, `Relu` or `Sigmoid` activation.
+
+# Arguments
+  - `onnxFile::String`:   Path to ONNX model.
+  - `nInputs::Integer`:   Expected number of inputs.
+  - `nOutputs::Integer`:  Expected number of outputs.
+
+# Returns
+  - `DenseNetwork` or reason why the model isn't supported as `String`.
+"""
+function readDenseNetwork(onnxFile::String,
+                          nInputs::Integer,
+                          nOutputs::Integer)::Union{DenseNetwork, String}
+  model = ProtoReader(read(onnxFile))
+  graph = nothing
+  try
+    while hasField(model)
+      field, wireType = readKey(model)
+      if field == 7 && wireType == 2
+        graph = parseGraph(readSubMessage(model))
+      else
+        skipField(model, wireType)
+      end
+    end
+  catch err
+    return sprint(showerror, err)
+  end
+  if graph === nothing
+    return "model has no graph"
+  end
+
+  # Graph inputs can list initializers, the remaining one is the model input
+  inputs = filter(input -> !haskey(graph.initializers, first(input)), graph.inputs)
+  if length(inputs) != 1 || length(graph.outputs) != 1
+    return "model needs exactly one input and one output"
+  end
+  input = only(inputs)
+  if !in(last(input), (ONNX_FLOAT, ONNX_DOUBLE))
+    return "element type isn't float or double"
+  end
+
+  layers = denseLayers(graph, first(input), first(only(graph.outputs)))
+  if layers isa String
+    return layers
+  end
+  if size(first(layers).weights, 2) != nInputs || size(last(layers).weights, 1) != nOutputs
+    return "number of inputs or outputs doesn't match"
+  end
+  for (prev, layer) in zip(layers[1:end-1], layers[2:end])
+    if size(layer.weights, 2) != size(prev.weights, 1)
+      return "shapes of consecutive layers don't match"
+    end
+  end
+  return DenseNetwork(layers, last(input) == ONNX_DOUBLE)
+end
+
+"""
+Apply activation of dense layer to `x`.
+"""
+function activate(x::T, activation::Symbol)::T where T <: AbstractFloat
+  if activation == :tanh
+    return tanh(x)
+  elseif activation == :relu
+    return max(x, zero(T))
+  elseif activation == :sigmoid
+    return one(T) / (one(T) + exp(-x))
+  end
+  return x
+end
+
+"""
+    evalDenseNetwork(network, x)
+
+Evaluate `network` for input vector `x` in the element type of the ONNX model.
+"""
+function evalDenseNetwork(network::DenseNetwork, x::AbstractVector{<:Real})::Vector{Float64}
+  T = network.isDouble ? Float64 : Float32
+  a = T.(x)
+  for layer in network.layers
+    a = activate.(T.(layer.weights) * a .+ T.(layer.bias), layer.activation)
+  end
+  return Float64.(a)
+end
+
+"""
+    aotModelCode(network, functionName)
+
+Generate C code of dense network `network`.
+
+Weights and biases are `static const` arrays and all loop bounds are
+compile-time constants, so the compiler can unroll and vectorize the loops.
+The generated function `static void <functionName>(const double* input, double* output)`
+computes in the element type of the ONNX model.
+
+# Arguments
+  - `network::DenseNetwork`:  Network read by `readDenseNetwork`.
+  - `functionName::String`:   Name of generated C function.
+
+# Returns
+  - `String`: Generated C code.
+"""
+function aotModelCode(network::DenseNetwork, functionName::String)::String
+  cType = network.isDouble ? "double" : "float"
+  literal(x) = network.isDouble ? Printf.@sprintf("%.17e", x) : Printf.@sprintf("%.9ef", Float32(x))
+  activation = Dict(:none => "sum",
+                    :tanh => network.isDouble ? "tanh(sum)" : "tanhf(sum)",
+                    :relu => "sum > 0 ? sum : 0",
+                    :sigmoid => network.isDouble ? "1.0 / (1.0 + exp(-sum))" : "1.0f / (1.0f + expf(-sum))")
+  layers = network.layers
+  for layer in layers
+    if !all(isfinite, layer.weights) || !all(isfinite, layer.bias)
+      error("Weights of $(functionName) aren't finite.")
+    end
+  end
+  sizes = vcat(size(first(layers).weights, 2), [size(layer.weights, 1) for layer in layers])
+
+  arrays = ""
+  for (l, layer) in enumerate(layers)
+    nOut, nIn = size(layer.weights)
+    rows = join(["  {" * join(literal.(layer.weights[i, :]), ", ") * "}" for i in 1:nOut], ",$EOL")
+    arrays *= """
+      static const $cType $(functionName)_w$(l-1)[$nOut][$nIn] = {
+      $rows
+      };
+      static const $cType $(functionName)_b$(l-1)[$nOut] = {$(join(literal.(layer.bias), ", "))};
+      """
+  end
+
+  body = ""
+  for (l, layer) in enumerate(layers)
+    nOut, nIn = size(layer.weights)
+    body *= """
+        for (int i = 0; i < $nOut; i++) {
+          $cType sum = $(functionName)_b$(l-1)[i];
+          for (int j = 0; j < $nIn; j++) {
+            sum += $(functionName)_w$(l-1)[i][j] * a$(l-1)[j];
+          }
+          a$(l)[i] = $(activation[layer.activation]);
+        }
+      """
+  end
+
+  code = """
+    /* Network compiled from ONNX model: $(join(sizes, " -> ")), $cType */
+    $(arrays)static void $(functionName)(const double* input, double* output) {
+    $(join(["  $cType a$(l-1)[$(n)];" for (l, n) in enumerate(sizes)], EOL))
+      for (int j = 0; j < $(first(sizes)); j++) {
+        a0[j] = ($cType) input[j];
+      }
+    $(body)  for (int i = 0; i < $(last(sizes)); i++) {
+        output[i] = (double) a$(length(layers))[i];
+      }
+    }
+    """
+  return code
+end
+
+"""
+    aotParityInputs(csvFile, inputNames; nSamples=100)
+
+Read up to `nSamples` evenly spaced rows of input columns `inputNames` from
+training data `csvFile` as C initializer of a row-major `double` array.
+
+# Returns
+  - Number of rows and C initializer as `Tuple{Int, String}`.
+"""
+function aotParityInputs(csvFile::String,
+                         inputNames::Array{String};
+                         nSamples::Integer = 100)::Tuple{Int, String}
+  df = CSV.read(csvFile, DataFrames.DataFrame; ntasks=1)
+  X = Matrix{Float64}(df[:, inputNames])
+  rows = unique(round.(Int, range(1, size(X, 1), length=min(nSamples, size(X, 1)))))
+  values = [Printf.@sprintf("%.17e", X[row, col]) for row in rows for col in eachindex(inputNames)]
+  return length(rows), "{" * join(values, ", ") * "}"
+end
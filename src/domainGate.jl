@@ -0,0 +1,110 @@
+#
+# Copyright (c) 2023 Andreas Heuermann
+#
+# This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+#
+
+const DOMAIN_INDEX_MAGIC = "NLSNNDOM"
+const DOMAIN_INDEX_VERSION = UInt32(1)
+
+"""
+    domainCellHash(x, min, max, nBins)
+
+64 bit FNV-1a hash of grid cell coordinates of `x`.
+Has to match `cellHash` in `onnxWrapper/domainGate.c`.
+
+Returns `nothing` if `x` is outside of `[min, max]`.
+"""
+function domainCellHash(x::AbstractVector{Float64},
+                        min::AbstractVector{Float64},
+                        max::AbstractVector{Float64},
+                        nBins::Integer)::Union{UInt64, Nothing}
+  h = 0xcbf29ce484222325
+  for i in eachindex(x)
+    if !(x[i] >= min[i] && x[i] <= max[i])
+      return nothing
+    end
+    width = max[i] - min[i]
+    cell = UInt32(0)
+    if width > 0
+      c = floor((x[i] - min[i]) / width * nBins)
+      cell = c >= nBins ? UInt32(nBins - 1) : UInt32(c)
+    end
+    for b in 0:3
+      h = xor(h, UInt64((cell >> (8*b)) & 0xff))
+      h *= 0x00000100000001b3
+    end
+  end
+  return h
+end
+
+"""
+    writeDomainIndex(csvFile, usingVars, boundary, outFile; nBins=16)
+
+Write grid occupancy index of training data for the domain gate of an ONNX FMU.
+
+The box `boundary` of the inputs is divided into `nBins` cells in each
+dimension. All cells containing at least one training point are saved.
+During simulation inputs in empty cells are passed to the non-linear solver
+without evaluating the ONNX model.
+
+# Arguments
+  - `csvFile::String`:                          Training data with columns for each of `usingVars`.
+  - `usingVars::Array{String}`:                 Names of input variables.
+  - `boundary::MinMaxBoundaryValues{Float64}`:  Minimum and maximum values of `usingVars`.
+  - `outFile::String`:                          Path to domain index file.
+
+# Keywords
+  - `nBins::Integer`:                           Number of grid cells in each dimension.
+
+# Returns
+  - Number of occupied cells.
+
+See also [`buildWithOnnx`](@ref).
+"""
+function writeDomainIndex(csvFile::String,
+                          usingVars::Array{String},
+                          boundary::MinMaxBoundaryValues{Float64},
+                          outFile::String;
+                          nBins::Integer = 16)::Integer
+  if nBins < 1
+    error("Number of bins has to be positive.")
+  end
+  df = CSV.read(csvFile, DataFrames.DataFrame; ntasks=1)
+  X = Matrix{Float64}(df[:, usingVars])
+
+  cells = UInt64[]
+  for row in eachrow(X)
+    h = domainCellHash(row, boundary.min, boundary.max, nBins)
+    if h !== nothing
+      push!(cells, h)
+    end
+  end
+  cells = unique(sort(cells))
+
+  open(outFile, "w") do io
+    write(io, DOMAIN_INDEX_MAGIC)
+    write(io, DOMAIN_INDEX_VERSION)
+    write(io, UInt32(length(usingVars)))
+    write(io, UInt32(nBins))
+    write(io, Float64.(boundary.min))
+    write(io, Float64.(boundary.max))
+    write(io, UInt64(length(cells)))
+    write(io, cells)
+  end
+
+  return length(cells)
+end
@@ -59,6 +59,156 @@ function fmiEvaluateEq(comp::FMICore.FMU2Component, eq::Integer)::fmi2Status
   return status
 end
 
+"""
+    fmiEvaluateEqBatch(fmu, eqNumber, vrInputs, vrOutputs, inputs; startValues=nothing, time=nothing)
+
+Evaluate equation `eqNumber` for a batch of samples in one call of
+`fmi2Status myfmi2EvaluateEqBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples, const fmi2ValueReference vrInputs[], const size_t nInputs, const fmi2ValueReference vrOutputs[], const size_t nOutputs, const double* time, const double* inputs, const double* startValues, double* outputs, fmi2Status* status)`.
+
+Setting inputs, evaluating the equation and reading outputs is done inside the
+FMU for all samples, avoiding one `ccall` and FMI round-trip per sample.
+
+# Arguments
+  - `fmu::FMICore.FMU2`: FMU object containing C void pointer to FMU component.
+  - `eqNumber::Int`: Equation index specifying equation to evaluate.
+  - `vrInputs::AbstractVector{<:Integer}`: Value references of input variables.
+  - `vrOutputs::AbstractVector{<:Integer}`: Value references of output variables.
+  - `inputs::Matrix{Float64}`: Input values with one column per sample.
+
+# Keywords
+  - `startValues::Union{Matrix{Float64}, Nothing}`: Start values of output
+    variables with one column per sample. If `nothing` every sample starts from
+    the solution of the previous sample.
+  - `time::Union{Vector{Float64}, Nothing}`: Time of each sample or `nothing` to
+    keep current time.
+
+# Returns
+  - Status of Libdl.ccall for `:myfmi2EvaluateEqBatch`, `fmi2Discard` if some
+    samples failed.
+  - Output values with one column per sample.
+  - Status of each sample.
+"""
+function fmiEvaluateEqBatch(fmu::FMIImport.FMU2,
+                            eqNumber::Integer,
+                            vrInputs::AbstractVector{<:Integer},
+                            vrOutputs::AbstractVector{<:Integer},
+                            inputs::Matrix{Float64};
+                            startValues::Union{Matrix{Float64}, Nothing} = nothing,
+                            time::Union{Vector{Float64}, Nothing} = nothing)::Tuple{fmi2Status, Matrix{Float64}, Vector{fmi2Status}}
+  return fmiEvaluateEqBatch(fmu.components[1], eqNumber, vrInputs, vrOutputs, inputs; startValues=startValues, time=time)
+end
+
+function fmiEvaluateEqBatch(comp::FMICore.FMU2Component,
+                            eqNumber::Integer,
+                            vrInputs::AbstractVector{<:Integer},
+                            vrOutputs::AbstractVector{<:Integer},
+                            inputs::Matrix{Float64};
+                            startValues::Union{Matrix{Float64}, Nothing} = nothing,
+                            time::Union{Vector{Float64}, Nothing} = nothing)::Tuple{fmi2Status, Matrix{Float64}, Vector{fmi2Status}}
+
+  @assert eqNumber>=0 "Equation index has to be non-negative!"
+  nInputs = length(vrInputs)
+  nOutputs = length(vrOutputs)
+  nSamples = size(inputs, 2)
+  @assert size(inputs, 1) == nInputs "Number of rows of inputs and vrInputs doesn't match"
+  @assert startValues === nothing || size(startValues) == (nOutputs, nSamples) "Size of startValues has to be ($nOutputs, $nSamples)"
+  @assert time === nothing || length(time) == nSamples "Length of time and number of samples doesn't match"
+
+  fmiEvaluateEqBatch = Libdl.dlsym(comp.fmu.libHandle, :myfmi2EvaluateEqBatch)
+
+  outputs = zeros(Float64, nOutputs, nSamples)
+  sampleStatus = Array{fmi2Status}(undef, nSamples)
+
+  status = ccall(fmiEvaluateEqBatch,
+                 Cuint,
+                 (Ptr{Nothing}, Csize_t, Csize_t, Ptr{Cuint}, Csize_t, Ptr{Cuint}, Csize_t, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cuint}),
+                 comp.compAddr, Csize_t(eqNumber), Csize_t(nSamples),
+                 Vector{Cuint}(vrInputs), Csize_t(nInputs), Vector{Cuint}(vrOutputs), Csize_t(nOutputs),
+                 time === nothing ? C_NULL : time, inputs, startValues === nothing ? C_NULL : startValues,
+                 outputs, sampleStatus)
+
+  return status, outputs, sampleStatus
+end
+
+"""
+    fmiSampleEq(fmu, eqNumber, fileName, nSamples, vrInputs, inMin, inMax, vrOutputs, colNames; method, timeBounds=nothing, seed=rand(Culong))
+
+Sample data points of equation `eqNumber` inside the FMU and stream them into
+binary sample file `fileName` by calling
+`fmi2Status myfmi2SampleEq(fmi2Component c, const size_t eqNumber, const char* fileName, const size_t nSamples, const int method, const double delta, const unsigned long seed, const fmi2ValueReference vrInputs[], const size_t nInputs, const double* inMin, const double* inMax, const fmi2ValueReference vrOutputs[], const size_t nOutputs, const double* timeBounds, const char** colNames, size_t* nGenerated)`.
+
+Uses the same sampling and failure rules as [`generateTrainingData`](@ref).
+
+# Arguments
+  - `fmu::FMICore.FMU2`: FMU object containing C void pointer to FMU component.
+  - `eqNumber::Int`: Equation index specifying equation to sample.
+  - `fileName::String`: Path of binary sample file.
+  - `nSamples::Integer`: Number of samples to generate.
+  - `vrInputs::AbstractVector{<:Integer}`: Value references of input variables.
+  - `inMin::Vector{Float64}`: Minimum of input variables.
+  - `inMax::Vector{Float64}`: Maximum of input variables.
+  - `vrOutputs::AbstractVector{<:Integer}`: Value references of output variables.
+  - `colNames::Vector{String}`: Column names of sample file, `time` (if time is
+    an input), input and output variables.
+
+# Keywords
+  - `method::DataGenerationMethod`: `RandomMethod` or `RandomWalkMethod`.
+  - `timeBounds::Union{Tuple{Float64,Float64}, Nothing}`: Minimum and maximum
+    time if time is an input variable, otherwise `nothing`.
+  - `seed::Culong`: Seed of random number generator.
+
+# Returns
+  - Status of Libdl.ccall for `:myfmi2SampleEq`, `fmi2Warning` if sampling
+    stopped after too many failures.
+  - Number of generated samples.
+
+See also [`readSampleFile`](@ref).
+"""
+function fmiSampleEq(fmu::FMIImport.FMU2, eqNumber::Integer, fileName::String, nSamples::Integer,
+                     vrInputs::AbstractVector{<:Integer}, inMin::Vector{Float64}, inMax::Vector{Float64},
+                     vrOutputs::AbstractVector{<:Integer}, colNames::Vector{String};
+                     method::DataGenerationMethod,
+                     timeBounds::Union{Tuple{Float64,Float64}, Nothing} = nothing,
+                     seed::Culong = rand(Culong))::Tuple{fmi2Status, Int}
+  return fmiSampleEq(fmu.components[1], eqNumber, fileName, nSamples, vrInputs, inMin, inMax, vrOutputs, colNames;
+                     method=method, timeBounds=timeBounds, seed=seed)
+end
+
+function fmiSampleEq(comp::FMICore.FMU2Component, eqNumber::Integer, fileName::String, nSamples::Integer,
+                     vrInputs::AbstractVector{<:Integer}, inMin::Vector{Float64}, inMax::Vector{Float64},
+                     vrOutputs::AbstractVector{<:Integer}, colNames::Vector{String};
+                     method::DataGenerationMethod,
+                     timeBounds::Union{Tuple{Float64,Float64}, Nothing} = nothing,
+                     seed::Culong = rand(Culong))::Tuple{fmi2Status, Int}
+
+  @assert eqNumber>=0 "Equation index has to be non-negative!"
+  @assert length(inMin) == length(inMax) == length(vrInputs) "Length of inMin, inMax and vrInputs doesn't match"
+  @assert length(colNames) == (timeBounds !== nothing) + length(vrInputs) + length(vrOutputs) "Wrong number of column names"
+
+  local methodId, delta
+  if typeof(method) === RandomMethod
+    methodId, delta = 0, 0.0
+  elseif typeof(method) === RandomWalkMethod
+    methodId, delta = 1, method.delta
+  else
+    error("Unknown method '$(typeof(method))'")
+  end
+
+  fmiSampleEq = Libdl.dlsym(comp.fmu.libHandle, :myfmi2SampleEq)
+
+  nGenerated = Ref{Csize_t}(0)
+  status = ccall(fmiSampleEq,
+                 Cuint,
+                 (Ptr{Nothing}, Csize_t, Cstring, Csize_t, Cint, Cdouble, Culong,
+                  Ptr{Cuint}, Csize_t, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cuint}, Csize_t,
+                  Ptr{Cdouble}, Ptr{Cstring}, Ptr{Csize_t}),
+                 comp.compAddr, Csize_t(eqNumber), fileName, Csize_t(nSamples), Cint(methodId), delta, seed,
+                 Vector{Cuint}(vrInputs), Csize_t(length(vrInputs)), inMin, inMax, Vector{Cuint}(vrOutputs), Csize_t(length(vrOutputs)),
+                 timeBounds === nothing ? C_NULL : [timeBounds...], colNames, nGenerated)
+
+  return status, Int(nGenerated[])
+end
+
 """
     fmiEvaluateRes(fmu, eqNumber, x)
 
@@ -134,3 +284,181 @@ function fmiEvaluateJacobian(comp::FMICore.FMU2Component, eqNumber::Integer, x::
                  comp.compAddr, eqCtype, x, jac)
   return status, jac
 end
+
+"""
+    fmiEvaluateResBatch(fmu, eqNumber, vrInputs, inputs, x; time=nothing)
+
+Evaluate residual function of equation `eqNumber` for a batch of samples in one
+call of
+`fmi2Status myfmi2EvaluateResBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples, const fmi2ValueReference vrInputs[], const size_t nInputs, const double* time, const double* inputs, const double* x, const size_t nX, double* res, fmi2Status* status)`.
+
+Use it for residual validation or physics-informed loss terms over a whole data set.
+
+# Arguments
+  - `fmu::FMICore.FMU2`: FMU object containing C void pointer to FMU component.
+  - `eqNumber::Int`: Equation index specifying residual equation to evaluate.
+  - `vrInputs::AbstractVector{<:Integer}`: Value references of input variables.
+  - `inputs::Matrix{Float64}`: Input values with one column per sample.
+  - `x::Matrix{Float64}`: Iteration variables with one column per sample.
+
+# Keywords
+  - `time::Union{Vector{Float64}, Nothing}`: Time of each sample or `nothing` to
+    keep current time.
+
+# Returns
+  - Status of Libdl.ccall for `:myfmi2EvaluateResBatch`, `fmi2Discard` if some
+    samples failed, `fmi2Error` if the number of rows of `x` isn't the size of
+    the non-linear system.
+  - Residual values with one column per sample.
+  - Status of each sample.
+"""
+function fmiEvaluateResBatch(fmu::FMIImport.FMU2,
+                             eqNumber::Integer,
+                             vrInputs::AbstractVector{<:Integer},
+                             inputs::Matrix{Float64},
+                             x::Matrix{Float64};
+                             time::Union{Vector{Float64}, Nothing} = nothing)::Tuple{fmi2Status, Matrix{Float64}, Vector{fmi2Status}}
+  return fmiEvaluateResBatch(fmu.components[1], eqNumber, vrInputs, inputs, x; time=time)
+end
+
+function fmiEvaluateResBatch(comp::FMICore.FMU2Component,
+                             eqNumber::Integer,
+                             vrInputs::AbstractVector{<:Integer},
+                             inputs::Matrix{Float64},
+                             x::Matrix{Float64};
+                             time::Union{Vector{Float64}, Nothing} = nothing)::Tuple{fmi2Status, Matrix{Float64}, Vector{fmi2Status}}
+
+  @assert eqNumber>=0 "Residual index has to be non-negative!"
+  nX, nSamples = size(x)
+  @assert size(inputs) == (length(vrInputs), nSamples) "Size of inputs has to be ($(length(vrInputs)), $nSamples)"
+  @assert time === nothing || length(time) == nSamples "Length of time and number of samples doesn't match"
+
+  fmiEvaluateResBatch = Libdl.dlsym(comp.fmu.libHandle, :myfmi2EvaluateResBatch)
+
+  res = Array{Float64}(undef, nX, nSamples)
+  sampleStatus = Array{fmi2Status}(undef, nSamples)
+
+  status = ccall(fmiEvaluateResBatch,
+                 Cuint,
+                 (Ptr{Nothing}, Csize_t, Csize_t, Ptr{Cuint}, Csize_t, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cdouble}, Csize_t, Ptr{Cdouble}, Ptr{Cuint}),
+                 comp.compAddr, Csize_t(eqNumber), Csize_t(nSamples),
+                 Vector{Cuint}(vrInputs), Csize_t(length(vrInputs)),
+                 time === nothing ? C_NULL : time, inputs,
+                 x, Csize_t(nX), res, sampleStatus)
+
+  return status, res, sampleStatus
+end
+
+"""
+    fmiEvaluateJacobianBatch(fmu, eqNumber, vrInputs, inputs, x; time=nothing)
+
+Evaluate residuals and Jacobians of non-linear equation `eqNumber` at a batch of
+points in one call of
+`fmi2Status myfmi2EvaluateJacobianBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples, const fmi2ValueReference vrInputs[], const size_t nInputs, const double* time, const double* inputs, const double* x, const size_t nX, double* res, double* jac, fmi2Status* status)`.
+
+The Jacobian is evaluated at the given points for any NLS method. The
+analytical Jacobian of the model is used if the non-linear system has one,
+otherwise colored forward differences of the residual function.
+
+# Arguments
+  - `fmu::FMICore.FMU2`: FMU object containing C void pointer to FMU component.
+  - `eqNumber::Int`: Equation index of non-linear equation.
+  - `vrInputs::AbstractVector{<:Integer}`: Value references of input variables.
+  - `inputs::Matrix{Float64}`: Input values with one column per sample.
+  - `x::Matrix{Float64}`: Iteration variables with one column per sample.
+
+# Keywords
+  - `time::Union{Vector{Float64}, Nothing}`: Time of each sample or `nothing` to
+    keep current time.
+
+# Returns
+  - Status of Libdl.ccall for `:myfmi2EvaluateJacobianBatch`, `fmi2Discard` if
+    some samples failed, `fmi2Error` if the number of rows of `x` isn't the
+    size of the non-linear system.
+  - Residual values with one column per sample.
+  - Jacobians of size `(nX, nX, nSamples)`, `jac[i,j,k]` is the derivative of
+    residual `i` with respect to `x[j]` at sample `k`.
+  - Status of each sample.
+"""
+function fmiEvaluateJacobianBatch(fmu::FMIImport.FMU2,
+                                  eqNumber::Integer,
+                                  vrInputs::AbstractVector{<:Integer},
+                                  inputs::Matrix{Float64},
+                                  x::Matrix{Float64};
+                                  time::Union{Vector{Float64}, Nothing} = nothing)::Tuple{fmi2Status, Matrix{Float64}, Array{Float64, 3}, Vector{fmi2Status}}
+  return fmiEvaluateJacobianBatch(fmu.components[1], eqNumber, vrInputs, inputs, x; time=time)
+end
+
+function fmiEvaluateJacobianBatch(comp::FMICore.FMU2Component,
+                                  eqNumber::Integer,
+                                  vrInputs::AbstractVector{<:Integer},
+                                  inputs::Matrix{Float64},
+                                  x::Matrix{Float64};
+                                  time::Union{Vector{Float64}, Nothing} = nothing)::Tuple{fmi2Status, Matrix{Float64}, Array{Float64, 3}, Vector{fmi2Status}}
+
+  @assert eqNumber>=0 "Equation index has to be non-negative!"
+  nX, nSamples = size(x)
+  @assert size(inputs) == (length(vrInputs), nSamples) "Size of inputs has to be ($(length(vrInputs)), $nSamples)"
+  @assert time === nothing || length(time) == nSamples "Length of time and number of samples doesn't match"
+
+  fmiEvaluateJacobianBatch = Libdl.dlsym(comp.fmu.libHandle, :myfmi2EvaluateJacobianBatch)
+
+  res = Array{Float64}(undef, nX, nSamples)
+  # Row-major Jacobians from C
+  jac = zeros(Float64, nX, nX, nSamples)
+  sampleStatus = Array{fmi2Status}(undef, nSamples)
+
+  status = ccall(fmiEvaluateJacobianBatch,
+                 Cuint,
+                 (Ptr{Nothing}, Csize_t, Csize_t, Ptr{Cuint}, Csize_t, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cdouble}, Csize_t, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cuint}),
+                 comp.compAddr, Csize_t(eqNumber), Csize_t(nSamples),
+                 Vector{Cuint}(vrInputs), Csize_t(length(vrInputs)),
+                 time === nothing ? C_NULL : time, inputs,
+                 x, Csize_t(nX), res, jac, sampleStatus)
+
+  return status, res, permutedims(jac, (2,1,3)), sampleStatus
+end
+
+const NN_TELEMETRY_NAMES = (:calls, :accepted, :unchecked, :rejectedResidual,
+                            :rejectedSingular, :rejectedDomain, :outOfBounds,
+                            :fallbacks, :fallbackTime, :extrapolated)
+
+"""
+    fmiGetNNTelemetry(fmu, eqNumber)
+
+Get acceptance telemetry of equation `eqNumber` replaced by an ONNX surrogate
+by calling
+`fmi2Status myfmi2GetNNTelemetry(fmi2Component c, const size_t eqNumber, double* values, const size_t nValues)`.
+
+Can be called during simulation to decide which equations are worth replacing.
+
+# Arguments
+  - `fmu::FMIImport.FMU2`: ONNX FMU object containing C void pointer to FMU component.
+  - `eqNumber::Int`: Index of replaced equation.
+
+# Returns
+  - Status of Libdl.ccall for `:myfmi2GetNNTelemetry`, `fmi2Error` if equation
+    `eqNumber` isn't replaced. All counters are zero if the session of the
+    surrogate isn't created yet.
+  - Named tuple with number of `calls`, `accepted`, `unchecked`, `rejectedResidual`,
+    `rejectedSingular`, `rejectedDomain`, `outOfBounds`, `fallbacks`,
+    `fallbackTime` in seconds and `extrapolated`.
+"""
+function fmiGetNNTelemetry(fmu::FMIImport.FMU2, eqNumber::Integer)::Tuple{fmi2Status, NamedTuple}
+  return fmiGetNNTelemetry(fmu.components[1], eqNumber)
+end
+
+function fmiGetNNTelemetry(comp::FMICore.FMU2Component, eqNumber::Integer)::Tuple{fmi2Status, NamedTuple}
+  @assert eqNumber>=0 "Equation index has to be non-negative!"
+
+  fmiGetNNTelemetry = Libdl.dlsym(comp.fmu.libHandle, :myfmi2GetNNTelemetry)
+
+  values = zeros(Float64, length(NN_TELEMETRY_NAMES))
+
+  status = ccall(fmiGetNNTelemetry,
+                 Cuint,
+                 (Ptr{Nothing}, Csize_t, Ptr{Cdouble}, Csize_t),
+                 comp.compAddr, Csize_t(eqNumber), values, Csize_t(length(values)))
+
+  return status, NamedTuple{NN_TELEMETRY_NAMES}(Tuple(values))
+end
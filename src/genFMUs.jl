@@ -130,7 +130,9 @@ function createSpecialInterface(modelname::String, tempDir::String, eqIndices::A
   forwardEquationBlock = ""
   for eqIndex in eqIndices
     forwardEquationBlock = forwardEquationBlock *
-      """extern void $(modelname)_eqFunction_$(eqIndex)(DATA* data, threadData_t *threadData);"""
+      """extern void $(modelname)_eqFunction_$(eqIndex)(DATA* data, threadData_t *threadData);
+      extern void residualFunc$(eqIndex)(RESIDUAL_USERDATA* userData, const double* xloc, double* res, const int* iflag);
+      """
   end
   cFileContent = replace(cFileContent, "<<FORWARD_EQUATION_BLOCK>>"=>forwardEquationBlock)
   equationCases = ""
@@ -143,6 +145,15 @@ function createSpecialInterface(modelname::String, tempDir::String, eqIndices::A
       """
   end
   cFileContent = replace(cFileContent, "<<EQUATION_CASES>>"=>equationCases)
+  equationFunctionCases = ""
+  for eqIndex in eqIndices
+    equationFunctionCases = equationFunctionCases *
+      """
+        case $(eqIndex):
+          return $(modelname)_eqFunction_$(eqIndex);
+      """
+  end
+  cFileContent = replace(cFileContent, "<<EQUATION_FUNCTION_CASES>>"=>equationFunctionCases)
   residualCases = ""
   for eqIndex in eqIndices
     residualCases = residualCases *
@@ -153,12 +164,28 @@ function createSpecialInterface(modelname::String, tempDir::String, eqIndices::A
       """
   end
   cFileContent = replace(cFileContent, "<<RESIDUAL_CASES>>"=>residualCases)
+  residualFunctionCases = ""
+  for eqIndex in eqIndices
+    residualFunctionCases = residualFunctionCases *
+      """
+        case $(eqIndex):
+          return residualFunc$(eqIndex);
+      """
+  end
+  cFileContent = replace(cFileContent, "<<RESIDUAL_FUNCTION_CASES>>"=>residualFunctionCases)
 
   # Create `special_interface.c`
   path = joinpath(tempDir,"FMU", "sources", "fmi-export", "special_interface.c")
   open(path, "w") do file
     write(file, cFileContent)
   end
+
+  # Copy `sample_file.h` and `sample_file.c` for myfmi2SampleEq
+  for ext in ["h", "c"]
+    cp(joinpath(@__DIR__, "templates", "sample_file.tpl.$(ext)"),
+       joinpath(tempDir, "FMU", "sources", "fmi-export", "sample_file.$(ext)"),
+       force=true)
+  end
 end
 
 
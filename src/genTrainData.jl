@@ -27,7 +27,8 @@ include("fmiExtensions.jl")
 Generate data points for given equation of FMU.
 
 Generate random inputs between `inMin` and `inMax`, evalaute equation and compute output.
-All input-output pairs are saved in `fname`.
+All input-output pairs are saved in `fname`, a CSV file or a binary sample file
+if `options.sampler` is `:fmu`.
 
 # Arguments
   - `fmu`:                                    Instance of the FMU struct.
@@ -93,6 +94,27 @@ function generateDataBatch(fmu,
     FMI.fmiEnterInitializationMode(fmu)
     FMI.fmiExitInitializationMode(fmu)
 
+    if options.sampler === :fmu
+      # Sample inside FMU and stream points to binary file
+      mkpath(dirname(fname))
+      vrInputs = FMI.fmiStringToValueReference(fmu.modelDescription, inputVars)
+      vrOutputs = FMI.fmiStringToValueReference(fmu.modelDescription, outputVars)
+      status, samplesGenerated = fmiSampleEq(fmu, eqId, fname, samples, vrInputs,
+                                             Vector{Float64}(inMin), Vector{Float64}(inMax), vrOutputs,
+                                             String.(col_names);
+                                             method = options.method,
+                                             timeBounds = useTime ? Float64.(timeBounds) : nothing)
+      if status == fmi2Error
+        error("Sampling equation $eqId into $fname failed.")
+      elseif samplesGenerated == 0
+        @warn "No initial solution found"
+      elseif samplesGenerated < samples
+        @warn "No solution found"
+      end
+      ProgressMeter.next!(p; step=samplesGenerated)
+      return
+    end
+
     # Generate training data
     row = Array{Float64}(undef, nVars)
     row_vr = FMI.fmiStringToValueReference(fmu.modelDescription, vcat(inputVars,outputVars))
@@ -246,7 +268,7 @@ function generateTrainingData(fmuPath::String,
     Threads.@threads for i in 1:parallelBatches  # enumerate not thread safe
       fmu = fmuArray[i]
       @debug "Thread $(Threads.threadid()) running FMU $i"
-      tempCsvFile = joinpath(workDir, "trainingData_eq_$(eqId)_batch_$(batchesDone+i).csv")
+      tempCsvFile = batchFileName(workDir, eqId, batchesDone+i, options)
       samples = nPerBatch
       if i == parallelBatches
         samples = options.n - nPerBatch*(options.nBatches-1)
@@ -264,8 +286,12 @@ function generateTrainingData(fmuPath::String,
   @info "Writing CSV file"
   mkpath(dirname(fname))
   for i = 1:options.nBatches
-    tempCsvFile = joinpath(workDir, "trainingData_eq_$(eqId)_batch_$(i).csv")
-    df = CSV.read(tempCsvFile, DataFrames.DataFrame; ntasks=1)
+    tempCsvFile = batchFileName(workDir, eqId, i, options)
+    if options.sampler === :fmu
+      df = readSampleFile(tempCsvFile)
+    else
+      df = CSV.read(tempCsvFile, DataFrames.DataFrame; ntasks=1)
+    end
     df[!, "Trace"] .= i
     if i==1
       CSV.write(fname, df; append=options.append)
@@ -280,6 +306,52 @@ function generateTrainingData(fmuPath::String,
   return fname
 end
 
+"""
+File name of data batch `i`, a binary sample file if sampling inside the FMU.
+"""
+function batchFileName(workDir::String, eqId::Int64, i::Integer, options::DataGenOptions)::String
+  ext = options.sampler === :fmu ? "bin" : "csv"
+  return joinpath(workDir, "trainingData_eq_$(eqId)_batch_$(i).$(ext)")
+end
+
+const SAMPLE_FILE_MAGIC = "NLSNNSMP"
+const SAMPLE_FILE_NAME_LEN = 64
+
+"""
+    readSampleFile(file)
+
+Read binary sample file written by `myfmi2SampleEq` during data generation
+with `DataGenOptions(sampler=:fmu)`.
+
+# Arguments
+  - `file::String`: Path to sample file.
+
+# Returns
+  - `DataFrames.DataFrame` with one column per sampled variable.
+
+See also [`DataGenOptions`](@ref), [`generateTrainingData`](@ref).
+"""
+function readSampleFile(file::String)::DataFrames.DataFrame
+  open(file, "r") do io
+    magic = String(read(io, length(SAMPLE_FILE_MAGIC)))
+    if magic != SAMPLE_FILE_MAGIC
+      error("File $(file) is not a sample file.")
+    end
+    version = read(io, UInt32)
+    if version != 1
+      error("Sample file version $(version) not supported.")
+    end
+    nCols = Int(read(io, UInt32))
+    nRows = Int(read(io, UInt64))
+    colNames = [rstrip(String(read(io, SAMPLE_FILE_NAME_LEN)), '\0') for _ in 1:nCols]
+
+    values = Matrix{Float64}(undef, nCols, nRows)
+    read!(io, values)
+
+    return DataFrames.DataFrame(permutedims(values), colNames)
+  end
+end
+
 """
 Evaluate equation `eqId` with `row` as inputs + start values
 """
@@ -26,11 +26,49 @@ struct Mapping
 end
 
 """
-    ortDataCode(equations, modelName, onnxNames; usePrevSol, maxRelError=1e-4)
+    ortOptionsCInitializer(options; cacheDir="NULL", residualLogFormat="RES_LOG_CSV", aotModel="NULL")
 
-Generates C code for initializing and deinitializing global ORT (Open Neural
-Network Exchange Runtime) structs, as well as defining residual function
-prototypes.
+Generates C initializer for `struct OrtWrapperOptions` from `options`.
+`cacheDir`, `residualLogFormat` and `aotModel` are C expressions for the
+optimized model cache directory, the residual log format and the compiled
+network of `backend=:aot`.
+"""
+function ortOptionsCInitializer(options::OrtOptions;
+                                cacheDir::String = "NULL",
+                                residualLogFormat::String = "RES_LOG_CSV",
+                                aotModel::String = "NULL")::String
+  graphOptimizationLevel = Dict(:disable => 0, :basic => 1, :extended => 2, :all => 99)
+  backend = Dict(:ort => "ONNX_BACKEND_ORT", :denseMLP => "ONNX_BACKEND_DENSE_MLP", :aot => "ONNX_BACKEND_AOT")
+  return "{" *
+         ".intraOpNumThreads = $(options.intraOpNumThreads), " *
+         ".interOpNumThreads = $(options.interOpNumThreads), " *
+         ".parallelExecution = $(Int(options.parallelExecution)), " *
+         ".graphOptimizationLevel = $(graphOptimizationLevel[options.graphOptimizationLevel]), " *
+         ".allowSpinning = $(Int(options.allowSpinning)), " *
+         ".enableMemPattern = $(Int(options.enableMemPattern)), " *
+         ".enableCpuMemArena = $(Int(options.enableCpuMemArena)), " *
+         ".fastPath = $(Int(options.fastPath)), " *
+         ".backend = $(backend[options.backend]), " *
+         ".aotModel = $(aotModel), " *
+         ".cacheDir = $(cacheDir), " *
+         ".evalCacheSize = $(options.evalCacheSize), " *
+         ".evalCacheQuantum = $(options.evalCacheQuantum), " *
+         ".residualLogFormat = $(residualLogFormat)" *
+         "}"
+end
+
+"""
+    ortDataCode(equations, modelName, onnxNames; usePrevSol, maxRelError=1e-4, ortOptions, ortNumThreads=1, modelCache=:none, residualLogFormat=:csv, residualCheck=ResidualCheckOptions(), domainGate=:none, warmStart=true, trainingData=String[], aotParitySamples=100, extrapolation=:none, sessionLoading=:eager, sessionLoaderThreads=2)
+
+Generates C code for initializing and deinitializing the ORT (Open Neural
+Network Exchange Runtime) state of each FMU instance, as well as defining
+residual function prototypes.
+The state is registered for the `DATA` of each instance in an FMU-owned list,
+so multiple instances of the FMU can be simulated in parallel threads. Instances share the ORT sessions of the same
+ONNX models. Depending on `sessionLoading` the ORT data of each equation is
+created during setup, on the first call of the equation or in background
+threads.
+Networks of equations with `backend=:aot` are translated into C functions.
 
 # Arguments:
   - `equations::Array{ProfilingInfo}`:  Array of ProfilingInfo objects
@@ -39,8 +77,20 @@ prototypes.
   - `onnxNames::Array{String}`:         Array of ONNX model file names.
 
 # Keyword Arguments
-  - `usePrevSol::Bool`:     Flag indicating whether to use previous solution.
-  - `maxRelError::Float64`: Maximum relative error (default: 1e-4).
+  - `usePrevSol::Bool`:               Flag indicating whether to use previous solution.
+  - `maxRelError::Float64`:           Maximum relative error (default: 1e-4).
+  - `ortOptions::Array{OrtOptions}`:  ORT session settings for each equation.
+  - `ortNumThreads::Integer`:         Number of threads of global thread pool shared by all equations (default: 1).
+  - `modelCache::Symbol`:             Location of optimized model cache. Allowed values: `:none`, `:resources`, `:user`.
+  - `residualLogFormat::Symbol`:      Format of residual log. Allowed values: `:csv`, `:binary`.
+  - `residualCheck::ResidualCheckOptions`: Policy when to check residuals of ONNX predictions.
+  - `domainGate::Symbol`:             Check inputs before evaluating ONNX models. Allowed values: `:none`, `:box`, `:grid`.
+  - `warmStart::Bool`:                Start non-linear solver from rejected NN prediction.
+  - `trainingData::Array{String}`:    CSV files with training data of each equation for parity checks of `backend=:aot`.
+  - `aotParitySamples::Integer`:      Number of training samples to compare compiled networks with ONNX Runtime.
+  - `extrapolation::Symbol`:          Predictor tried before ONNX models. Allowed values: `:none`, `:linear`, `:quadratic`.
+  - `sessionLoading::Symbol`:         When ORT data of equations is created. Allowed values: `:eager`, `:lazy`, `:background`.
+  - `sessionLoaderThreads::Integer`:  Number of threads creating sessions for `sessionLoading=:background`.
 
 # Returns:
   - `String`: Generated C code.
@@ -49,12 +99,51 @@ function ortDataCode(equations::Array{ProfilingInfo},
                      modelName::String,
                      onnxNames::Array{String};
                      usePrevSol::Bool,
-                     maxRelError::Float64 = 1e-4)::String
+                     maxRelError::Float64 = 1e-4,
+                     ortOptions::Array{OrtOptions} = fill(OrtOptions(), length(equations)),
+                     ortNumThreads::Integer = 1,
+                     modelCache::Symbol = :none,
+                     residualLogFormat::Symbol = :csv,
+                     residualCheck::ResidualCheckOptions = ResidualCheckOptions(),
+                     domainGate::Symbol = :none,
+                     warmStart::Bool = true,
+                     trainingData::Array{String} = String[],
+                     aotParitySamples::Integer = 100,
+                     extrapolation::Symbol = :none,
+                     sessionLoading::Symbol = :eager,
+                     sessionLoaderThreads::Integer = 2)::String
+
+  @assert length(ortOptions) == length(equations) "Length of ortOptions and equations doesn't match"
+  modelCacheLocation = Dict(:none => 0, :resources => 1, :user => 2)
+  if !haskey(modelCacheLocation, modelCache)
+    error("Model cache location $(modelCache) not supported. Has to be :none, :resources or :user.")
+  end
+  residualLogFormats = Dict(:csv => "RES_LOG_CSV", :binary => "RES_LOG_BINARY")
+  if !haskey(residualLogFormats, residualLogFormat)
+    error("Residual log format $(residualLogFormat) not supported. Has to be :csv or :binary.")
+  end
+  domainGateModes = Dict(:none => "DOMAIN_GATE_NONE", :box => "DOMAIN_GATE_BOX", :grid => "DOMAIN_GATE_GRID")
+  if !haskey(domainGateModes, domainGate)
+    error("Domain gate $(domainGate) not supported. Has to be :none, :box or :grid.")
+  end
+  extrapolationOrders = Dict(:none => "EXTRAPOLATION_NONE", :linear => "EXTRAPOLATION_LINEAR", :quadratic => "EXTRAPOLATION_QUADRATIC")
+  if !haskey(extrapolationOrders, extrapolation)
+    error("Extrapolation $(extrapolation) not supported. Has to be :none, :linear or :quadratic.")
+  end
+  sessionLoadingModes = Dict(:eager => "SESSION_LOADING_EAGER", :lazy => "SESSION_LOADING_LAZY", :background => "SESSION_LOADING_BACKGROUND")
+  if !haskey(sessionLoadingModes, sessionLoading)
+    error("Session loading $(sessionLoading) not supported. Has to be :eager, :lazy or :background.")
+  end
 
   resPrototypes = ""
+  aotCode = ""
   ortstructs = ""
-  initCalls = ""
-  deinitCalls = ""
+  initFunctions = ""
+  slotInits = ""
+  refreshCalls = ""
+  statsCalls = ""
+  telemetryCases = ""
+  latencyNames = "\"init\""
   nEq = length(equations)
   for (i,eq) in enumerate(equations)
     resPrototypes *= """
@@ -68,27 +157,129 @@ function ortDataCode(equations::Array{ProfilingInfo},
     if usePrevSol
       @info "Using previous solution"
       nInputs += length(eq.iterationVariables)
-      minBoundCArray *= repeat(", DBL_MIN", length(eq.iterationVariables))
+      minBoundCArray *= repeat(", -DBL_MAX", length(eq.iterationVariables))
       maxBoundCArray *= repeat(", DBL_MAX", length(eq.iterationVariables))
     end
-    ortstructs *= "struct OrtWrapperData* ortData_eq_$(eq.eqInfo.id);"
-    initCalls *= """
+    ortData = "nnInstance->ortData_eq_$(eq.eqInfo.id)"
+    ortstructs *= "  struct OrtWrapperData* ortData_eq_$(eq.eqInfo.id);"
+
+    # Compile network into FMU sources
+    aotModel = "NULL"
+    parityCheck = ""
+    if ortOptions[i].backend == :aot
+      network = readDenseNetwork(onnxNames[i], nInputs, nOutputs)
+      if network isa String
+        @warn "Can't compile $(onnxName) into FMU, falling back to ONNX Runtime: $(network)"
+      else
+        aotModel = "aotModel_eq$(eq.eqInfo.id)"
+        aotCode *= aotModelCode(network, aotModel)
+        if aotParitySamples > 0 && length(trainingData) == length(equations)
+          inputNames = usePrevSol ? vcat(eq.usingVars, eq.iterationVariables) : eq.usingVars
+          nSamples, parityInputs = aotParityInputs(trainingData[i], inputNames; nSamples=aotParitySamples)
+          tolerance = network.isDouble ? sqrt(eps(Float64)) : sqrt(eps(Float32))
+          aotCode *= "static const double aotParityInputs_eq$(eq.eqInfo.id)[$(nSamples*nInputs)] = $(parityInputs);$EOL"
+          parityCheck = chomp("""
+              if (AOT_PARITY_CHECK && nnInstance->instance == 0 && ortData->aotModel != NULL) {
+                double parityError;
+                if (checkModelParity(ortData, onnxPath, aotParityInputs_eq$(eq.eqInfo.id), $nSamples, &parityError)) {
+                  printf("Parity of compiled network %s with ONNX Runtime on $nSamples training samples: max error %e\\n", equationName, parityError);
+                  if (!(parityError <= $tolerance)) {
+                    printf("Warning: Compiled network %s doesn't match ONNX Runtime, falling back to ONNX Runtime.\\n", equationName);
+                    struct OrtWrapperOptions ortFallback_eq_$(eq.eqInfo.id) = ortOptions_eq_$(eq.eqInfo.id);
+                    ortFallback_eq_$(eq.eqInfo.id).backend = ONNX_BACKEND_ORT;
+                    deinitOrtData(ortData);
+                    ortData = initOrtData(equationName, onnxPath, \"$modelName\", $nInputs, $nOutputs, LOG_RES, ORT_NTHREADS, &ortFallback_eq_$(eq.eqInfo.id));
+                  }
+                }
+              }
+            """)
+        elseif aotParitySamples > 0
+          @warn "No training data for parity check of compiled network $(onnxName)."
+        end
+      end
+    end
+
+    initFunctions *= """
+      /* Create ORT data of equation $(eq.eqInfo.id) for FMU instance */
+      static struct OrtWrapperData* initOrtData_eq$(eq.eqInfo.id)(void* userData) {
+        struct OrtInstanceData* nnInstance = (struct OrtInstanceData*) userData;
+        DATA* data = nnInstance->data;
+        char onnxPath[2048];
+        char equationName[2048];
+        char cacheDirBuffer[2048];
+        const char* cacheDir = modelCacheDir(ORT_MODEL_CACHE, data->modelData->resourcesDir, cacheDirBuffer, 2048);
+        struct OrtWrapperData* ortData;
         snprintf(onnxPath, 2048, "%s/%s", data->modelData->resourcesDir, \"$(onnxName)\");
-        ortData_eq_$(eq.eqInfo.id) = initOrtData(\"$(modelName)_eq$(eq.eqInfo.id)\", onnxPath, \"$modelName\", $nInputs, $nOutputs, LOG_RES, ORT_NTHREADS);
+        instanceName(\"$(modelName)_eq$(eq.eqInfo.id)\", nnInstance->instance, equationName, 2048);
+        const struct OrtWrapperOptions ortOptions_eq_$(eq.eqInfo.id) = $(ortOptionsCInitializer(ortOptions[i]; cacheDir="cacheDir", residualLogFormat="RES_LOG_FORMAT", aotModel=aotModel));
+        ortData = initOrtData(equationName, onnxPath, \"$modelName\", $nInputs, $nOutputs, LOG_RES, ORT_NTHREADS, &ortOptions_eq_$(eq.eqInfo.id));
+      $(parityCheck)
+        if (ortData == NULL) {
+          return NULL;
+        }
+        double min_$(eq.eqInfo.id)[$nInputs] = {$minBoundCArray};
+        memcpy(ortData->min, min_$(eq.eqInfo.id), sizeof(double)*$nInputs);
+        double max_$(eq.eqInfo.id)[$nInputs] = {$(maxBoundCArray)};
+        memcpy(ortData->max, max_$(eq.eqInfo.id), sizeof(double)*$nInputs);
         if (LOG_RES) {
-          double min_$(eq.eqInfo.id)[$nInputs] = {$minBoundCArray};
-          memcpy(ortData_eq_$(eq.eqInfo.id)->min, min_$(eq.eqInfo.id), sizeof(double)*$nInputs);
-          double max_$(eq.eqInfo.id)[$nInputs] = {$(maxBoundCArray)};
-          memcpy(ortData_eq_$(eq.eqInfo.id)->max, max_$(eq.eqInfo.id), sizeof(double)*$nInputs);
+          initResidualCheck(&ortData->check, &RES_CHECK_POLICY);
+        }
+        if (DOMAIN_GATE == DOMAIN_GATE_GRID) {
+          snprintf(onnxPath, 2048, "%s/%s.domain", data->modelData->resourcesDir, "$(onnxName)");
+          ortData->domain = loadDomainIndex(onnxPath);
+          if (ortData->domain == NULL) {
+            printf("Warning: No domain index %s, using training area boundaries.\\n", onnxPath);
+          }
         }
+        return ortData;
+      }
+
+      """
+    slotInits *= """
+        initOrtDataSlot(&nnInstance->ortDataSlots[$(i-1)], initOrtData_eq$(eq.eqInfo.id), nnInstance);
+      """
+    refreshCalls *= """
+        if ($ortData == NULL) {
+          $ortData = getOrtDataSlot(&nnInstance->ortDataSlots[$(i-1)], 0);
+        }
+      """
+    latencyNames *= ", \"$(modelName)_eq$(eq.eqInfo.id)\""
+    statsCalls *= """
+          printLatency(latencyNames_global[$i], &nnInstance->latency[$i]);
+          if ($ortData == NULL) {
+            printf("%s: no ONNX session\\n", latencyNames_global[$i]);
+          } else {
+            if (LOG_RES) {
+              printResidualCheckStats(latencyNames_global[$i], &$ortData->check);
+              printResidualScalingStats(latencyNames_global[$i], &$ortData->scaling);
+            }
+            printFallbackStats(latencyNames_global[$i], &$ortData->fallback);
+            if (DOMAIN_GATE) {
+              printDomainGateStats(latencyNames_global[$i], $ortData);
+            }
+            if (LOG_RES && EXTRAPOLATION_ORDER) {
+              printExtrapolationStats(latencyNames_global[$i], &$ortData->history);
+            }
+            printEvalCacheStats(latencyNames_global[$i], $ortData->evalCache);
+          }
+      """
+    telemetryCases *= """
+          case $(eq.eqInfo.id):
+            if (nnInstance == NULL || $ortData == NULL) {
+              return NN_SURROGATE_NOT_LOADED;
+            }
+            nnTelemetryValues($ortData, values, nValues);
+            return NN_SURROGATE_LOADED;
       """
-    deinitCalls *= "  deinitOrtData(ortData_eq_$(eq.eqInfo.id));"
     if i < nEq
       ortstructs *= "$EOL"
-      deinitCalls *= "$EOL"
     end
     if i == nEq
-      initCalls = initCalls[1:end-1]
+      initFunctions = initFunctions[1:end-1]
+      slotInits = slotInits[1:end-1]
+      refreshCalls = refreshCalls[1:end-1]
+      statsCalls = statsCalls[1:end-1]
+      telemetryCases = telemetryCases[1:end-1]
     end
   end
 
@@ -102,36 +293,168 @@ function ortDataCode(equations::Array{ProfilingInfo},
     int LOG_RES = 1;
     int MEASURE_TIMES = 1;
     double MAX_REL_ERROR = $(maxRelError);
-    int ORT_NTHREADS = 0;
-
-    /* Global ORT structs */
+    int ORT_NTHREADS = $(ortNumThreads);
+    int ORT_MODEL_CACHE = $(modelCacheLocation[modelCache]);
+    int RES_LOG_FORMAT = $(residualLogFormats[residualLogFormat]);
+    int DOMAIN_GATE = $(domainGateModes[domainGate]);
+    int NLS_WARM_START = $(Int(warmStart));
+    int AOT_PARITY_CHECK = 1;
+    int EXTRAPOLATION_ORDER = $(extrapolationOrders[extrapolation]);
+    int ORT_SESSION_LOADING = $(sessionLoadingModes[sessionLoading]);
+    int ORT_LOADER_THREADS = $(sessionLoaderThreads);
+    const struct ResidualCheckPolicy RES_CHECK_POLICY = {.interval = $(residualCheck.interval), .maxInterval = $(residualCheck.maxInterval), .backoffAccepts = $(residualCheck.backoffAccepts), .eventWindow = $(residualCheck.eventWindow), .scalingTolerance = $(residualCheck.scalingTolerance)};
+    $(aotCode)
+
+    /* ORT state of one FMU instance */
+    struct OrtInstanceData {
+      DATA* data;                         /* Simulation data of instance */
+      unsigned int instance;              /* Number of instance in this process, kept on reset */
     $(ortstructs)
+      struct ortDataSlot ortDataSlots[$(nEq)]; /* ORT data of each equation, created depending on ORT_SESSION_LOADING */
+      struct sessionLoader* loader;       /* Background threads of SESSION_LOADING_BACKGROUND */
+      struct timer t;
+      double elapsedTimes[$(nEq+1)];
+      int ncalls[$(nEq+1)];
+      struct equationLatency latency[$(nEq+1)];
+    };
+    static unsigned int nInstances_global = 0;
+    const char* latencyNames_global[$(nEq+1)] = {$(latencyNames)};
+
+    /* Append instance number to name of output files, except for first instance */
+    static void instanceName(const char* name, unsigned int instance, char* buffer, size_t size) {
+      if (instance == 0) {
+        snprintf(buffer, size, "%s", name);
+      } else {
+        snprintf(buffer, size, "%s_%u", name, instance);
+      }
+    }
 
-    /* Global timers */
-    struct timer t_global;
-    double elapsedTimes_global[$(nEq+1)];
-    int ncalls_global[$(nEq+1)] = {0};
+    $(initFunctions)
+    /* Pick up ORT data of equations that finished loading since last call */
+    static void refreshOrtData(struct OrtInstanceData* nnInstance) {
+    $(refreshCalls)
+    }
 
-    void dumpMeasuredTimes() {
-      if (MEASURE_TIMES) {
+    void dumpMeasuredTimes(DATA* data) {
+      struct OrtInstanceData* nnInstance = findOrtInstance(data);
+      char latencyFile[2048];
+      if (MEASURE_TIMES && nnInstance != NULL) {
+        if (USE_JULIA) {
+          refreshOrtData(nnInstance);
+        }
         for(int i=0; i<$(nEq+1); i++) {
-          printf("elapsedTimes_global[%i]: %f, ncalls_global[%i]: %i, mean: %f\\n", i, elapsedTimes_global[i], i, ncalls_global[i], elapsedTimes_global[i]/ncalls_global[i]);
+          printf("elapsedTimes_global[%i]: %f, ncalls_global[%i]: %i, mean: %f\\n", i, nnInstance->elapsedTimes[i], i, nnInstance->ncalls[i], nnInstance->elapsedTimes[i]/nnInstance->ncalls[i]);
+        }
+        if (ORT_MODEL_CACHE && USE_JULIA) {
+          int modelCacheHits = 0;
+          double sessionTimeSaved = 0;
+          for (int i = 0; i < $(nEq); i++) {
+            struct OrtWrapperData* ortData = getOrtDataSlot(&nnInstance->ortDataSlots[i], 0);
+            if (ortData != NULL) {
+              modelCacheHits += ortData->modelCacheHit;
+              sessionTimeSaved += ortData->sessionTimeSaved;
+            }
+          }
+          printf("model cache hits: %i/$(nEq), session creation time saved: %f\\n", modelCacheHits, sessionTimeSaved);
         }
+        if (USE_JULIA) {
+    $(statsCalls)
+        }
+        instanceName("$(modelName)_latency", nnInstance->instance, latencyFile, 2048);
+        strcat(latencyFile, ".csv");
+        writeLatencyFile(latencyFile, latencyNames_global, nnInstance->latency, $(nEq+1));
       }
     }
 
-    /* Init function */
-    void initGlobalOrtData(DATA* data) {
-      char onnxPath[2048];
-    $(initCalls)
+    /* Telemetry of replaced equations for myfmi2GetNNTelemetry */
+    enum nnSurrogateState getOrtTelemetry(DATA* data, const size_t eqNumber, double* values, const size_t nValues) {
+      struct OrtInstanceData* nnInstance = findOrtInstance(data);
+      if (!USE_JULIA) {
+        return NN_SURROGATE_NONE;
+      }
+      if (nnInstance != NULL) {
+        refreshOrtData(nnInstance);
+      }
+      switch (eqNumber) {
+    $(telemetryCases)
+        default:
+          return NN_SURROGATE_NONE;
+      }
     }
 
-    /* Deinit function */
-    void deinitGlobalOrtData() {
+    /* Init function, does nothing if instance is already initialized */
+    void initOrtInstance(DATA* data) {
+      struct OrtInstanceData* nnInstance;
+      if (findOrtInstance(data) != NULL) {
+        return;
+      }
+      nnInstance = calloc(1, sizeof(struct OrtInstanceData));
+      nnInstance->data = data;
+      nnInstance->instance = __atomic_fetch_add(&nInstances_global, 1, __ATOMIC_RELAXED);
+      /* Every equation call finds its instance by DATA, see instanceRegistry.c */
+      registerOrtInstance(data, nnInstance);
+      nnTelemetryHook = getOrtTelemetry;
       if (!USE_JULIA) {
         return;
       }
-    $(deinitCalls)
+      tic(&nnInstance->t);
+    $(slotInits)
+      switch (ORT_SESSION_LOADING) {
+        case SESSION_LOADING_LAZY:
+          break;
+        case SESSION_LOADING_BACKGROUND:
+          nnInstance->loader = startSessionLoader(nnInstance->ortDataSlots, $(nEq), ORT_LOADER_THREADS);
+          break;
+        default:
+          for (int i = 0; i < $(nEq); i++) {
+            loadOrtDataSlot(&nnInstance->ortDataSlots[i]);
+          }
+          refreshOrtData(nnInstance);
+      }
+      nnInstance->elapsedTimes[0] += toc(&nnInstance->t);
+      nnInstance->ncalls[0]++;
+      recordLatency(&nnInstance->latency[0], LATENCY_TOTAL, nnInstance->t.stop - nnInstance->t.start);
+    }
+
+    /* Reset function, keeps instance number and ORT data that is already created */
+    void resetOrtInstance(DATA* data) {
+      struct OrtInstanceData* nnInstance = findOrtInstance(data);
+      if (nnInstance == NULL) {
+        initOrtInstance(data);
+        return;
+      }
+      memset(nnInstance->elapsedTimes, 0, sizeof(nnInstance->elapsedTimes));
+      memset(nnInstance->ncalls, 0, sizeof(nnInstance->ncalls));
+      memset(nnInstance->latency, 0, sizeof(nnInstance->latency));
+      if (!USE_JULIA) {
+        return;
+      }
+      /* Slots still loading keep loading as configured by ORT_SESSION_LOADING */
+      refreshOrtData(nnInstance);
+      for (int i = 0; i < $(nEq); i++) {
+        struct OrtWrapperData* ortData = getOrtDataSlot(&nnInstance->ortDataSlots[i], 0);
+        if (ortData != NULL) {
+          resetOrtData(ortData);
+        }
+      }
+    }
+
+    /* Deinit function */
+    void deinitOrtInstance(DATA* data) {
+      struct OrtInstanceData* nnInstance = findOrtInstance(data);
+      if (nnInstance == NULL) {
+        return;
+      }
+      unregisterOrtInstance(data);
+      if (USE_JULIA) {
+        joinSessionLoader(nnInstance->loader);
+        for (int i = 0; i < $(nEq); i++) {
+          if (nnInstance->ortDataSlots[i].ortData != NULL) {
+            deinitOrtData(nnInstance->ortDataSlots[i].ortData);
+          }
+        }
+      }
+      free(nnInstance);
     }
     """
   return code
@@ -192,7 +515,7 @@ function getVarCString(varName::String, variables::Dict{String, Mapping})::Strin
 end
 
 """
-    generateNNCall(modelname, modelDescriptionXmlFile, equationToReplace, sysNumber, usePrevSol)
+    generateNNCall(modelname, modelDescriptionXmlFile, equationToReplace, sysNumber, usePrevSol; aotModel="")
 
 Generates C code for calling a neural network model and handling its inputs and
 outputs within a simulation environment.
@@ -206,6 +529,10 @@ outputs within a simulation environment.
   - `usePrevSol::Bool`:                 Flag indicating whether to use previous
                                         solutions.
 
+# Keyword Arguments:
+  - `aotModel::String`:                 Name of compiled network of the equation,
+                                        called directly instead of `evalModel`.
+
 # Returns:
   - `String`: Generated C code.
 """
@@ -213,7 +540,8 @@ function generateNNCall(modelname::String,
                         modelDescriptionXmlFile::String,
                         equationToReplace::ProfilingInfo,
                         sysNumber::Int64,
-                        usePrevSol::Bool)::String
+                        usePrevSol::Bool;
+                        aotModel::String = "")::String
 
   variablesDict = getValueReferences(modelDescriptionXmlFile)
 
@@ -256,48 +584,150 @@ function generateNNCall(modelname::String,
     end
   end
 
-  ortData = "ortData_eq_$(equationToReplace.eqInfo.id)"
+  ortData = "nnInstance->ortData_eq_$(equationToReplace.eqInfo.id)"
+
+  # Compiled network can be inlined, unless init fell back to ORT
+  evalCall = "evalModel($ortData);"
+  if !isempty(aotModel)
+    evalCall = """
+      if ($ortData->aotModel == $aotModel) {
+            $aotModel(input, output);
+          } else {
+            evalModel($ortData);
+          }"""
+  end
+
+  # Evaluate residuals of prediction in output and compute scaled norm
+  checkResidual = chomp("""
+    /* Evaluate residuals */
+    if (MEASURE_TIMES) {
+      tPhase_$(equationToReplace.eqInfo.id) = nowNs();
+    }
+    RESIDUAL_USERDATA userData = {data, threadData, NULL};
+    evalResidual(residualFunc$(equationToReplace.eqInfo.id), (void*) &userData, $ortData);
+    if (MEASURE_TIMES) {
+      recordLatency(latency_$(equationToReplace.eqInfo.id), LATENCY_RESIDUAL, nowNs() - tPhase_$(equationToReplace.eqInfo.id));
+    }
+
+    /* Update cached Jacobian row scaling if state moved too far */
+    if (residualScalingDue($ortData, data->simulationInfo->discreteCall || data->simulationInfo->initial)) {
+      if (MEASURE_TIMES) {
+        tPhase_$(equationToReplace.eqInfo.id) = nowNs();
+      }
+      int scalingOk = getResidualScaling(data, threadData, $(sysNumber), $(ortData)->x, $(ortData)->res, $(ortData)->scaling.work, $(ortData)->scaling.scale);
+      updateResidualScaling($ortData, scalingOk);
+      if (MEASURE_TIMES) {
+        recordLatency(latency_$(equationToReplace.eqInfo.id), LATENCY_JACOBIAN, nowNs() - tPhase_$(equationToReplace.eqInfo.id));
+      }
+    }
+
+    /* Scale residuals with Jacobian rows and compute norm */
+    int isRegular, inBounds;
+    double resNorm = checkScaledResidual($ortData, &isRegular, &inBounds);
+    """)
+  checkResidual = replace(checkResidual, Regex("$(EOL)(?!$(EOL))")=>"$EOL      ")
 
   cCode = """
-      float* input = $ortData->model_input;
-      float* output = $ortData->model_output;
+      double* input = $ortData->input;
+      double* output = $ortData->x;
 
       $inputVarBlock
 
-      evalModel($ortData);
+      /* Reuse checked prediction of repeated inputs */
+      int recheckCached = 0;
+      if ($ortData->evalCache != NULL) {
+        int cachedVerdict;
+        enum evalCacheResult cached = lookupEvalCache($ortData->evalCache, input, output, &cachedVerdict);
+        if (cached == EVAL_CACHE_EXACT) {
+          recordNNOutcome(&$(ortData)->telemetry, (enum nnOutcome) cachedVerdict);
+
+          /* Set output variables */
+          $outputVarBlock
+          if (cachedVerdict != NN_ACCEPTED) {
+            nnWarmStart_$(equationToReplace.eqInfo.id) = 1;
+            goto GOTO_NLS_SOLVER_$(equationToReplace.eqInfo.id);
+          }
+
+          /* Eval inner equations */
+          $innerEquations
+          goto NN_DONE_$(equationToReplace.eqInfo.id);
+        } else if (cached == EVAL_CACHE_NEAR) {
+          /* Inputs only match after quantization, check cached prediction */
+          recheckCached = 1;
+          goto NN_CHECK_$(equationToReplace.eqInfo.id);
+        }
+      }
+
+      /* Try extrapolation of previous solutions before ONNX model */
+      if (LOG_RES && EXTRAPOLATION_ORDER && extrapolateSolution(&$(ortData)->history, EXTRAPOLATION_ORDER, data->localData[0]->timeValue, output)) {
+        $checkResidual
+
+        int accepted = isRegular && resNorm <= MAX_REL_ERROR;
+        recordExtrapolation(&$(ortData)->history, accepted);
+        /* Only accepted extrapolations decide the call, otherwise the ONNX prediction does */
+        if (accepted) {
+          recordResidualCheck(data->localData[0]->timeValue, $ortData, resNorm, isRegular, inBounds);
+          recordNNOutcome(&$(ortData)->telemetry, NN_EXTRAPOLATED);
+          goto NN_DONE_$(equationToReplace.eqInfo.id);
+        }
+      }
+
+      /* Skip ONNX model for inputs outside of training domain */
+      if (!inTrainingDomain($ortData, DOMAIN_GATE)) {
+        recordNNOutcome(&$(ortData)->telemetry, NN_REJECTED_DOMAIN);
+        goto GOTO_NLS_SOLVER_$(equationToReplace.eqInfo.id);
+      }
 
-      if(LOG_RES) {
-        /* Evaluate residuals */
-        RESIDUAL_USERDATA userData = {data, threadData, NULL};
-        evalResidual(residualFunc$(equationToReplace.eqInfo.id), (void*) &userData, $ortData);
+      if (MEASURE_TIMES) {
+        tPhase_$(equationToReplace.eqInfo.id) = nowNs();
+      }
+      $evalCall
+      if (MEASURE_TIMES) {
+        recordLatency(latency_$(equationToReplace.eqInfo.id), LATENCY_INFERENCE, nowNs() - tPhase_$(equationToReplace.eqInfo.id));
+      }
 
-        /* Residual scaling vector */
-        double* jac = getJac(data, $(sysNumber));
-        int isRegular = scaleResidual(jac, $(ortData)->res, $(ortData)->nRes);
+      NN_CHECK_$(equationToReplace.eqInfo.id):
+      if(LOG_RES && (recheckCached || residualCheckDue(&$(ortData)->check, data->localData[0]->timeValue, data->simulationInfo->discreteCall || data->simulationInfo->initial))) {
+        $checkResidual
+        recordResidualCheck(data->localData[0]->timeValue, $ortData, resNorm, isRegular, inBounds);
 
         //printResiduum($(equationToReplace.eqInfo.id), data->localData[0]->timeValue, $ortData);
-        if (!isRegular || residualNorm(data->localData[0]->timeValue, $ortData) > MAX_REL_ERROR) {
+        int accepted = isRegular && resNorm <= MAX_REL_ERROR;
+        enum nnOutcome outcome = accepted ? NN_ACCEPTED : (isRegular ? NN_REJECTED_RESIDUAL : NN_REJECTED_SINGULAR);
+        residualCheckResult(&$(ortData)->check, accepted);
+        if ($ortData->evalCache != NULL) {
+          storeEvalCache($ortData->evalCache, input, output, outcome);
+        }
+        recordNNOutcome(&$(ortData)->telemetry, outcome);
+        if (!accepted) {
+          /* Start non-linear solver from rejected prediction */
+          $outputVarBlock
+          nnWarmStart_$(equationToReplace.eqInfo.id) = 1;
           goto GOTO_NLS_SOLVER_$(equationToReplace.eqInfo.id);
         }
       } else {
+        recordNNOutcome(&$(ortData)->telemetry, NN_UNCHECKED);
+
         /* Set output variables */
         $outputVarBlock
 
         /* Eval inner equations */
         $innerEquations
       }
+      NN_DONE_$(equationToReplace.eqInfo.id):;
   """
 
   return cCode
 end
 
 """
-    modifyCCode(modelName, fmuTmpDir, modelDescriptionXmlFile, equations, onnxFiles; usePrevSol, maxRelError)
+    modifyCCode(modelName, fmuTmpDir, modelDescriptionXmlFile, equations, onnxFiles; usePrevSol, maxRelError, ortOptions, ortNumThreads, modelCache, residualLogFormat, residualCheck, domainGate, warmStart, trainingData, aotParitySamples, extrapolation, sessionLoading, sessionLoaderThreads)
 
 Modifies C code for integrating neural network models into a simulation
 environment by adding initialization and deinitialization of ORT data, replacing
 nonlinear system solving calls with neural network evaluations, and adding time
-measurements.
+measurements. The ORT data of each FMU instance is registered for its `DATA`
+in generated code, OpenModelica's runtime structs stay unchanged.
 
 # Arguments:
   - `modelName::String`:                Name of the model.
@@ -311,6 +741,18 @@ measurements.
 # Keyword Arguments:
   - `usePrevSol::Bool`: Flag indicating whether to use previous solutions.
   - `maxRelError::Float64`: Maximum relative error.
+  - `ortOptions::Array{OrtOptions}`: ORT session settings for each equation.
+  - `ortNumThreads::Integer`: Number of threads of global ORT thread pool.
+  - `modelCache::Symbol`: Location of optimized model cache.
+  - `residualLogFormat::Symbol`: Format of residual log.
+  - `residualCheck::ResidualCheckOptions`: Policy when to check residuals of ONNX predictions.
+  - `domainGate::Symbol`: Check inputs before evaluating ONNX models.
+  - `warmStart::Bool`: Start non-linear solver from rejected NN prediction.
+  - `trainingData::Array{String}`: Training data of each equation for parity checks of compiled networks.
+  - `aotParitySamples::Integer`: Number of training samples for parity checks of compiled networks.
+  - `extrapolation::Symbol`: Extrapolate previous solutions before evaluating ONNX models.
+  - `sessionLoading::Symbol`: Create ORT data during setup, on first call or in background threads.
+  - `sessionLoaderThreads::Integer`: Number of background threads creating sessions.
 """
 function modifyCCode(modelName::String,
                      fmuTmpDir::String,
@@ -318,7 +760,19 @@ function modifyCCode(modelName::String,
                      equations::Array{ProfilingInfo},
                      onnxFiles::Array{String};
                      usePrevSol::Bool,
-                     maxRelError::Float64)
+                     maxRelError::Float64,
+                     ortOptions::Array{OrtOptions} = fill(OrtOptions(), length(equations)),
+                     ortNumThreads::Integer = 1,
+                     modelCache::Symbol = :none,
+                     residualLogFormat::Symbol = :csv,
+                     residualCheck::ResidualCheckOptions = ResidualCheckOptions(),
+                     domainGate::Symbol = :none,
+                     warmStart::Bool = true,
+                     trainingData::Array{String} = String[],
+                     aotParitySamples::Integer = 100,
+                     extrapolation::Symbol = :none,
+                     sessionLoading::Symbol = :eager,
+                     sessionLoaderThreads::Integer = 2)
 
   cfile = joinpath(fmuTmpDir, "sources", "$(replace(modelName, "."=>"_")).c")
   str = open(cfile, "r") do file
@@ -326,10 +780,11 @@ function modifyCCode(modelName::String,
   end
 
   modelNameC = replace(modelName, "."=>"_")
+  variablesDict = getValueReferences(modelDescriptionXmlFile)
 
   # Add init/ deinint ortData
   id1 = first(findStrWError("/* dummy VARINFO and FILEINFO */", str)) - 2
-  initCode = ortDataCode(equations, modelName, onnxFiles; usePrevSol=usePrevSol, maxRelError=maxRelError)
+  initCode = ortDataCode(equations, modelName, onnxFiles; usePrevSol=usePrevSol, maxRelError=maxRelError, ortOptions=ortOptions, ortNumThreads=ortNumThreads, modelCache=modelCache, residualLogFormat=residualLogFormat, residualCheck=residualCheck, domainGate=domainGate, warmStart=warmStart, trainingData=trainingData, aotParitySamples=aotParitySamples, extrapolation=extrapolation, sessionLoading=sessionLoading, sessionLoaderThreads=sessionLoaderThreads)
   str = str[1:id1] * initCode * str[id1+1:end]
 
   id1 = last(findStrWError("$(modelNameC)_setupDataStruc(DATA *data, threadData_t *threadData)", str))
@@ -337,12 +792,7 @@ function modifyCCode(modelName::String,
   id1 = last(findStrWError(";$EOL", str, id1))
   str = str[1:id1] *
         """
-          if (USE_JULIA){
-            tic(&t_global);
-            initGlobalOrtData(data);
-            elapsedTimes_global[0] += toc(&t_global);
-            ncalls_global[0]++;
-          }
+          initOrtInstance(data);
         """ *
         str[id1+1:end]
 
@@ -359,21 +809,66 @@ function modifyCCode(modelName::String,
 
     oldpart = str[id1:id2]
     oldpart = replace(oldpart, "$EOL  "=>"$EOL    ")
-    newpart = generateNNCall(modelNameC, modelDescriptionXmlFile, equation, sysnumber, usePrevSol)
+    nInputs = length(equation.usingVars) + (usePrevSol ? length(equation.iterationVariables) : 0)
+    compiled = ortOptions[i].backend == :aot && readDenseNetwork(onnxFiles[i], nInputs, length(equation.iterationVariables)) isa DenseNetwork
+    newpart = generateNNCall(modelNameC, modelDescriptionXmlFile, equation, sysnumber, usePrevSol; aotModel = compiled ? "aotModel_eq$(eqInfo.id)" : "")
+
+    # Save solution for extrapolation
+    historyBlock = ""
+    for (j,var) in enumerate(equation.iterationVariables)
+      historyBlock *= "solution_$(eqInfo.id)[$(j-1)] = $(getVarCString(var, variablesDict));"
+      if j < length(equation.iterationVariables)
+        historyBlock *= "$EOL    "
+      end
+    end
 
     replacement = """
-    if (MEASURE_TIMES) {
-        tic(&t_global);
+    struct OrtInstanceData* nnInstance = findOrtInstance(data);
+      uint64_t tStart_$(eqInfo.id) = 0, tPhase_$(eqInfo.id) = 0;
+      struct equationLatency* latency_$(eqInfo.id) = &nnInstance->latency[$i];
+      if (MEASURE_TIMES) {
+        tStart_$(eqInfo.id) = nowNs();
+      }
+      int nnWarmStart_$(eqInfo.id) = 0;
+      unsigned long nlsIterations_$(eqInfo.id)[2], nlsFEvals_$(eqInfo.id)[2];
+      if (USE_JULIA && nnInstance->ortData_eq_$(eqInfo.id) == NULL) {
+        /* Non-linear solver is used until ORT data is created */
+        nnInstance->ortData_eq_$(eqInfo.id) = getOrtDataSlot(&nnInstance->ortDataSlots[$(i-1)], ORT_SESSION_LOADING != SESSION_LOADING_BACKGROUND);
       }
-      if(USE_JULIA) {
+      int useNN_$(eqInfo.id) = USE_JULIA && nnInstance->ortData_eq_$(eqInfo.id) != NULL;
+      if(useNN_$(eqInfo.id)) {
     $newpart
       } else {
         GOTO_NLS_SOLVER_$(eqInfo.id):
+        if (useNN_$(eqInfo.id)) {
+          if (nnWarmStart_$(eqInfo.id) && NLS_WARM_START) {
+            warmStartNLS(data, $(sysnumber));
+          }
+          getNLSStatistics(data, $(sysnumber), &nlsIterations_$(eqInfo.id)[0], &nlsFEvals_$(eqInfo.id)[0]);
+        }
+        tPhase_$(eqInfo.id) = nowNs();
         $oldpart
+        uint64_t fallbackTime_$(eqInfo.id) = nowNs() - tPhase_$(eqInfo.id);
+        if (MEASURE_TIMES) {
+          recordLatency(latency_$(eqInfo.id), LATENCY_FALLBACK, fallbackTime_$(eqInfo.id));
+        }
+        if (useNN_$(eqInfo.id)) {
+          getNLSStatistics(data, $(sysnumber), &nlsIterations_$(eqInfo.id)[1], &nlsFEvals_$(eqInfo.id)[1]);
+          recordFallback(&nnInstance->ortData_eq_$(eqInfo.id)->fallback, nnWarmStart_$(eqInfo.id) && NLS_WARM_START,
+                         nlsIterations_$(eqInfo.id)[1] - nlsIterations_$(eqInfo.id)[0],
+                         nlsFEvals_$(eqInfo.id)[1] - nlsFEvals_$(eqInfo.id)[0],
+                         fallbackTime_$(eqInfo.id) / 1e9);
+        }
+      }
+      if (useNN_$(eqInfo.id) && EXTRAPOLATION_ORDER) {
+        double* solution_$(eqInfo.id) = solutionHistorySlot(&nnInstance->ortData_eq_$(eqInfo.id)->history, data->localData[0]->timeValue);
+        $historyBlock
       }
       if (MEASURE_TIMES) {
-        elapsedTimes_global[$i] += toc(&t_global);
-        ncalls_global[$i]++;
+        uint64_t elapsed_$(eqInfo.id) = nowNs() - tStart_$(eqInfo.id);
+        recordLatency(latency_$(eqInfo.id), LATENCY_TOTAL, elapsed_$(eqInfo.id));
+        nnInstance->elapsedTimes[$i] += elapsed_$(eqInfo.id) / 1e6;
+        nnInstance->ncalls[$i]++;
       }
     """
     str = str[1:id1] * replacement * str[id2:end]
@@ -381,7 +876,7 @@ function modifyCCode(modelName::String,
 
   write(cfile, str)
 
-  # Add deinitGlobalOrtData and time measurements
+  # Add time measurements and deinitOrtInstance
   cfile_fmu2_modelinterface = joinpath(fmuTmpDir, "sources", "fmi-export", "fmu2_model_interface.c.inc")
   str = open(cfile_fmu2_modelinterface, "r") do file
     read(file, String)
@@ -390,8 +885,8 @@ function modifyCCode(modelName::String,
   # Replace in function fmi2FreeInstance
   id1 = first(findStrWError("freeNonlinearSystems", str))
   newCall = """
-              deinitGlobalOrtData();
-              dumpMeasuredTimes();
+              dumpMeasuredTimes(comp->fmuData);
+              deinitOrtInstance(comp->fmuData);
             """
   str = str[1:id1-1] * newCall * str[id1:end]
 
@@ -399,8 +894,8 @@ function modifyCCode(modelName::String,
   id1 = last(findStrWError("freeNonlinearSystems", str))
   id1 = first(findStrWError("freeNonlinearSystems", str, id1))
   newCall = """
-                deinitGlobalOrtData();
-                dumpMeasuredTimes();
+                dumpMeasuredTimes(comp->fmuData);
+                resetOrtInstance(comp->fmuData);
             """
   str = str[1:id1-1] * newCall * str[id1:end]
 
@@ -480,12 +975,30 @@ function copyOnnxWrapperLib(fmuRootDir::String)
   mkpath(onnxWrapperDir)
 
   files = [
+    joinpath(@__DIR__, "onnxWrapper", "acceptanceKernel.h"),
+    joinpath(@__DIR__, "onnxWrapper", "acceptanceKernel.c"),
+    joinpath(@__DIR__, "onnxWrapper", "denseMLP.h"),
+    joinpath(@__DIR__, "onnxWrapper", "denseMLP.c"),
+    joinpath(@__DIR__, "onnxWrapper", "domainGate.h"),
+    joinpath(@__DIR__, "onnxWrapper", "domainGate.c"),
     joinpath(@__DIR__, "onnxWrapper", "errorControl.h"),
     joinpath(@__DIR__, "onnxWrapper", "errorControl.c"),
+    joinpath(@__DIR__, "onnxWrapper", "evalCache.h"),
+    joinpath(@__DIR__, "onnxWrapper", "evalCache.c"),
+    joinpath(@__DIR__, "onnxWrapper", "extrapolation.h"),
+    joinpath(@__DIR__, "onnxWrapper", "extrapolation.c"),
+    joinpath(@__DIR__, "onnxWrapper", "instanceRegistry.h"),
+    joinpath(@__DIR__, "onnxWrapper", "instanceRegistry.c"),
     joinpath(@__DIR__, "onnxWrapper", "measureTimes.h"),
     joinpath(@__DIR__, "onnxWrapper", "measureTimes.c"),
+    joinpath(@__DIR__, "onnxWrapper", "modelCache.h"),
+    joinpath(@__DIR__, "onnxWrapper", "modelCache.c"),
     joinpath(@__DIR__, "onnxWrapper", "onnxWrapper.h"),
     joinpath(@__DIR__, "onnxWrapper", "onnxWrapper.c"),
+    joinpath(@__DIR__, "onnxWrapper", "residualLog.h"),
+    joinpath(@__DIR__, "onnxWrapper", "residualLog.c"),
+    joinpath(@__DIR__, "onnxWrapper", "sessionLoader.h"),
+    joinpath(@__DIR__, "onnxWrapper", "sessionLoader.c"),
     joinpath(@__DIR__, "onnxWrapper", "CMakeLists.txt"),
   ]
   for f in files
@@ -512,7 +1025,7 @@ function copyOnnxFiles(fmuRootDir::String, onnxFiles::Array{String})
 end
 
 """
-    buildWithOnnx(fmu, modelName, equations, onnxFiles; usePrevSol=false, tempDir=modelName*"_onnx")
+    buildWithOnnx(fmu, modelName, equations, onnxFiles; usePrevSol=false, maxRelError=1e-4, ortOptions=OrtOptions(), ortNumThreads=1, modelCache=:none, residualLogFormat=:csv, residualCheck=ResidualCheckOptions(), domainGate=:none, trainingData=String[], domainBins=16, warmStart=true, aotParitySamples=100, quantize=false, extrapolation=:none, sessionLoading=:eager, sessionLoaderThreads=2, tempDir=modelName*"_onnx")
 
 Include ONNX into FMU and recompile to generate FMU with ONNX surrogates.
 
@@ -525,6 +1038,40 @@ Include ONNX into FMU and recompile to generate FMU with ONNX surrogates.
 # Keyword Arguments
   - `usePrevSol::Bool`:                   ONNX uses previous solution as additional input.
   - `maxRelError::Float64`:               Maximum allowed relative error of ANN (default: 1e-4).
+  - `ortOptions::Union{OrtOptions, Array{OrtOptions}}`:
+                                          ORT session settings for all equations or one for each equation.
+  - `ortNumThreads::Integer`:             Number of threads of global ORT thread pool shared by all equations (default: 1).
+  - `modelCache::Symbol`:                 Cache optimized ONNX models to speed up FMU instantiation.
+                                          `:none` disables the cache, `:resources` uses the FMU resources
+                                          directory and `:user` the user cache directory (default: `:none`).
+  - `residualLogFormat::Symbol`:          Format of residual log `<modelName>_eq<id>_residuum.*` written
+                                          during simulation. `:csv` or `:binary` (default: `:csv`).
+                                          See [`readResidualLog`](@ref).
+  - `residualCheck::ResidualCheckOptions`: Policy when to check residuals of ONNX predictions.
+                                          Skipped checks aren't logged (default: check every call).
+  - `domainGate::Symbol`:                 Check inputs before evaluating ONNX models. Inputs outside of
+                                          the training domain are passed to the non-linear solver directly.
+                                          `:none`, `:box` for training area boundaries or `:grid` for
+                                          boundaries and occupied grid cells of `trainingData` (default: `:none`).
+  - `trainingData::Array{String}`:        CSV files with training data of each equation, needed for `domainGate=:grid`
+                                          and parity checks of `OrtOptions(backend=:aot)`.
+  - `domainBins::Integer`:                Number of grid cells in each dimension for `domainGate=:grid` (default: 16).
+  - `warmStart::Bool`:                    Start non-linear solver from NN prediction if residual check fails,
+                                          instead of values extrapolated from previous solutions (default: `true`).
+  - `aotParitySamples::Integer`:          Number of `trainingData` samples on which networks compiled with
+                                          `OrtOptions(backend=:aot)` are compared with ONNX Runtime when the
+                                          first FMU instance is initialized. Use 0 to disable (default: 100).
+  - `quantize::Bool`:                     Quantize float ONNX models to INT8 with `trainingData` and use them
+                                          if their residual acceptance rate isn't lower, see [`quantizeOnnx`](@ref)
+                                          (default: `false`).
+  - `extrapolation::Symbol`:              Extrapolate the last solutions of each equation and check the
+                                          residual before evaluating the ONNX model. `:none`, `:linear` or
+                                          `:quadratic` (default: `:none`).
+  - `sessionLoading::Symbol`:             When ONNX sessions are created. `:eager` during FMU setup, `:lazy`
+                                          on the first call of each equation or `:background` in loader
+                                          threads started during setup. Equations are solved with the
+                                          non-linear solver until their session is ready (default: `:eager`).
+  - `sessionLoaderThreads::Integer`:      Number of loader threads for `sessionLoading=:background` (default: 2).
   - `tempDir::String`:                    Working directory.
 
 # Returns
@@ -536,8 +1083,47 @@ function buildWithOnnx(fmu::String,
                        onnxFiles::Array{String};
                        usePrevSol::Bool = false,
                        maxRelError::Float64 = 1e-4,
+                       ortOptions::Union{OrtOptions, Array{OrtOptions}} = OrtOptions(),
+                       ortNumThreads::Integer = 1,
+                       modelCache::Symbol = :none,
+                       residualLogFormat::Symbol = :csv,
+                       residualCheck::ResidualCheckOptions = ResidualCheckOptions(),
+                       domainGate::Symbol = :none,
+                       trainingData::Array{String} = String[],
+                       domainBins::Integer = 16,
+                       warmStart::Bool = true,
+                       aotParitySamples::Integer = 100,
+                       quantize::Bool = false,
+                       extrapolation::Symbol = :none,
+                       sessionLoading::Symbol = :eager,
+                       sessionLoaderThreads::Integer = 2,
                        tempDir::String = modelName*"_onnx")
 
+  if ortOptions isa OrtOptions
+    ortOptions = fill(ortOptions, length(equations))
+  end
+
+  # Replace ONNX models by INT8 models that pass as many residual checks
+  if quantize
+    @assert length(trainingData) == length(equations) "Length of trainingData and equations doesn't match"
+    mkpath(tempDir)
+    onnxFiles = copy(onnxFiles)
+    for (i, eq) in enumerate(equations)
+      int8File = joinpath(tempDir, splitext(basename(onnxFiles[i]))[1] * ".int8.onnx")
+      try
+        accepted, report = quantizeOnnx(onnxFiles[i], int8File, fmu, eq, trainingData[i]; usePrevSol=usePrevSol, maxRelError=maxRelError)
+        @info "Quantization of equation $(eq.eqInfo.id):\n$(report)"
+        if accepted
+          onnxFiles[i] = int8File
+        else
+          @warn "INT8 model of equation $(eq.eqInfo.id) passes less residual checks, using float model."
+        end
+      catch err
+        @warn "Can't quantize ONNX model of equation $(eq.eqInfo.id), using float model." exception=err
+      end
+    end
+  end
+
   # Unzip FMU into tmp dir
   fmuTmpDir = abspath(joinpath(tempDir,"FMU"))
   rm(fmuTmpDir, force=true, recursive=true)
@@ -549,7 +1135,15 @@ function buildWithOnnx(fmu::String,
   copyOnnxWrapperLib(fmuTmpDir)
   modifyCMakeLists(path_to_cmakelists)
   copyOnnxFiles(fmuTmpDir, onnxFiles)
-  modifyCCode(modelName, fmuTmpDir, modelDescriptionXmlFile, equations, onnxFiles; usePrevSol=usePrevSol, maxRelError=maxRelError)
+  if domainGate == :grid
+    @assert length(trainingData) == length(equations) "Length of trainingData and equations doesn't match"
+    for (eq, onnxFile, csvFile) in zip(equations, onnxFiles, trainingData)
+      domainFile = joinpath(fmuTmpDir, "resources", basename(onnxFile) * ".domain")
+      nCells = writeDomainIndex(csvFile, eq.usingVars, eq.boundary, domainFile; nBins=domainBins)
+      @info "Domain index of equation $(eq.eqInfo.id) has $(nCells) occupied cells."
+    end
+  end
+  modifyCCode(modelName, fmuTmpDir, modelDescriptionXmlFile, equations, onnxFiles; usePrevSol=usePrevSol, maxRelError=maxRelError, ortOptions=ortOptions, ortNumThreads=ortNumThreads, modelCache=modelCache, residualLogFormat=residualLogFormat, residualCheck=residualCheck, domainGate=domainGate, warmStart=warmStart, trainingData=trainingData, aotParitySamples=aotParitySamples, extrapolation=extrapolation, sessionLoading=sessionLoading, sessionLoaderThreads=sessionLoaderThreads)
   compileFMU(fmuTmpDir, modelName*".onnx", tempDir)
 
   return joinpath(tempDir, "$(modelName).onnx.fmu")
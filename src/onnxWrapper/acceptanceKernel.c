@@ -0,0 +1,513 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Fused acceptance check of ONNX predictions.
+ *
+ * Scales the residual with the maximum norm of each Jacobian row, reduces the
+ * scaled residual to its euclidean norm and checks the inputs against the
+ * training area in one call. The Jacobian rows are the only O(n^2) data, so
+ * each row is read once with the widest vector instructions the CPU supports.
+ * Rows shorter than the vector width use the scalar loop. The variant with
+ * cached row norms, used by the FMU, divides, squares and sums the residual
+ * vector with the same instruction set.
+ * The instruction set is selected at runtime on first use, once per process
+ * so that FMU instances in parallel threads can share the kernel.
+ */
+
+#include "acceptanceKernel.h"
+
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ACCEPT_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+typedef void (*acceptanceKernelFunction)(const double*, double*, size_t,
+                                         const double*, const double*, const double*, size_t,
+                                         struct acceptanceResult*);
+
+/**
+ * @brief Fused kernel body.
+ *
+ * Rows with maximum norm of zero are scaled with 1e-16 and mark the Jacobian
+ * as singular. Without Jacobian the residual isn't scaled and the prediction
+ * is treated as singular.
+ */
+#define ACCEPTANCE_KERNEL_BODY(ROW_MAX_ABS, IN_BOUNDS)              \
+  {                                                                 \
+    int isRegular = 1;                                              \
+    double sum = 0;                                                 \
+    double scaling;                                                 \
+    for (size_t i = 0; i < nRes; i++) {                             \
+      if (jac != NULL) {                                            \
+        scaling = ROW_MAX_ABS(&jac[i*nRes], nRes);                  \
+        if (scaling <= 0.0) {                                       \
+          scaling = 1e-16;                                          \
+          isRegular = 0;                                            \
+        }                                                           \
+        res[i] = res[i] / scaling;                                  \
+      }                                                             \
+      sum += res[i]*res[i];                                         \
+    }                                                               \
+    result->isRegular = jac != NULL && isRegular;                   \
+    result->norm = sqrt(sum);                                       \
+    result->inBounds = (min == NULL || max == NULL) ? 1 : IN_BOUNDS(inputs, min, max, nInputs); \
+  }
+
+/**
+ * @brief Kernel body with cached maximum norm of each Jacobian row.
+ *
+ * DIVIDE_RESIDUAL scales the residual in place, returns the sum of its
+ * squares and clears isRegular for rows with scale of zero. Without scale
+ * every row is scaled with 1e-16 and the prediction is treated as singular.
+ */
+#define ACCEPTANCE_SCALED_BODY(DIVIDE_RESIDUAL, IN_BOUNDS)          \
+  {                                                                 \
+    int isRegular = 1;                                              \
+    double sum = DIVIDE_RESIDUAL(scale, res, nRes, &isRegular);     \
+    result->isRegular = isRegular;                                  \
+    result->norm = sqrt(sum);                                       \
+    result->inBounds = (min == NULL || max == NULL) ? 1 : IN_BOUNDS(inputs, min, max, nInputs); \
+  }
+
+/* Scalar */
+
+static inline double rowMaxAbsScalar(const double* row, size_t n) {
+  double m = 0;
+  for (size_t j = 0; j < n; j++) {
+    double v = fabs(row[j]);
+    if (v > m) {
+      m = v;
+    }
+  }
+  return m;
+}
+
+static inline int inBoundsScalar(const double* x, const double* min, const double* max, size_t n) {
+  for (size_t j = 0; j < n; j++) {
+    if (x[j] <= min[j] || x[j] >= max[j]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static inline double divideResidualScalar(const double* scale, double* res, size_t n, int* isRegular) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    double s = scale != NULL ? scale[i] : 0.0;
+    if (s <= 0.0) {
+      s = 1e-16;
+      *isRegular = 0;
+    }
+    res[i] = res[i] / s;
+    sum += res[i]*res[i];
+  }
+  return sum;
+}
+
+static void acceptanceKernelScalar(const double* jac, double* res, size_t nRes,
+                                   const double* inputs, const double* min, const double* max, size_t nInputs,
+                                   struct acceptanceResult* result)
+ACCEPTANCE_KERNEL_BODY(rowMaxAbsScalar, inBoundsScalar)
+
+static void acceptanceKernelScaledScalar(const double* scale, double* res, size_t nRes,
+                                         const double* inputs, const double* min, const double* max, size_t nInputs,
+                                         struct acceptanceResult* result)
+ACCEPTANCE_SCALED_BODY(divideResidualScalar, inBoundsScalar)
+
+#ifdef ACCEPT_X86_DISPATCH
+
+/* SSE2 */
+
+__attribute__((target("sse2")))
+static inline double rowMaxAbsSSE2(const double* row, size_t n) {
+  if (n < 4) {
+    return rowMaxAbsScalar(row, n);
+  }
+  const __m128d signMask = _mm_set1_pd(-0.0);
+  __m128d m0 = _mm_setzero_pd();
+  __m128d m1 = _mm_setzero_pd();
+  size_t j = 0;
+  for (; j + 4 <= n; j += 4) {
+    /* max(|x|, m) ignores NaN like the scalar version */
+    m0 = _mm_max_pd(_mm_andnot_pd(signMask, _mm_loadu_pd(&row[j])), m0);
+    m1 = _mm_max_pd(_mm_andnot_pd(signMask, _mm_loadu_pd(&row[j+2])), m1);
+  }
+  m0 = _mm_max_pd(m0, m1);
+  m0 = _mm_max_pd(m0, _mm_unpackhi_pd(m0, m0));
+  double m = _mm_cvtsd_f64(m0);
+  for (; j < n; j++) {
+    double v = fabs(row[j]);
+    if (v > m) {
+      m = v;
+    }
+  }
+  return m;
+}
+
+__attribute__((target("sse2")))
+static inline int inBoundsSSE2(const double* x, const double* min, const double* max, size_t n) {
+  size_t j = 0;
+  for (; j + 2 <= n; j += 2) {
+    __m128d v = _mm_loadu_pd(&x[j]);
+    __m128d out = _mm_or_pd(_mm_cmple_pd(v, _mm_loadu_pd(&min[j])),
+                            _mm_cmpge_pd(v, _mm_loadu_pd(&max[j])));
+    if (_mm_movemask_pd(out)) {
+      return 0;
+    }
+  }
+  return inBoundsScalar(&x[j], &min[j], &max[j], n - j);
+}
+
+__attribute__((target("sse2")))
+static inline double divideResidualSSE2(const double* scale, double* res, size_t n, int* isRegular) {
+  if (scale == NULL || n < 2) {
+    return divideResidualScalar(scale, res, n, isRegular);
+  }
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d tiny = _mm_set1_pd(1e-16);
+  __m128d sum = _mm_setzero_pd();
+  __m128d singular = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d s = _mm_loadu_pd(&scale[i]);
+    __m128d zeroRow = _mm_cmple_pd(s, zero);
+    singular = _mm_or_pd(singular, zeroRow);
+    s = _mm_or_pd(_mm_and_pd(zeroRow, tiny), _mm_andnot_pd(zeroRow, s));
+    __m128d r = _mm_div_pd(_mm_loadu_pd(&res[i]), s);
+    _mm_storeu_pd(&res[i], r);
+    sum = _mm_add_pd(sum, _mm_mul_pd(r, r));
+  }
+  if (_mm_movemask_pd(singular)) {
+    *isRegular = 0;
+  }
+  sum = _mm_add_pd(sum, _mm_unpackhi_pd(sum, sum));
+  return _mm_cvtsd_f64(sum) + divideResidualScalar(&scale[i], &res[i], n - i, isRegular);
+}
+
+__attribute__((target("sse2")))
+static void acceptanceKernelSSE2(const double* jac, double* res, size_t nRes,
+                                 const double* inputs, const double* min, const double* max, size_t nInputs,
+                                 struct acceptanceResult* result)
+ACCEPTANCE_KERNEL_BODY(rowMaxAbsSSE2, inBoundsSSE2)
+
+__attribute__((target("sse2")))
+static void acceptanceKernelScaledSSE2(const double* scale, double* res, size_t nRes,
+                                       const double* inputs, const double* min, const double* max, size_t nInputs,
+                                       struct acceptanceResult* result)
+ACCEPTANCE_SCALED_BODY(divideResidualSSE2, inBoundsSSE2)
+
+/* AVX2 */
+
+__attribute__((target("avx2")))
+static inline double rowMaxAbsAVX2(const double* row, size_t n) {
+  if (n < 8) {
+    return rowMaxAbsScalar(row, n);
+  }
+  const __m256d signMask = _mm256_set1_pd(-0.0);
+  __m256d m0 = _mm256_setzero_pd();
+  __m256d m1 = _mm256_setzero_pd();
+  size_t j = 0;
+  for (; j + 8 <= n; j += 8) {
+    m0 = _mm256_max_pd(_mm256_andnot_pd(signMask, _mm256_loadu_pd(&row[j])), m0);
+    m1 = _mm256_max_pd(_mm256_andnot_pd(signMask, _mm256_loadu_pd(&row[j+4])), m1);
+  }
+  for (; j + 4 <= n; j += 4) {
+    m0 = _mm256_max_pd(_mm256_andnot_pd(signMask, _mm256_loadu_pd(&row[j])), m0);
+  }
+  m0 = _mm256_max_pd(m0, m1);
+  __m128d m2 = _mm_max_pd(_mm256_castpd256_pd128(m0), _mm256_extractf128_pd(m0, 1));
+  m2 = _mm_max_pd(m2, _mm_unpackhi_pd(m2, m2));
+  double m = _mm_cvtsd_f64(m2);
+  for (; j < n; j++) {
+    double v = fabs(row[j]);
+    if (v > m) {
+      m = v;
+    }
+  }
+  return m;
+}
+
+__attribute__((target("avx2")))
+static inline int inBoundsAVX2(const double* x, const double* min, const double* max, size_t n) {
+  size_t j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m256d v = _mm256_loadu_pd(&x[j]);
+    __m256d out = _mm256_or_pd(_mm256_cmp_pd(v, _mm256_loadu_pd(&min[j]), _CMP_LE_OQ),
+                               _mm256_cmp_pd(v, _mm256_loadu_pd(&max[j]), _CMP_GE_OQ));
+    if (_mm256_movemask_pd(out)) {
+      return 0;
+    }
+  }
+  return inBoundsScalar(&x[j], &min[j], &max[j], n - j);
+}
+
+__attribute__((target("avx2")))
+static inline double divideResidualAVX2(const double* scale, double* res, size_t n, int* isRegular) {
+  if (scale == NULL || n < 4) {
+    return divideResidualScalar(scale, res, n, isRegular);
+  }
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d tiny = _mm256_set1_pd(1e-16);
+  __m256d sum = _mm256_setzero_pd();
+  __m256d singular = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d s = _mm256_loadu_pd(&scale[i]);
+    __m256d zeroRow = _mm256_cmp_pd(s, zero, _CMP_LE_OQ);
+    singular = _mm256_or_pd(singular, zeroRow);
+    s = _mm256_blendv_pd(s, tiny, zeroRow);
+    __m256d r = _mm256_div_pd(_mm256_loadu_pd(&res[i]), s);
+    _mm256_storeu_pd(&res[i], r);
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(r, r));
+  }
+  if (_mm256_movemask_pd(singular)) {
+    *isRegular = 0;
+  }
+  __m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+  sum2 = _mm_add_pd(sum2, _mm_unpackhi_pd(sum2, sum2));
+  return _mm_cvtsd_f64(sum2) + divideResidualScalar(&scale[i], &res[i], n - i, isRegular);
+}
+
+__attribute__((target("avx2")))
+static void acceptanceKernelAVX2(const double* jac, double* res, size_t nRes,
+                                 const double* inputs, const double* min, const double* max, size_t nInputs,
+                                 struct acceptanceResult* result)
+ACCEPTANCE_KERNEL_BODY(rowMaxAbsAVX2, inBoundsAVX2)
+
+__attribute__((target("avx2")))
+static void acceptanceKernelScaledAVX2(const double* scale, double* res, size_t nRes,
+                                       const double* inputs, const double* min, const double* max, size_t nInputs,
+                                       struct acceptanceResult* result)
+ACCEPTANCE_SCALED_BODY(divideResidualAVX2, inBoundsAVX2)
+
+/* AVX-512 */
+
+__attribute__((target("avx512f")))
+static inline double rowMaxAbsAVX512(const double* row, size_t n) {
+  if (n < 8) {
+    return rowMaxAbsScalar(row, n);
+  }
+  __m512d m0 = _mm512_setzero_pd();
+  size_t j = 0;
+  for (; j + 8 <= n; j += 8) {
+    m0 = _mm512_max_pd(_mm512_abs_pd(_mm512_loadu_pd(&row[j])), m0);
+  }
+  if (j < n) {
+    /* Masked tail, masked lanes load as zero */
+    __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+    m0 = _mm512_max_pd(_mm512_abs_pd(_mm512_maskz_loadu_pd(mask, &row[j])), m0);
+  }
+  return _mm512_reduce_max_pd(m0);
+}
+
+__attribute__((target("avx512f")))
+static inline int inBoundsAVX512(const double* x, const double* min, const double* max, size_t n) {
+  size_t j = 0;
+  for (; j + 8 <= n; j += 8) {
+    __m512d v = _mm512_loadu_pd(&x[j]);
+    if (_mm512_cmp_pd_mask(v, _mm512_loadu_pd(&min[j]), _CMP_LE_OQ) |
+        _mm512_cmp_pd_mask(v, _mm512_loadu_pd(&max[j]), _CMP_GE_OQ)) {
+      return 0;
+    }
+  }
+  return inBoundsScalar(&x[j], &min[j], &max[j], n - j);
+}
+
+__attribute__((target("avx512f")))
+static inline double divideResidualAVX512(const double* scale, double* res, size_t n, int* isRegular) {
+  if (scale == NULL || n < 8) {
+    return divideResidualScalar(scale, res, n, isRegular);
+  }
+  const __m512d zero = _mm512_setzero_pd();
+  const __m512d one = _mm512_set1_pd(1.0);
+  const __m512d tiny = _mm512_set1_pd(1e-16);
+  __m512d sum = _mm512_setzero_pd();
+  __mmask8 singular = 0;
+  for (size_t i = 0; i < n; i += 8) {
+    /* Masked tail, masked lanes divide 0 by 1 */
+    __mmask8 mask = n - i >= 8 ? (__mmask8) 0xff : (__mmask8) ((1u << (n - i)) - 1);
+    __m512d s = _mm512_mask_loadu_pd(one, mask, &scale[i]);
+    __mmask8 zeroRow = _mm512_cmp_pd_mask(s, zero, _CMP_LE_OQ);
+    singular |= zeroRow;
+    s = _mm512_mask_blend_pd(zeroRow, s, tiny);
+    __m512d r = _mm512_div_pd(_mm512_maskz_loadu_pd(mask, &res[i]), s);
+    _mm512_mask_storeu_pd(&res[i], mask, r);
+    sum = _mm512_fmadd_pd(r, r, sum);
+  }
+  if (singular) {
+    *isRegular = 0;
+  }
+  return _mm512_reduce_add_pd(sum);
+}
+
+__attribute__((target("avx512f")))
+static void acceptanceKernelAVX512(const double* jac, double* res, size_t nRes,
+                                   const double* inputs, const double* min, const double* max, size_t nInputs,
+                                   struct acceptanceResult* result)
+ACCEPTANCE_KERNEL_BODY(rowMaxAbsAVX512, inBoundsAVX512)
+
+__attribute__((target("avx512f")))
+static void acceptanceKernelScaledAVX512(const double* scale, double* res, size_t nRes,
+                                         const double* inputs, const double* min, const double* max, size_t nInputs,
+                                         struct acceptanceResult* result)
+ACCEPTANCE_SCALED_BODY(divideResidualAVX512, inBoundsAVX512)
+
+#endif // ACCEPT_X86_DISPATCH
+
+static acceptanceKernelFunction selectedKernel = NULL;
+static acceptanceKernelFunction selectedScaledKernel = NULL;
+static const char* selectedIsaName = "none";
+static pthread_once_t autoSelectOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Select instruction set of acceptance kernel.
+ *
+ * With ACCEPT_ISA_AUTO the widest instruction set supported by the CPU is
+ * used. Mainly used by benchmarks to compare instruction sets.
+ *
+ * @param isa     Instruction set.
+ * @return int    Return 1 if isa is supported and selected, 0 otherwise.
+ */
+int setAcceptanceKernelIsa(enum acceptanceKernelIsa isa) {
+#ifdef ACCEPT_X86_DISPATCH
+  __builtin_cpu_init();
+  if (isa == ACCEPT_ISA_AUTO) {
+    if (__builtin_cpu_supports("avx512f")) {
+      isa = ACCEPT_ISA_AVX512;
+    } else if (__builtin_cpu_supports("avx2")) {
+      isa = ACCEPT_ISA_AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      isa = ACCEPT_ISA_SSE2;
+    } else {
+      isa = ACCEPT_ISA_SCALAR;
+    }
+  }
+
+  switch (isa) {
+  case ACCEPT_ISA_SCALAR:
+    selectedKernel = acceptanceKernelScalar;
+    selectedScaledKernel = acceptanceKernelScaledScalar;
+    selectedIsaName = "scalar";
+    return 1;
+  case ACCEPT_ISA_SSE2:
+    if (!__builtin_cpu_supports("sse2")) {
+      return 0;
+    }
+    selectedKernel = acceptanceKernelSSE2;
+    selectedScaledKernel = acceptanceKernelScaledSSE2;
+    selectedIsaName = "sse2";
+    return 1;
+  case ACCEPT_ISA_AVX2:
+    if (!__builtin_cpu_supports("avx2")) {
+      return 0;
+    }
+    selectedKernel = acceptanceKernelAVX2;
+    selectedScaledKernel = acceptanceKernelScaledAVX2;
+    selectedIsaName = "avx2";
+    return 1;
+  case ACCEPT_ISA_AVX512:
+    if (!__builtin_cpu_supports("avx512f")) {
+      return 0;
+    }
+    selectedKernel = acceptanceKernelAVX512;
+    selectedScaledKernel = acceptanceKernelScaledAVX512;
+    selectedIsaName = "avx512";
+    return 1;
+  default:
+    return 0;
+  }
+#else
+  if (isa != ACCEPT_ISA_AUTO && isa != ACCEPT_ISA_SCALAR) {
+    return 0;
+  }
+  selectedKernel = acceptanceKernelScalar;
+  selectedScaledKernel = acceptanceKernelScaledScalar;
+  selectedIsaName = "scalar";
+  return 1;
+#endif
+}
+
+/**
+ * @brief Select widest supported instruction set, unless already selected.
+ */
+static void autoSelectAcceptanceKernel() {
+  if (selectedKernel == NULL) {
+    setAcceptanceKernelIsa(ACCEPT_ISA_AUTO);
+  }
+}
+
+/**
+ * @brief Name of selected instruction set.
+ *
+ * @return const char*  "scalar", "sse2", "avx2", "avx512" or "none" if no
+ *                      kernel was selected yet.
+ */
+const char* acceptanceKernelIsaName() {
+  return selectedIsaName;
+}
+
+/**
+ * @brief Scale residual, compute its norm and check bounds of inputs.
+ *
+ * Same result as scaling each residual with the maximum norm of its Jacobian
+ * row, followed by norm and isInBounds.
+ *
+ * @param jac       Pointer to nRes times nRes Jacobian in row-major format or NULL.
+ * @param res       Pointer to residual vector, scaled in place.
+ * @param nRes      Length of residual vector.
+ * @param inputs    Pointer to input vector.
+ * @param min       Array with minimum allowed values for inputs or NULL.
+ * @param max       Array with maximum allowed values for inputs or NULL.
+ * @param nInputs   Length of inputs, min and max.
+ * @param result    Pointer to result on return.
+ */
+void acceptanceKernel(const double* jac, double* res, size_t nRes,
+                      const double* inputs, const double* min, const double* max, size_t nInputs,
+                      struct acceptanceResult* result) {
+  pthread_once(&autoSelectOnce, autoSelectAcceptanceKernel);
+  selectedKernel(jac, res, nRes, inputs, min, max, nInputs, result);
+}
+
+/**
+ * @brief Scale residual with precomputed row norms, compute its norm and check bounds of inputs.
+ *
+ * Same result as acceptanceKernel with scale[i] the maximum norm of row i of
+ * the Jacobian, up to rounding of the sum. Only O(nRes + nInputs), used with
+ * cached scaling. Uses the instruction set selected for acceptanceKernel.
+ *
+ * @param scale     Pointer to maximum norm of each Jacobian row or NULL.
+ * @param res       Pointer to residual vector, scaled in place.
+ * @param nRes      Length of residual vector.
+ * @param inputs    Pointer to input vector.
+ * @param min       Array with minimum allowed values for inputs or NULL.
+ * @param max       Array with maximum allowed values for inputs or NULL.
+ * @param nInputs   Length of inputs, min and max.
+ * @param result    Pointer to result on return.
+ */
+void acceptanceKernelScaled(const double* scale, double* res, size_t nRes,
+                            const double* inputs, const double* min, const double* max, size_t nInputs,
+                            struct acceptanceResult* result) {
+  pthread_once(&autoSelectOnce, autoSelectAcceptanceKernel);
+  selectedScaledKernel(scale, res, nRes, inputs, min, max, nInputs, result);
+}
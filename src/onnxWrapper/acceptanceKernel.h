@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ACCEPTANCE_KERNEL_H
+#define ACCEPTANCE_KERNEL_H
+
+#include <stddef.h>
+
+/* Instruction set of acceptance kernel */
+enum acceptanceKernelIsa {
+  ACCEPT_ISA_AUTO,                    /* Best instruction set supported by CPU */
+  ACCEPT_ISA_SCALAR,
+  ACCEPT_ISA_SSE2,
+  ACCEPT_ISA_AVX2,
+  ACCEPT_ISA_AVX512
+};
+
+/* Result of acceptance kernel */
+struct acceptanceResult {
+  int isRegular;                      /* 1 if no row of Jacobian is zero */
+  int inBounds;                       /* 1 if all inputs are strictly inside bounds */
+  double norm;                        /* Euclidean norm of scaled residual */
+};
+
+/* Function prototypes */
+void acceptanceKernel(const double* jac, double* res, size_t nRes,
+                      const double* inputs, const double* min, const double* max, size_t nInputs,
+                      struct acceptanceResult* result);
+void acceptanceKernelScaled(const double* scale, double* res, size_t nRes,
+                            const double* inputs, const double* min, const double* max, size_t nInputs,
+                            struct acceptanceResult* result);
+int setAcceptanceKernelIsa(enum acceptanceKernelIsa isa);
+const char* acceptanceKernelIsaName();
+
+#endif // ACCEPTANCE_KERNEL_H
@@ -0,0 +1,218 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Acceptance check of ONNX predictions for growing system sizes.
+//
+// Usage: benchAccept [nRepetitions]
+//
+// Compares separate passes for residual scaling, norm and isInBounds with the
+// fused kernels for each instruction set supported by the CPU:
+// acceptanceKernel reads the dense Jacobian, acceptanceKernelScaled uses the
+// cached maximum norm of each Jacobian row like the FMU does between updates
+// of the residual scaling.
+// Sizes range from 2 to 500 iteration variables, the Jacobian has n^2
+// entries.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../acceptanceKernel.h"
+#include "../measureTimes.h"
+
+/**
+ * @brief Maximum norm of each row of n times n Jacobian.
+ */
+static void rowScaling(const double* jac, size_t n, double* scale) {
+  for (size_t i = 0; i < n; i++) {
+    scale[i] = 0;
+    for (size_t j = 0; j < n; j++) {
+      double v = fabs(jac[i*n+j]);
+      if (v > scale[i]) {
+        scale[i] = v;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Reference implementation with separate passes.
+ *
+ * Scales the residual with the maximum norm of each Jacobian row, followed
+ * by norm and isInBounds from errorControl.c. Without jac the row norms in
+ * scale are used.
+ */
+void acceptanceReference(const double* jac, const double* scale, double* res, size_t n,
+                         const double* inputs, const double* min, const double* max, size_t nInputs,
+                         struct acceptanceResult* result) {
+  int isRegular = 1;
+  for (size_t i = 0; i < n; i++) {
+    double scaling = 0;
+    if (jac != NULL) {
+      for (size_t j = 0; j < n; j++) {
+        double v = fabs(jac[i*n+j]);
+        if (v > scaling) {
+          scaling = v;
+        }
+      }
+    } else {
+      scaling = scale[i];
+    }
+    if (scaling <= 0.0) {
+      scaling = 1e-16;
+      isRegular = 0;
+    }
+    res[i] = res[i] / scaling;
+  }
+
+  double norm = 0;
+  for (size_t i = 0; i < n; i++) {
+    norm += res[i]*res[i];
+  }
+
+  int inBounds = 1;
+  for (size_t i = 0; i < nInputs; i++) {
+    if (inputs[i] <= min[i] || inputs[i] >= max[i]) {
+      inBounds = 0;
+      break;
+    }
+  }
+
+  result->isRegular = isRegular;
+  result->norm = sqrt(norm);
+  result->inBounds = inBounds;
+}
+
+static double randomDouble(double lo, double hi) {
+  return lo + (hi - lo) * ((double) rand() / RAND_MAX);
+}
+
+/**
+ * @brief Compare result of kernel with reference.
+ */
+static int sameResult(const struct acceptanceResult* result, const struct acceptanceResult* expected,
+                      size_t n, const char* kernel) {
+  if (result->isRegular != expected->isRegular || result->inBounds != expected->inBounds ||
+      fabs(result->norm - expected->norm) > 1e-12 * fabs(expected->norm)) {
+    fprintf(stderr, "Mismatch of %s for n=%zu, isa %s: norm %e != %e\n", kernel, n, acceptanceKernelIsaName(), result->norm, expected->norm);
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char* argv[]) {
+  const size_t sizes[] = {2, 3, 5, 8, 10, 20, 50, 100, 200, 300, 500};
+  const size_t nSizes = sizeof sizes / sizeof sizes[0];
+  const enum acceptanceKernelIsa isas[] = {ACCEPT_ISA_SCALAR, ACCEPT_ISA_SSE2, ACCEPT_ISA_AVX2, ACCEPT_ISA_AVX512};
+  const size_t nIsas = sizeof isas / sizeof isas[0];
+  long nRepetitions = argc > 1 ? atol(argv[1]) : 0;
+  struct timer t;
+  int failed = 0;
+
+  printf("%6s %10s %14s %14s %8s %14s %14s %8s\n", "n", "isa", "reference[ns]", "fused[ns]", "speedup",
+         "cachedRef[ns]", "cached[ns]", "speedup");
+  for (size_t s = 0; s < nSizes; s++) {
+    const size_t n = sizes[s];
+    const size_t nInputs = n;
+    /* Aim for the same amount of work for every size */
+    const long reps = nRepetitions > 0 ? nRepetitions : (long) (2e8 / (n*n + 1000)) + 1;
+
+    double* jac = malloc(n*n * sizeof jac[0]);
+    double* scale = malloc(n * sizeof scale[0]);
+    double* res0 = malloc(n * sizeof res0[0]);
+    double* res = malloc(n * sizeof res[0]);
+    double* inputs = malloc(nInputs * sizeof inputs[0]);
+    double* min = malloc(nInputs * sizeof min[0]);
+    double* max = malloc(nInputs * sizeof max[0]);
+    for (size_t i = 0; i < n*n; i++) {
+      jac[i] = randomDouble(-10, 10);
+    }
+    rowScaling(jac, n, scale);
+    for (size_t i = 0; i < n; i++) {
+      res0[i] = randomDouble(-1e-3, 1e-3);
+    }
+    for (size_t i = 0; i < nInputs; i++) {
+      min[i] = -1;
+      max[i] = 1;
+      inputs[i] = randomDouble(-0.9, 0.9);
+    }
+
+    struct acceptanceResult expected, result;
+    memcpy(res, res0, n * sizeof res[0]);
+    acceptanceReference(jac, NULL, res, n, inputs, min, max, nInputs, &expected);
+
+    tic(&t);
+    for (long r = 0; r < reps; r++) {
+      memcpy(res, res0, n * sizeof res[0]);
+      acceptanceReference(jac, NULL, res, n, inputs, min, max, nInputs, &result);
+    }
+    double referenceTime = toc(&t) / reps * 1e6;   /* ms to ns */
+
+    /* Cheap kernels need more repetitions */
+    const long cachedReps = 20*reps;
+    tic(&t);
+    for (long r = 0; r < cachedReps; r++) {
+      memcpy(res, res0, n * sizeof res[0]);
+      acceptanceReference(NULL, scale, res, n, inputs, min, max, nInputs, &result);
+    }
+    double cachedReferenceTime = toc(&t) / cachedReps * 1e6;
+
+    for (size_t k = 0; k < nIsas; k++) {
+      if (!setAcceptanceKernelIsa(isas[k])) {
+        continue;
+      }
+
+      memcpy(res, res0, n * sizeof res[0]);
+      acceptanceKernel(jac, res, n, inputs, min, max, nInputs, &result);
+      failed |= !sameResult(&result, &expected, n, "acceptanceKernel");
+      memcpy(res, res0, n * sizeof res[0]);
+      acceptanceKernelScaled(scale, res, n, inputs, min, max, nInputs, &result);
+      failed |= !sameResult(&result, &expected, n, "acceptanceKernelScaled");
+
+      tic(&t);
+      for (long r = 0; r < reps; r++) {
+        memcpy(res, res0, n * sizeof res[0]);
+        acceptanceKernel(jac, res, n, inputs, min, max, nInputs, &result);
+      }
+      double fusedTime = toc(&t) / reps * 1e6;   /* ms to ns */
+
+      tic(&t);
+      for (long r = 0; r < cachedReps; r++) {
+        memcpy(res, res0, n * sizeof res[0]);
+        acceptanceKernelScaled(scale, res, n, inputs, min, max, nInputs, &result);
+      }
+      double cachedTime = toc(&t) / cachedReps * 1e6;
+      printf("%6zu %10s %14.4f %14.4f %8.2f %14.4f %14.4f %8.2f\n", n, acceptanceKernelIsaName(),
+             referenceTime, fusedTime, referenceTime/fusedTime,
+             cachedReferenceTime, cachedTime, cachedReferenceTime/cachedTime);
+    }
+
+    free(jac);
+    free(scale);
+    free(res0);
+    free(res);
+    free(inputs);
+    free(min);
+    free(max);
+  }
+
+  return failed;
+}
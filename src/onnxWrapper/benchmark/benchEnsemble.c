@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Throughput of an ensemble of FMU instances evaluating the same ONNX model in
+// parallel threads.
+//
+// Usage: benchEnsemble <model.onnx> <nInputs> <nOutputs> <nCalls> <maxThreads> [nRegistered]
+//
+// Every thread owns one instance with its own input and output tensors, all
+// instances share one session. The number of threads is doubled from 1 to
+// maxThreads, each thread evaluates the model nCalls times. Like a replaced
+// equation of the FMU each call looks up its instance in the instance
+// registry, next to nRegistered other instances. The time of one lookup is
+// printed for the same instance and for alternating instances.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../onnxWrapper.h"
+#include "../measureTimes.h"
+
+struct EnsembleMember {
+  struct OrtWrapperData* ortData;
+  int nCalls;
+};
+
+/**
+ * @brief Evaluate model of one instance nCalls times with varying inputs.
+ */
+static void* runMember(void* arg) {
+  struct EnsembleMember* member = (struct EnsembleMember*) arg;
+
+  for (int call = 0; call < member->nCalls; call++) {
+    struct OrtWrapperData* ortData = ((struct EnsembleMember*) findOrtInstance(member))->ortData;
+    for (size_t i = 0; i < ortData->nInputs; i++) {
+      ortData->input[i] = (double)((call + i) % 100) / 100.0;
+    }
+    evalModel(ortData);
+  }
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 6 || argc > 7) {
+    fprintf(stderr, "Usage: %s <model.onnx> <nInputs> <nOutputs> <nCalls> <maxThreads> [nRegistered]\n", argv[0]);
+    return 1;
+  }
+  const char* pathToONNX = argv[1];
+  unsigned int nInputs = atoi(argv[2]);
+  unsigned int nOutputs = atoi(argv[3]);
+  int nCalls = atoi(argv[4]);
+  int maxThreads = atoi(argv[5]);
+  int nRegistered = argc > 6 ? atoi(argv[6]) : 0;
+
+  struct EnsembleMember* members = calloc(maxThreads, sizeof members[0]);
+  pthread_t* threads = calloc(maxThreads, sizeof threads[0]);
+  char equationName[64];
+  struct timer t;
+  double baseThroughput = 0;
+
+  for (int i = 0; i < maxThreads; i++) {
+    snprintf(equationName, sizeof equationName, "benchEnsemble_%i", i);
+    members[i].ortData = initOrtData(equationName, pathToONNX, "benchEnsemble", nInputs, nOutputs, 0, 1, NULL);
+    members[i].nCalls = nCalls;
+    registerOrtInstance(&members[i], &members[i]);
+  }
+  /* Other instances, only their keys matter */
+  char* others = malloc(nRegistered > 0 ? nRegistered : 1);
+  for (int i = 0; i < nRegistered; i++) {
+    registerOrtInstance(&others[i], NULL);
+  }
+
+  /* Warm up */
+  runMember(&members[0]);
+
+  for (int nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+    tic(&t);
+    for (int i = 0; i < nThreads; i++) {
+      pthread_create(&threads[i], NULL, runMember, &members[i]);
+    }
+    for (int i = 0; i < nThreads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    double time = toc(&t);
+    double throughput = (double) nThreads * nCalls / (time / 1e3);
+    if (nThreads == 1) {
+      baseThroughput = throughput;
+    }
+    printf("threads: %i, calls: %i, time: %f ms, throughput: %.0f calls/s, speedup: %.2f\n",
+           nThreads, nThreads * nCalls, time, throughput, throughput / baseThroughput);
+  }
+
+  /* Lookup of the same instance is served by the thread's last instance,
+     alternating instances by the hash buckets */
+  uint64_t start = nowNs();
+  for (int call = 0; call < nCalls; call++) {
+    (void) findOrtInstance(&members[0]);
+  }
+  double sameTime = (double)(nowNs() - start) / nCalls;
+  start = nowNs();
+  for (int call = 0; call < nCalls; call++) {
+    (void) findOrtInstance(&members[call % maxThreads]);
+    (void) findOrtInstance(&others[call % (nRegistered > 0 ? nRegistered : 1)]);
+  }
+  double alternatingTime = (double)(nowNs() - start) / (2.0 * nCalls);
+  printf("registered instances: %i, lookup: same instance %.1f ns, alternating instances %.1f ns\n",
+         maxThreads + nRegistered, sameTime, alternatingTime);
+
+  for (int i = 0; i < nRegistered; i++) {
+    unregisterOrtInstance(&others[i]);
+  }
+  for (int i = 0; i < maxThreads; i++) {
+    unregisterOrtInstance(&members[i]);
+    deinitOrtData(members[i].ortData);
+  }
+  free(others);
+  free(members);
+  free(threads);
+
+  return 0;
+}
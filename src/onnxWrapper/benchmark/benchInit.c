@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Startup time and memory of initializing many equations with one ONNX model.
+//
+// Usage: benchInit <shared|legacy> <model.onnx> <nInputs> <nOutputs> <nEquations>
+//
+//   shared   Use initOrtData, all equations attach to the process-wide
+//            environment and its global thread pools and share one session.
+//   legacy   One environment, session options and session per equation,
+//            each with its own thread pools.
+//
+// Run each mode in its own process, RSS is measured for the whole process.
+//
+
+#include <string.h>
+
+#include "../onnxWrapper.h"
+#include "../measureTimes.h"
+#include "benchUtil.h"
+
+#define ORT_ABORT_ON_ERROR(expr)                             \
+  do {                                                       \
+    OrtStatus* onnx_status = (expr);                         \
+    if (onnx_status != NULL) {                               \
+      const char* msg = g_ort->GetErrorMessage(onnx_status); \
+      fprintf(stderr, "%s\n", msg);                          \
+      g_ort->ReleaseStatus(onnx_status);                     \
+      abort();                                               \
+    }                                                        \
+  } while (0);
+
+struct LegacyData {
+  OrtEnv* env;
+  OrtSessionOptions* session_options;
+  OrtSession* session;
+};
+
+/**
+ * @brief Per-equation environment setup as done before the shared environment.
+ */
+void initLegacy(const OrtApi* g_ort, struct LegacyData* legacy, const char* pathToONNX) {
+  ORT_ABORT_ON_ERROR(g_ort->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "benchInit", &legacy->env));
+  ORT_ABORT_ON_ERROR(g_ort->CreateSessionOptions(&legacy->session_options));
+  ORT_ABORT_ON_ERROR(g_ort->SetIntraOpNumThreads(legacy->session_options, 1));
+  ORT_ABORT_ON_ERROR(g_ort->SetInterOpNumThreads(legacy->session_options, 1));
+  ORT_ABORT_ON_ERROR(g_ort->CreateSession(legacy->env, pathToONNX, legacy->session_options, &legacy->session));
+}
+
+void deinitLegacy(const OrtApi* g_ort, struct LegacyData* legacy) {
+  g_ort->ReleaseSession(legacy->session);
+  g_ort->ReleaseSessionOptions(legacy->session_options);
+  g_ort->ReleaseEnv(legacy->env);
+}
+
+int main(int argc, char** argv) {
+  if (argc != 6) {
+    fprintf(stderr, "Usage: %s <shared|legacy> <model.onnx> <nInputs> <nOutputs> <nEquations>\n", argv[0]);
+    return 1;
+  }
+  const char* mode = argv[1];
+  const char* pathToONNX = argv[2];
+  unsigned int nInputs = atoi(argv[3]);
+  unsigned int nOutputs = atoi(argv[4]);
+  int nEquations = atoi(argv[5]);
+  int useShared = strcmp(mode, "shared") == 0;
+  if (!useShared && strcmp(mode, "legacy") != 0) {
+    fprintf(stderr, "Unknown mode %s\n", mode);
+    return 1;
+  }
+
+  const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+  struct OrtWrapperData** ortData = calloc(nEquations, sizeof ortData[0]);
+  struct LegacyData* legacy = calloc(nEquations, sizeof legacy[0]);
+  struct timer t;
+  char equationName[64];
+
+  long rssBefore = currentRSS();
+  tic(&t);
+  for (int i = 0; i < nEquations; i++) {
+    if (useShared) {
+      snprintf(equationName, sizeof equationName, "benchInit_eq%i", i);
+      ortData[i] = initOrtData(equationName, pathToONNX, "benchInit", nInputs, nOutputs, 0, 1, NULL);
+    } else {
+      initLegacy(g_ort, &legacy[i], pathToONNX);
+    }
+  }
+  double initTime = toc(&t);
+  long rssAfter = currentRSS();
+
+  printf("mode: %s, equations: %i, init time: %f ms, per equation: %f ms, RSS increase: %ld kB\n",
+         mode, nEquations, initTime, initTime/nEquations, rssAfter - rssBefore);
+
+  for (int i = 0; i < nEquations; i++) {
+    if (useShared) {
+      deinitOrtData(ortData[i]);
+    } else {
+      deinitLegacy(g_ort, &legacy[i]);
+    }
+  }
+  free(ortData);
+  free(legacy);
+
+  return 0;
+}
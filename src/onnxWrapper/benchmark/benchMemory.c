@@ -0,0 +1,145 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Resident memory versus number of instances of the same ONNX model.
+//
+// Usage: benchMemory <private|prepacked|shared> <maxInstances> [width] [depth]
+//
+//   private    Every instance creates its own session from the model path,
+//              with private copies of weights and prepacked kernels.
+//   prepacked  Every instance creates its own session from the model path,
+//              all sessions share one prepacked weights container.
+//   shared     Use initOrtData, all instances share one session.
+//
+// A random dense MLP with 4 inputs and outputs is written to the current
+// directory. The number of instances is doubled from 1 to maxInstances and
+// the RSS increase is printed after each step. Run each mode in its own
+// process, RSS is measured for the whole process.
+//
+
+#include <string.h>
+
+#include "../onnxWrapper.h"
+#include "benchUtil.h"
+#include "mlpModel.h"
+
+#define ORT_ABORT_ON_ERROR(expr)                             \
+  do {                                                       \
+    OrtStatus* onnx_status = (expr);                         \
+    if (onnx_status != NULL) {                               \
+      const char* msg = g_ort->GetErrorMessage(onnx_status); \
+      fprintf(stderr, "%s\n", msg);                          \
+      g_ort->ReleaseStatus(onnx_status);                     \
+      abort();                                               \
+    }                                                        \
+  } while (0);
+
+enum benchMode {
+  MODE_PRIVATE,
+  MODE_PREPACKED,
+  MODE_SHARED
+};
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 5) {
+    fprintf(stderr, "Usage: %s <private|prepacked|shared> <maxInstances> [width] [depth]\n", argv[0]);
+    return 1;
+  }
+  enum benchMode mode;
+  if (strcmp(argv[1], "private") == 0) {
+    mode = MODE_PRIVATE;
+  } else if (strcmp(argv[1], "prepacked") == 0) {
+    mode = MODE_PREPACKED;
+  } else if (strcmp(argv[1], "shared") == 0) {
+    mode = MODE_SHARED;
+  } else {
+    fprintf(stderr, "Unknown mode %s\n", argv[1]);
+    return 1;
+  }
+  int maxInstances = atoi(argv[2]);
+  int width = argc > 3 ? atoi(argv[3]) : 512;
+  int depth = argc > 4 ? atoi(argv[4]) : 4;
+  const unsigned int nInputs = 4, nOutputs = 4;
+
+  char path[256];
+  snprintf(path, sizeof path, "benchMemory_w%i_d%i.onnx", width, depth);
+  if (!writeMLPModel(path, nInputs, nOutputs, width, depth)) {
+    fprintf(stderr, "Can't write %s\n", path);
+    return 1;
+  }
+
+  const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+  OrtEnv* env = NULL;
+  OrtSessionOptions* session_options = NULL;
+  OrtPrepackedWeightsContainer* prepacked = NULL;
+  OrtSession** sessions = calloc(maxInstances, sizeof sessions[0]);
+  struct OrtWrapperData** ortData = calloc(maxInstances, sizeof ortData[0]);
+  char equationName[64];
+
+  if (mode != MODE_SHARED) {
+    ORT_ABORT_ON_ERROR(g_ort->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "benchMemory", &env));
+    ORT_ABORT_ON_ERROR(g_ort->CreateSessionOptions(&session_options));
+    ORT_ABORT_ON_ERROR(g_ort->SetIntraOpNumThreads(session_options, 1));
+    ORT_ABORT_ON_ERROR(g_ort->SetInterOpNumThreads(session_options, 1));
+  }
+  if (mode == MODE_PREPACKED) {
+    ORT_ABORT_ON_ERROR(g_ort->CreatePrepackedWeightsContainer(&prepacked));
+  }
+
+  long rssBefore = currentRSS();
+  long rssFirst = 0;
+  int nInstances = 0;
+  printf("%10s %14s %18s\n", "instances", "RSS incr [kB]", "per instance [kB]");
+  for (int target = 1; target <= maxInstances; target *= 2) {
+    for (; nInstances < target; nInstances++) {
+      if (mode == MODE_PRIVATE) {
+        ORT_ABORT_ON_ERROR(g_ort->CreateSession(env, path, session_options, &sessions[nInstances]));
+      } else if (mode == MODE_PREPACKED) {
+        ORT_ABORT_ON_ERROR(g_ort->CreateSessionWithPrepackedWeightsContainer(env, path, session_options, prepacked, &sessions[nInstances]));
+      } else {
+        snprintf(equationName, sizeof equationName, "benchMemory_%i", nInstances);
+        ortData[nInstances] = initOrtData(equationName, path, "benchMemory", nInputs, nOutputs, 0, 1, NULL);
+      }
+    }
+    long rss = currentRSS() - rssBefore;
+    if (nInstances == 1) {
+      rssFirst = rss;
+    }
+    printf("%10i %14ld %18.1f\n", nInstances, rss, nInstances > 1 ? (double)(rss - rssFirst) / (nInstances - 1) : (double) rss);
+  }
+
+  for (int i = 0; i < nInstances; i++) {
+    if (mode == MODE_SHARED) {
+      deinitOrtData(ortData[i]);
+    } else {
+      g_ort->ReleaseSession(sessions[i]);
+    }
+  }
+  if (prepacked != NULL) {
+    g_ort->ReleasePrepackedWeightsContainer(prepacked);
+  }
+  if (env != NULL) {
+    g_ort->ReleaseSessionOptions(session_options);
+    g_ort->ReleaseEnv(env);
+  }
+  free(sessions);
+  free(ortData);
+
+  return 0;
+}
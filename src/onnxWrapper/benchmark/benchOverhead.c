@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+// Nanoseconds per evalModel call versus width and depth of a dense MLP, with
+// and without the IoBinding fast path and with the built-in dense MLP backend.
+//
+// Usage: benchOverhead <nCalls> <maxWidth> <maxDepth> [nInputs] [nOutputs]
+//
+// Random MLPs with width 4, 8, ..., maxWidth and depth 0, ..., maxDepth are
+// written to the current directory. The intercept of a least-squares fit of
+// time per call over FLOPs estimates the fixed wrapper and ORT overhead, the
+// slope the cost of the model itself. The maximum difference of the dense MLP
+// outputs to ORT is printed as check.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../onnxWrapper.h"
+#include "../measureTimes.h"
+#include "mlpModel.h"
+
+/**
+ * @brief Mean time in ns of nCalls evaluations with varying inputs.
+ */
+static double timePerCall(struct OrtWrapperData* ortData, int nCalls) {
+  uint64_t start;
+
+  /* Warm up */
+  for (int call = 0; call < 100; call++) {
+    evalModel(ortData);
+  }
+
+  start = nowNs();
+  for (int call = 0; call < nCalls; call++) {
+    for (size_t i = 0; i < ortData->nInputs; i++) {
+      ortData->input[i] = (double)((call + i) % 100) / 100.0;
+    }
+    evalModel(ortData);
+  }
+  return (double)(nowNs() - start) / nCalls;
+}
+
+/* Least-squares line y = a + b*x */
+struct linearFit {
+  double n, sx, sy, sxx, sxy;
+};
+
+static void addPoint(struct linearFit* fit, double x, double y) {
+  fit->n += 1;
+  fit->sx += x;
+  fit->sy += y;
+  fit->sxx += x*x;
+  fit->sxy += x*y;
+}
+
+static void printFit(const char* name, const struct linearFit* fit) {
+  if (fit->n < 2 || fit->n * fit->sxx == fit->sx * fit->sx) {
+    return;
+  }
+  double b = (fit->n * fit->sxy - fit->sx * fit->sy) / (fit->n * fit->sxx - fit->sx * fit->sx);
+  double a = (fit->sy - b * fit->sx) / fit->n;
+  printf("%-9s overhead: %10.1f ns/call, model: %8.4f ns/FLOP\n", name, a, b);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4 || argc > 6) {
+    fprintf(stderr, "Usage: %s <nCalls> <maxWidth> <maxDepth> [nInputs] [nOutputs]\n", argv[0]);
+    return 1;
+  }
+  int nCalls = atoi(argv[1]);
+  int maxWidth = atoi(argv[2]);
+  int maxDepth = atoi(argv[3]);
+  unsigned int nInputs = argc > 4 ? atoi(argv[4]) : 4;
+  unsigned int nOutputs = argc > 5 ? atoi(argv[5]) : 4;
+
+  struct OrtWrapperOptions defaultOptions = defaultOrtWrapperOptions();
+  struct OrtWrapperOptions fastOptions = defaultOrtWrapperOptions();
+  fastOptions.fastPath = 1;
+  struct OrtWrapperOptions mlpOptions = defaultOrtWrapperOptions();
+  mlpOptions.backend = ONNX_BACKEND_DENSE_MLP;
+  struct linearFit defaultFit = {0}, fastFit = {0}, mlpFit = {0};
+  char path[256];
+  double* reference = calloc(nOutputs, sizeof(double));
+
+  srand(42);
+  printf("%6s %6s %10s %14s %14s %14s %10s\n", "width", "depth", "FLOPs", "default [ns]", "fastPath [ns]", "denseMLP [ns]", "max diff");
+  for (int depth = 0; depth <= maxDepth; depth++) {
+    for (int width = 4; width <= maxWidth; width *= 2) {
+      snprintf(path, sizeof path, "benchOverhead_w%i_d%i.onnx", width, depth);
+      if (!writeMLPModel(path, nInputs, nOutputs, width, depth)) {
+        fprintf(stderr, "Can't write %s\n", path);
+        return 1;
+      }
+      double flops = mlpFlops(nInputs, nOutputs, width, depth);
+
+      struct OrtWrapperData* ortData = initOrtData("benchOverhead", path, "benchOverhead", nInputs, nOutputs, 0, 1, &defaultOptions);
+      double defaultTime = timePerCall(ortData, nCalls);
+      deinitOrtData(ortData);
+
+      ortData = initOrtData("benchOverhead", path, "benchOverhead", nInputs, nOutputs, 0, 1, &fastOptions);
+      double fastTime = timePerCall(ortData, nCalls);
+      for (size_t i = 0; i < nOutputs; i++) {
+        reference[i] = ortData->x[i];
+      }
+      deinitOrtData(ortData);
+
+      ortData = initOrtData("benchOverhead", path, "benchOverhead", nInputs, nOutputs, 0, 1, &mlpOptions);
+      double mlpTime = timePerCall(ortData, nCalls);
+      double maxDiff = 0;
+      for (size_t i = 0; i < nOutputs; i++) {
+        maxDiff = fmax(maxDiff, fabs(ortData->x[i] - reference[i]));
+      }
+      deinitOrtData(ortData);
+
+      addPoint(&defaultFit, flops, defaultTime);
+      addPoint(&fastFit, flops, fastTime);
+      addPoint(&mlpFit, flops, mlpTime);
+      printf("%6i %6i %10.0f %14.1f %14.1f %14.1f %10.2e\n", width, depth, flops, defaultTime, fastTime, mlpTime, maxDiff);
+
+      /* Width doesn't matter for single linear layer */
+      if (depth == 0) {
+        break;
+      }
+    }
+  }
+
+  printFit("default", &defaultFit);
+  printFit("fastPath", &fastFit);
+  printFit("denseMLP", &mlpFit);
+  free(reference);
+
+  return 0;
+}
@@ -0,0 +1,225 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Writes dense MLP models of arbitrary width and depth as ONNX files, so
+// benchmarks don't depend on trained surrogates.
+// Minimal protobuf encoder for the few ONNX messages needed.
+
+#ifndef MLP_MODEL_H
+#define MLP_MODEL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* TensorProto data types */
+#define MLP_FLOAT 1
+#define MLP_DOUBLE 11
+
+struct pbBuffer {
+  unsigned char* data;
+  size_t len;
+  size_t capacity;
+};
+
+static inline void pbAppend(struct pbBuffer* buf, const void* data, size_t len) {
+  if (buf->len + len > buf->capacity) {
+    size_t capacity = buf->capacity > 0 ? buf->capacity : 64;
+    while (capacity < buf->len + len) {
+      capacity *= 2;
+    }
+    buf->data = realloc(buf->data, capacity);
+    buf->capacity = capacity;
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+}
+
+static inline void pbVarint(struct pbBuffer* buf, uint64_t value) {
+  unsigned char byte;
+  do {
+    byte = value & 0x7F;
+    value >>= 7;
+    if (value != 0) {
+      byte |= 0x80;
+    }
+    pbAppend(buf, &byte, 1);
+  } while (value != 0);
+}
+
+static inline void pbInt(struct pbBuffer* buf, int field, int64_t value) {
+  pbVarint(buf, (uint64_t) field << 3);
+  pbVarint(buf, (uint64_t) value);
+}
+
+static inline void pbBytes(struct pbBuffer* buf, int field, const void* data, size_t len) {
+  pbVarint(buf, ((uint64_t) field << 3) | 2);
+  pbVarint(buf, len);
+  pbAppend(buf, data, len);
+}
+
+static inline void pbString(struct pbBuffer* buf, int field, const char* str) {
+  pbBytes(buf, field, str, strlen(str));
+}
+
+/* Append sub message and free it */
+static inline void pbMessage(struct pbBuffer* buf, int field, struct pbBuffer* sub) {
+  pbBytes(buf, field, sub->data, sub->len);
+  free(sub->data);
+  memset(sub, 0, sizeof *sub);
+}
+
+/* ValueInfoProto of tensor {batch, n} with elemType MLP_FLOAT or MLP_DOUBLE */
+static inline void mlpValueInfoType(struct pbBuffer* graph, int field, const char* name, int64_t n, int elemType) {
+  struct pbBuffer dim = {0}, shape = {0}, tensor = {0}, type = {0}, info = {0};
+
+  pbString(&dim, 2, "batch");               /* dim_param */
+  pbMessage(&shape, 1, &dim);
+  pbInt(&dim, 1, n);                        /* dim_value */
+  pbMessage(&shape, 1, &dim);
+  pbInt(&tensor, 1, elemType);              /* elem_type */
+  pbMessage(&tensor, 2, &shape);
+  pbMessage(&type, 1, &tensor);             /* tensor_type */
+  pbString(&info, 1, name);
+  pbMessage(&info, 2, &type);
+  pbMessage(graph, field, &info);
+}
+
+/* ValueInfoProto of float tensor {batch, n} */
+static inline void mlpValueInfo(struct pbBuffer* graph, int field, const char* name, int64_t n) {
+  mlpValueInfoType(graph, field, name, n, MLP_FLOAT);
+}
+
+/* TensorProto initializer of elemType with random values in [-scale, scale] */
+static inline void mlpInitializer(struct pbBuffer* graph, const char* name, const int64_t* dims, int nDims, double scale, int elemType) {
+  struct pbBuffer tensor = {0};
+  size_t n = 1;
+
+  for (int i = 0; i < nDims; i++) {
+    pbInt(&tensor, 1, dims[i]);
+    n *= dims[i];
+  }
+  pbInt(&tensor, 2, elemType);              /* data_type */
+  pbString(&tensor, 8, name);
+  if (elemType == MLP_DOUBLE) {
+    double* values = malloc(n * sizeof(double));
+    for (size_t i = 0; i < n; i++) {
+      values[i] = scale * (2.0 * rand() / RAND_MAX - 1.0);
+    }
+    pbBytes(&tensor, 9, values, n * sizeof(double));  /* raw_data, little endian */
+    free(values);
+  } else {
+    float* values = malloc(n * sizeof(float));
+    for (size_t i = 0; i < n; i++) {
+      values[i] = (float)(scale * (2.0 * rand() / RAND_MAX - 1.0));
+    }
+    pbBytes(&tensor, 9, values, n * sizeof(float));   /* raw_data, little endian */
+    free(values);
+  }
+  pbMessage(graph, 5, &tensor);
+}
+
+static inline void mlpNode(struct pbBuffer* graph, const char* opType, const char* const* inputs, int nInputs, const char* output) {
+  struct pbBuffer node = {0};
+  for (int i = 0; i < nInputs; i++) {
+    pbString(&node, 1, inputs[i]);
+  }
+  pbString(&node, 2, output);
+  pbString(&node, 4, opType);
+  pbMessage(graph, 1, &node);
+}
+
+/**
+ * @brief Write dense MLP with tanh activation as ONNX model.
+ *
+ * Input "x" of shape {batch, nInputs}, `depth` hidden layers with `width`
+ * neurons and output "y" of shape {batch, nOutputs}. Weights are random.
+ * Depth 0 is a single linear layer.
+ *
+ * @param path      Path of ONNX file to write.
+ * @param nInputs   Number of inputs.
+ * @param nOutputs  Number of outputs.
+ * @param width     Neurons of each hidden layer.
+ * @param depth     Number of hidden layers.
+ * @param elemType  Element type of tensors, MLP_FLOAT or MLP_DOUBLE.
+ * @return int      Return 1 on success, 0 if file can't be written.
+ */
+static inline int writeMLPModelType(const char* path, int64_t nInputs, int64_t nOutputs, int64_t width, int depth, int elemType) {
+  struct pbBuffer graph = {0}, opset = {0}, model = {0};
+  char in[32], w[32], b[32], z[32], out[32];
+
+  snprintf(in, sizeof in, "x");
+  for (int layer = 0; layer <= depth; layer++) {
+    const int64_t nIn = layer == 0 ? nInputs : width;
+    const int64_t nOut = layer == depth ? nOutputs : width;
+    const int64_t wDims[] = {nIn, nOut};
+    const int64_t bDims[] = {nOut};
+    snprintf(w, sizeof w, "W%d", layer);
+    snprintf(b, sizeof b, "b%d", layer);
+    snprintf(z, sizeof z, layer == depth ? "y" : "z%d", layer);
+    mlpInitializer(&graph, w, wDims, 2, 1.0 / (double) nIn, elemType);
+    mlpInitializer(&graph, b, bDims, 1, 0.1, elemType);
+    const char* gemmInputs[] = {in, w, b};
+    mlpNode(&graph, "Gemm", gemmInputs, 3, z);
+    if (layer < depth) {
+      snprintf(out, sizeof out, "a%d", layer);
+      const char* tanhInputs[] = {z};
+      mlpNode(&graph, "Tanh", tanhInputs, 1, out);
+      snprintf(in, sizeof in, "%s", out);
+    }
+  }
+  pbString(&graph, 2, "mlp");
+  mlpValueInfoType(&graph, 11, "x", nInputs, elemType);
+  mlpValueInfoType(&graph, 12, "y", nOutputs, elemType);
+
+  pbInt(&model, 1, 7);                      /* ir_version */
+  pbString(&model, 2, "NonLinearSystemNeuralNetworkFMU");
+  pbString(&opset, 1, "");
+  pbInt(&opset, 2, 13);
+  pbMessage(&model, 8, &opset);
+  pbMessage(&model, 7, &graph);
+
+  FILE* file = fopen(path, "wb");
+  int success = file != NULL && fwrite(model.data, 1, model.len, file) == model.len;
+  if (file != NULL) {
+    fclose(file);
+  }
+  free(model.data);
+  return success;
+}
+
+/**
+ * @brief Write dense MLP with float tensors, see writeMLPModelType.
+ */
+static inline int writeMLPModel(const char* path, int64_t nInputs, int64_t nOutputs, int64_t width, int depth) {
+  return writeMLPModelType(path, nInputs, nOutputs, width, depth, MLP_FLOAT);
+}
+
+/**
+ * @brief Floating point operations of one evaluation of writeMLPModel network.
+ */
+static inline double mlpFlops(int64_t nInputs, int64_t nOutputs, int64_t width, int depth) {
+  if (depth == 0) {
+    return 2.0 * nInputs * nOutputs;
+  }
+  return 2.0 * (nInputs * width + (depth - 1) * width * width + width * nOutputs);
+}
+
+#endif // MLP_MODEL_H
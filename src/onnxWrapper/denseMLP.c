@@ -0,0 +1,971 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Built-in inference engine for small dense feed-forward networks.
+ *
+ * Surrogates of non-linear systems are usually chains of Gemm (or MatMul and
+ * Add) layers with Tanh, Relu or Sigmoid activations. For such models the
+ * fixed overhead of an ORT session run is larger than the network itself.
+ * The ONNX model is parsed once, the weights of each layer are packed
+ * row-major with rows padded to full cache lines, so every output neuron is
+ * one aligned dot product followed by its activation.
+ * Models are evaluated in the element type of the ONNX model, float or double.
+ * Any other operator or graph structure is rejected and the caller falls back
+ * to ORT.
+ */
+
+#include "denseMLP.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MLP_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define MLP_ALIGNMENT 64              /* Cache line size, multiple of widest vector */
+
+/* ONNX TensorProto data types */
+#define ONNX_FLOAT 1
+#define ONNX_DOUBLE 11
+
+enum mlpActivation {
+  MLP_ACT_NONE,
+  MLP_ACT_TANH,
+  MLP_ACT_RELU,
+  MLP_ACT_SIGMOID
+};
+
+struct denseLayer {
+  size_t nIn;                         /* Number of inputs */
+  size_t nOut;                        /* Number of outputs */
+  size_t ldIn;                        /* Row stride of weights, nIn padded to cache line */
+  size_t ldOut;                       /* nOut padded to cache line, row stride of next layer */
+  void* weights;                      /* nOut rows of W in row-major format, aligned, zero padded */
+  void* bias;                         /* Bias, length nOut */
+  enum mlpActivation activation;
+};
+
+struct denseMLP {
+  int isDouble;                       /* 1 for double models, 0 for float models */
+  size_t nInputs;
+  size_t nOutputs;
+  size_t nLayers;
+  struct denseLayer* layers;
+  void* buffer[2];                    /* Activations of consecutive layers, aligned */
+};
+
+/* ------------------------------------------------------------------------- */
+/* Kernels                                                                    */
+/* ------------------------------------------------------------------------- */
+
+typedef void (*gemvFloatFunction)(const float*, const float*, const float*, float*, size_t, size_t, enum mlpActivation);
+typedef void (*gemvDoubleFunction)(const double*, const double*, const double*, double*, size_t, size_t, enum mlpActivation);
+
+static inline float activateFloat(float z, enum mlpActivation activation) {
+  switch (activation) {
+  case MLP_ACT_TANH:
+    return tanhf(z);
+  case MLP_ACT_RELU:
+    return z > 0.0f ? z : 0.0f;
+  case MLP_ACT_SIGMOID:
+    return 1.0f / (1.0f + expf(-z));
+  default:
+    return z;
+  }
+}
+
+static inline double activateDouble(double z, enum mlpActivation activation) {
+  switch (activation) {
+  case MLP_ACT_TANH:
+    return tanh(z);
+  case MLP_ACT_RELU:
+    return z > 0.0 ? z : 0.0;
+  case MLP_ACT_SIGMOID:
+    return 1.0 / (1.0 + exp(-z));
+  default:
+    return z;
+  }
+}
+
+/**
+ * @brief Fused dense layer y = activation(W*x + b), scalar version.
+ *
+ * @param w           Weights, nOut rows with stride ld.
+ * @param b           Bias, length nOut.
+ * @param x           Input, length ld, zero padded.
+ * @param y           Output, length nOut.
+ * @param nOut        Number of outputs.
+ * @param ld          Row stride of weights.
+ * @param activation  Activation function.
+ */
+static void gemvFloatScalar(const float* w, const float* b, const float* x, float* y,
+                            size_t nOut, size_t ld, enum mlpActivation activation) {
+  for (size_t i = 0; i < nOut; i++) {
+    const float* row = &w[i*ld];
+    float sum = 0.0f;
+    for (size_t j = 0; j < ld; j++) {
+      sum += row[j] * x[j];
+    }
+    y[i] = activateFloat(sum + b[i], activation);
+  }
+}
+
+static void gemvDoubleScalar(const double* w, const double* b, const double* x, double* y,
+                             size_t nOut, size_t ld, enum mlpActivation activation) {
+  for (size_t i = 0; i < nOut; i++) {
+    const double* row = &w[i*ld];
+    double sum = 0.0;
+    for (size_t j = 0; j < ld; j++) {
+      sum += row[j] * x[j];
+    }
+    y[i] = activateDouble(sum + b[i], activation);
+  }
+}
+
+#ifdef MLP_X86_DISPATCH
+
+/* ld is a multiple of 16 floats, rows and x are aligned to 64 bytes */
+__attribute__((target("avx2,fma")))
+static void gemvFloatAVX2(const float* w, const float* b, const float* x, float* y,
+                          size_t nOut, size_t ld, enum mlpActivation activation) {
+  for (size_t i = 0; i < nOut; i++) {
+    const float* row = &w[i*ld];
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (size_t j = 0; j < ld; j += 16) {
+      acc0 = _mm256_fmadd_ps(_mm256_load_ps(&row[j]), _mm256_load_ps(&x[j]), acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_load_ps(&row[j+8]), _mm256_load_ps(&x[j+8]), acc1);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    sum = _mm_hadd_ps(sum, sum);
+    sum = _mm_hadd_ps(sum, sum);
+    y[i] = activateFloat(_mm_cvtss_f32(sum) + b[i], activation);
+  }
+}
+
+/* ld is a multiple of 8 doubles, rows and x are aligned to 64 bytes */
+__attribute__((target("avx2,fma")))
+static void gemvDoubleAVX2(const double* w, const double* b, const double* x, double* y,
+                           size_t nOut, size_t ld, enum mlpActivation activation) {
+  for (size_t i = 0; i < nOut; i++) {
+    const double* row = &w[i*ld];
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    for (size_t j = 0; j < ld; j += 8) {
+      acc0 = _mm256_fmadd_pd(_mm256_load_pd(&row[j]), _mm256_load_pd(&x[j]), acc0);
+      acc1 = _mm256_fmadd_pd(_mm256_load_pd(&row[j+4]), _mm256_load_pd(&x[j+4]), acc1);
+    }
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    sum = _mm_hadd_pd(sum, sum);
+    y[i] = activateDouble(_mm_cvtsd_f64(sum) + b[i], activation);
+  }
+}
+
+#endif // MLP_X86_DISPATCH
+
+static gemvFloatFunction gemvFloat = gemvFloatScalar;
+static gemvDoubleFunction gemvDouble = gemvDoubleScalar;
+static pthread_once_t selectKernelOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Use AVX2 kernels if supported by the CPU, once per process.
+ */
+static void selectDenseKernels() {
+#ifdef MLP_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    gemvFloat = gemvFloatAVX2;
+    gemvDouble = gemvDoubleAVX2;
+  }
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/* Minimal protobuf reader for ONNX models                                    */
+/* ------------------------------------------------------------------------- */
+
+struct pbReader {
+  const unsigned char* p;
+  const unsigned char* end;
+  int error;
+};
+
+struct pbString {
+  const char* data;
+  size_t len;
+};
+
+static uint64_t pbVarint(struct pbReader* r) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64 && r->p < r->end; shift += 7) {
+    unsigned char byte = *r->p++;
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  r->error = 1;
+  return 0;
+}
+
+/* Read key of next field, return 0 at end of message or on error */
+static int pbNextField(struct pbReader* r, int* field, int* wireType) {
+  if (r->error || r->p >= r->end) {
+    return 0;
+  }
+  uint64_t key = pbVarint(r);
+  *field = (int)(key >> 3);
+  *wireType = (int)(key & 7);
+  return !r->error;
+}
+
+/* Read length-delimited field as sub message */
+static struct pbReader pbSubMessage(struct pbReader* r) {
+  struct pbReader sub = {NULL, NULL, 1};
+  uint64_t len = pbVarint(r);
+  if (r->error || len > (uint64_t)(r->end - r->p)) {
+    r->error = 1;
+    return sub;
+  }
+  sub.p = r->p;
+  sub.end = r->p + len;
+  sub.error = 0;
+  r->p += len;
+  return sub;
+}
+
+static struct pbString pbReadString(struct pbReader* r) {
+  struct pbReader sub = pbSubMessage(r);
+  struct pbString str = {(const char*) sub.p, sub.error ? 0 : (size_t)(sub.end - sub.p)};
+  return str;
+}
+
+static float pbReadFixed32Float(struct pbReader* r) {
+  float value = 0.0f;
+  if (r->end - r->p < 4) {
+    r->error = 1;
+    return value;
+  }
+  memcpy(&value, r->p, 4);
+  r->p += 4;
+  return value;
+}
+
+static void pbSkip(struct pbReader* r, int wireType) {
+  switch (wireType) {
+  case 0:
+    pbVarint(r);
+    break;
+  case 1:
+    if (r->end - r->p < 8) {
+      r->error = 1;
+    } else {
+      r->p += 8;
+    }
+    break;
+  case 2:
+    pbSubMessage(r);
+    break;
+  case 5:
+    if (r->end - r->p < 4) {
+      r->error = 1;
+    } else {
+      r->p += 4;
+    }
+    break;
+  default:
+    r->error = 1;
+  }
+}
+
+static int pbStringEqual(struct pbString a, struct pbString b) {
+  return a.len == b.len && memcmp(a.data, b.data, a.len) == 0;
+}
+
+static int pbStringIs(struct pbString a, const char* str) {
+  return a.len == strlen(str) && memcmp(a.data, str, a.len) == 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* ONNX graph                                                                 */
+/* ------------------------------------------------------------------------- */
+
+#define ONNX_MAX_DIMS 4
+#define ONNX_MAX_NODE_INPUTS 3
+
+struct onnxTensor {
+  struct pbString name;
+  int64_t dims[ONNX_MAX_DIMS];
+  int nDims;
+  int dataType;
+  const unsigned char* data;          /* Little-endian values, raw_data, float_data or double_data */
+  size_t dataLen;
+  int dataIsDouble;
+};
+
+struct onnxNode {
+  struct pbString opType;
+  struct pbString inputs[ONNX_MAX_NODE_INPUTS];
+  int nInputs;
+  struct pbString output;
+  int nOutputs;
+  float alpha;
+  float beta;
+  int64_t transA;
+  int64_t transB;
+};
+
+struct onnxValueInfo {
+  struct pbString name;
+  int elemType;
+};
+
+struct onnxGraph {
+  struct onnxNode* nodes;
+  size_t nNodes;
+  struct onnxTensor* initializers;
+  size_t nInitializers;
+  struct onnxValueInfo* inputs;
+  size_t nInputs;
+  struct onnxValueInfo* outputs;
+  size_t nOutputs;
+};
+
+/* Grow array of graph elements by one, return pointer to new zeroed element */
+static void* appendElement(void** array, size_t* n, size_t size) {
+  *array = realloc(*array, (*n + 1) * size);
+  void* element = (char*)(*array) + (*n) * size;
+  memset(element, 0, size);
+  (*n)++;
+  return element;
+}
+
+static void parseTensor(struct pbReader* r, struct onnxTensor* tensor) {
+  int field, wireType;
+  int isRawData = 0;
+  while (pbNextField(r, &field, &wireType)) {
+    if (field == 1 && wireType == 0) {
+      if (tensor->nDims < ONNX_MAX_DIMS) {
+        tensor->dims[tensor->nDims] = (int64_t) pbVarint(r);
+      } else {
+        pbVarint(r);
+      }
+      tensor->nDims++;
+    } else if (field == 1 && wireType == 2) {
+      /* Packed dims */
+      struct pbReader packed = pbSubMessage(r);
+      while (!packed.error && packed.p < packed.end) {
+        int64_t dim = (int64_t) pbVarint(&packed);
+        if (tensor->nDims < ONNX_MAX_DIMS) {
+          tensor->dims[tensor->nDims] = dim;
+        }
+        tensor->nDims++;
+      }
+      r->error |= packed.error;
+    } else if (field == 2 && wireType == 0) {
+      tensor->dataType = (int) pbVarint(r);
+    } else if (field == 8 && wireType == 2) {
+      tensor->name = pbReadString(r);
+    } else if ((field == 9 || field == 4 || field == 10) && wireType == 2) {
+      /* raw_data, packed float_data or packed double_data */
+      struct pbString data = pbReadString(r);
+      tensor->data = (const unsigned char*) data.data;
+      tensor->dataLen = data.len;
+      tensor->dataIsDouble = field == 10;
+      isRawData = field == 9;
+    } else {
+      pbSkip(r, wireType);
+    }
+  }
+  /* data_type can follow raw_data */
+  if (isRawData) {
+    tensor->dataIsDouble = tensor->dataType == ONNX_DOUBLE;
+  }
+}
+
+static void parseNode(struct pbReader* r, struct onnxNode* node) {
+  int field, wireType;
+  node->alpha = 1.0f;
+  node->beta = 1.0f;
+  while (pbNextField(r, &field, &wireType)) {
+    if (field == 1 && wireType == 2) {
+      struct pbString input = pbReadString(r);
+      if (node->nInputs < ONNX_MAX_NODE_INPUTS) {
+        node->inputs[node->nInputs] = input;
+      }
+      node->nInputs++;
+    } else if (field == 2 && wireType == 2) {
+      node->output = pbReadString(r);
+      node->nOutputs++;
+    } else if (field == 4 && wireType == 2) {
+      node->opType = pbReadString(r);
+    } else if (field == 5 && wireType == 2) {
+      /* AttributeProto, name = 1, f = 2, i = 3 */
+      struct pbReader attribute = pbSubMessage(r);
+      struct pbString name = {NULL, 0};
+      float f = 0.0f;
+      int64_t i = 0;
+      int aField, aWireType;
+      while (pbNextField(&attribute, &aField, &aWireType)) {
+        if (aField == 1 && aWireType == 2) {
+          name = pbReadString(&attribute);
+        } else if (aField == 2 && aWireType == 5) {
+          f = pbReadFixed32Float(&attribute);
+        } else if (aField == 3 && aWireType == 0) {
+          i = (int64_t) pbVarint(&attribute);
+        } else {
+          pbSkip(&attribute, aWireType);
+        }
+      }
+      r->error |= attribute.error;
+      if (pbStringIs(name, "alpha")) {
+        node->alpha = f;
+      } else if (pbStringIs(name, "beta")) {
+        node->beta = f;
+      } else if (pbStringIs(name, "transA")) {
+        node->transA = i;
+      } else if (pbStringIs(name, "transB")) {
+        node->transB = i;
+      }
+    } else {
+      pbSkip(r, wireType);
+    }
+  }
+}
+
+static void parseValueInfo(struct pbReader* r, struct onnxValueInfo* info) {
+  int field, wireType;
+  while (pbNextField(r, &field, &wireType)) {
+    if (field == 1 && wireType == 2) {
+      info->name = pbReadString(r);
+    } else if (field == 2 && wireType == 2) {
+      /* TypeProto.tensor_type.elem_type */
+      struct pbReader type = pbSubMessage(r);
+      int tField, tWireType;
+      while (pbNextField(&type, &tField, &tWireType)) {
+        if (tField == 1 && tWireType == 2) {
+          struct pbReader tensorType = pbSubMessage(&type);
+          int eField, eWireType;
+          while (pbNextField(&tensorType, &eField, &eWireType)) {
+            if (eField == 1 && eWireType == 0) {
+              info->elemType = (int) pbVarint(&tensorType);
+            } else {
+              pbSkip(&tensorType, eWireType);
+            }
+          }
+          type.error |= tensorType.error;
+        } else {
+          pbSkip(&type, tWireType);
+        }
+      }
+      r->error |= type.error;
+    } else {
+      pbSkip(r, wireType);
+    }
+  }
+}
+
+static void parseGraph(struct pbReader* r, struct onnxGraph* graph) {
+  int field, wireType;
+  while (pbNextField(r, &field, &wireType)) {
+    if (wireType != 2 || (field != 1 && field != 5 && field != 11 && field != 12)) {
+      pbSkip(r, wireType);
+      continue;
+    }
+    struct pbReader sub = pbSubMessage(r);
+    switch (field) {
+    case 1:
+      parseNode(&sub, appendElement((void**) &graph->nodes, &graph->nNodes, sizeof(struct onnxNode)));
+      break;
+    case 5:
+      parseTensor(&sub, appendElement((void**) &graph->initializers, &graph->nInitializers, sizeof(struct onnxTensor)));
+      break;
+    case 11:
+      parseValueInfo(&sub, appendElement((void**) &graph->inputs, &graph->nInputs, sizeof(struct onnxValueInfo)));
+      break;
+    case 12:
+      parseValueInfo(&sub, appendElement((void**) &graph->outputs, &graph->nOutputs, sizeof(struct onnxValueInfo)));
+      break;
+    }
+    r->error |= sub.error;
+  }
+}
+
+static void freeGraph(struct onnxGraph* graph) {
+  free(graph->nodes);
+  free(graph->initializers);
+  free(graph->inputs);
+  free(graph->outputs);
+}
+
+static const struct onnxTensor* findInitializer(const struct onnxGraph* graph, struct pbString name) {
+  for (size_t i = 0; i < graph->nInitializers; i++) {
+    if (pbStringEqual(graph->initializers[i].name, name)) {
+      return &graph->initializers[i];
+    }
+  }
+  return NULL;
+}
+
+/* Number of elements of initializer, 0 if data is missing, e.g. external data,
+ * a dimension isn't positive or the size overflows */
+static size_t tensorSize(const struct onnxTensor* tensor) {
+  const size_t elementSize = tensor->dataIsDouble ? sizeof(double) : sizeof(float);
+  size_t n = 1;
+  if (tensor->nDims > ONNX_MAX_DIMS || (tensor->dataType != ONNX_FLOAT && tensor->dataType != ONNX_DOUBLE)) {
+    return 0;
+  }
+  for (int i = 0; i < tensor->nDims; i++) {
+    if (tensor->dims[i] <= 0 || (uint64_t) tensor->dims[i] > SIZE_MAX / elementSize / n) {
+      return 0;
+    }
+    n *= (size_t) tensor->dims[i];
+  }
+  if (tensor->data == NULL || tensor->dataLen < n * elementSize) {
+    return 0;
+  }
+  return n;
+}
+
+static double tensorValue(const struct onnxTensor* tensor, size_t k) {
+  if (tensor->dataIsDouble) {
+    double value;
+    memcpy(&value, tensor->data + k*sizeof(double), sizeof(double));
+    return value;
+  } else {
+    float value;
+    memcpy(&value, tensor->data + k*sizeof(float), sizeof(float));
+    return value;
+  }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Model                                                                      */
+/* ------------------------------------------------------------------------- */
+
+/* Layer in double precision while building the model */
+struct layerSpec {
+  size_t nIn;
+  size_t nOut;
+  double* w;                          /* nOut x nIn, row-major */
+  double* b;                          /* length nOut */
+  enum mlpActivation activation;
+};
+
+static void* alignedCalloc(size_t size) {
+  void* ptr;
+  size = (size + MLP_ALIGNMENT - 1) / MLP_ALIGNMENT * MLP_ALIGNMENT;
+#ifdef _WIN32
+  ptr = _aligned_malloc(size, MLP_ALIGNMENT);
+#else
+  if (posix_memalign(&ptr, MLP_ALIGNMENT, size) != 0) {
+    ptr = NULL;
+  }
+#endif
+  if (ptr != NULL) {
+    memset(ptr, 0, size);
+  }
+  return ptr;
+}
+
+static void alignedFree(void* ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+/* Round n up to full cache lines of elements of size elementSize */
+static size_t paddedLength(size_t n, size_t elementSize) {
+  const size_t perLine = MLP_ALIGNMENT / elementSize;
+  return (n + perLine - 1) / perLine * perLine;
+}
+
+/**
+ * @brief Add dense layer of Gemm or MatMul node to layer specs.
+ *
+ * @return const char*  NULL on success, reason why node isn't supported otherwise.
+ */
+static const char* addDenseLayer(const struct onnxGraph* graph, const struct onnxNode* node, int isGemm,
+                                 struct layerSpec** layers, size_t* nLayers) {
+  const struct onnxTensor* B = node->nInputs > 1 ? findInitializer(graph, node->inputs[1]) : NULL;
+  const struct onnxTensor* C = isGemm && node->nInputs > 2 ? findInitializer(graph, node->inputs[2]) : NULL;
+  const int transB = isGemm && node->transB;
+  const double alpha = isGemm ? node->alpha : 1.0;
+  const double beta = isGemm ? node->beta : 1.0;
+
+  if (B == NULL || B->nDims != 2 || tensorSize(B) == 0) {
+    return "weights are no 2D initializer";
+  }
+  if (isGemm && node->transA) {
+    return "Gemm with transA";
+  }
+  if (isGemm && node->nInputs > 2 && (C == NULL || tensorSize(C) == 0)) {
+    return "bias of Gemm is no initializer";
+  }
+
+  const size_t nIn = (size_t)(transB ? B->dims[1] : B->dims[0]);
+  const size_t nOut = (size_t)(transB ? B->dims[0] : B->dims[1]);
+  if (C != NULL && tensorSize(C) != nOut && tensorSize(C) != 1) {
+    return "bias of Gemm can't be broadcast";
+  }
+
+  if (nOut > SIZE_MAX / sizeof(double) / nIn) {
+    return "weights are too large";
+  }
+  double* w = malloc(nIn * nOut * sizeof(double));
+  double* b = calloc(nOut, sizeof(double));
+  if (w == NULL || b == NULL) {
+    free(w);
+    free(b);
+    return "out of memory";
+  }
+
+  struct layerSpec* layer = appendElement((void**) layers, nLayers, sizeof(struct layerSpec));
+  layer->nIn = nIn;
+  layer->nOut = nOut;
+  layer->w = w;
+  layer->b = b;
+  layer->activation = MLP_ACT_NONE;
+  for (size_t i = 0; i < nOut; i++) {
+    for (size_t j = 0; j < nIn; j++) {
+      layer->w[i*nIn + j] = alpha * tensorValue(B, transB ? i*nIn + j : j*nOut + i);
+    }
+    if (C != NULL) {
+      layer->b[i] = beta * tensorValue(C, tensorSize(C) == 1 ? 0 : i);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Translate chain of ONNX nodes from input to output into dense layers.
+ *
+ * @return const char*  NULL on success, reason why graph isn't supported otherwise.
+ */
+static const char* buildLayers(const struct onnxGraph* graph, struct pbString input, struct pbString output,
+                               struct layerSpec** layers, size_t* nLayers) {
+  struct pbString current = input;
+  int layerOpen = 0;                  /* Last layer can still get bias or activation */
+  const char* reason;
+
+  for (size_t n = 0; n < graph->nNodes; n++) {
+    const struct onnxNode* node = &graph->nodes[n];
+    int consumesCurrent = node->nInputs > 0 && pbStringEqual(node->inputs[0], current);
+
+    if (node->nOutputs != 1 || node->nInputs > ONNX_MAX_NODE_INPUTS) {
+      return "node with multiple outputs or too many inputs";
+    }
+    if (pbStringIs(node->opType, "Add") && node->nInputs == 2 && !consumesCurrent) {
+      /* Bias can be first input of Add */
+      consumesCurrent = pbStringEqual(node->inputs[1], current);
+    }
+    if (!consumesCurrent) {
+      return "graph is no chain of layers";
+    }
+
+    if (pbStringIs(node->opType, "Gemm") || pbStringIs(node->opType, "MatMul")) {
+      reason = addDenseLayer(graph, node, pbStringIs(node->opType, "Gemm"), layers, nLayers);
+      if (reason != NULL) {
+        return reason;
+      }
+      layerOpen = 1;
+    } else if (pbStringIs(node->opType, "Add")) {
+      struct pbString biasName = pbStringEqual(node->inputs[0], current) ? node->inputs[1] : node->inputs[0];
+      const struct onnxTensor* bias = findInitializer(graph, biasName);
+      struct layerSpec* layer = &(*layers)[*nLayers - 1];
+      if (!layerOpen || layer->activation != MLP_ACT_NONE) {
+        return "Add is no bias of a dense layer";
+      }
+      if (bias == NULL || (tensorSize(bias) != layer->nOut && tensorSize(bias) != 1)) {
+        return "bias of Add is no initializer or can't be broadcast";
+      }
+      for (size_t i = 0; i < layer->nOut; i++) {
+        layer->b[i] += tensorValue(bias, tensorSize(bias) == 1 ? 0 : i);
+      }
+    } else if (pbStringIs(node->opType, "Tanh") || pbStringIs(node->opType, "Relu") || pbStringIs(node->opType, "Sigmoid")) {
+      if (!layerOpen) {
+        return "activation without dense layer";
+      }
+      (*layers)[*nLayers - 1].activation = pbStringIs(node->opType, "Tanh") ? MLP_ACT_TANH :
+                                           pbStringIs(node->opType, "Relu") ? MLP_ACT_RELU : MLP_ACT_SIGMOID;
+      layerOpen = 0;
+    } else if (!pbStringIs(node->opType, "Identity")) {
+      return "unsupported operator";
+    }
+    current = node->output;
+  }
+
+  if (!pbStringEqual(current, output)) {
+    return "graph output isn't produced by last node";
+  }
+  if (*nLayers == 0) {
+    return "no dense layer";
+  }
+  return NULL;
+}
+
+static void freeLayerSpecs(struct layerSpec* layers, size_t nLayers) {
+  for (size_t i = 0; i < nLayers; i++) {
+    free(layers[i].w);
+    free(layers[i].b);
+  }
+  free(layers);
+}
+
+/**
+ * @brief Pack layers into aligned weights of element type of model.
+ */
+static struct denseMLP* packDenseMLP(const struct layerSpec* specs, size_t nLayers, int isDouble) {
+  const size_t elementSize = isDouble ? sizeof(double) : sizeof(float);
+  struct denseMLP* mlp = calloc(1, sizeof(struct denseMLP));
+  size_t bufferLength = 0;
+
+  mlp->isDouble = isDouble;
+  mlp->nLayers = nLayers;
+  mlp->nInputs = specs[0].nIn;
+  mlp->nOutputs = specs[nLayers-1].nOut;
+  mlp->layers = calloc(nLayers, sizeof(struct denseLayer));
+  for (size_t l = 0; l < nLayers; l++) {
+    struct denseLayer* layer = &mlp->layers[l];
+    layer->nIn = specs[l].nIn;
+    layer->nOut = specs[l].nOut;
+    layer->ldIn = paddedLength(layer->nIn, elementSize);
+    layer->ldOut = paddedLength(layer->nOut, elementSize);
+    layer->activation = specs[l].activation;
+    layer->weights = alignedCalloc(layer->nOut * layer->ldIn * elementSize);
+    layer->bias = alignedCalloc(layer->nOut * elementSize);
+    for (size_t i = 0; i < layer->nOut; i++) {
+      for (size_t j = 0; j < layer->nIn; j++) {
+        if (isDouble) {
+          ((double*) layer->weights)[i*layer->ldIn + j] = specs[l].w[i*layer->nIn + j];
+        } else {
+          ((float*) layer->weights)[i*layer->ldIn + j] = (float) specs[l].w[i*layer->nIn + j];
+        }
+      }
+      if (isDouble) {
+        ((double*) layer->bias)[i] = specs[l].b[i];
+      } else {
+        ((float*) layer->bias)[i] = (float) specs[l].b[i];
+      }
+    }
+    bufferLength = layer->ldIn > bufferLength ? layer->ldIn : bufferLength;
+    bufferLength = layer->ldOut > bufferLength ? layer->ldOut : bufferLength;
+  }
+  mlp->buffer[0] = alignedCalloc(bufferLength * elementSize);
+  mlp->buffer[1] = alignedCalloc(bufferLength * elementSize);
+
+  return mlp;
+}
+
+/**
+ * @brief Load ONNX model into dense MLP engine.
+ *
+ * Supported are models with one float or double input and output and a chain
+ * of Gemm or MatMul nodes with constant weights, optionally followed by Add
+ * of a constant bias and a Tanh, Relu or Sigmoid activation.
+ *
+ * @param pathToONNX          Path to ONNX model.
+ * @param nInputs             Expected number of inputs.
+ * @param nOutputs            Expected number of outputs.
+ * @param reason              On failure reason why the model isn't supported.
+ * @param reasonSize          Size of reason buffer.
+ * @return struct denseMLP*   Pointer to dense MLP or NULL if model isn't supported.
+ */
+struct denseMLP* loadDenseMLP(const char* pathToONNX, size_t nInputs, size_t nOutputs, char* reason, size_t reasonSize) {
+  struct onnxGraph graph;
+  struct layerSpec* specs = NULL;
+  size_t nLayers = 0;
+  struct denseMLP* mlp = NULL;
+  const char* error = NULL;
+  unsigned char* content = NULL;
+  long size;
+
+  memset(&graph, 0, sizeof graph);
+
+  /* Read model */
+  FILE* file = fopen(pathToONNX, "rb");
+  if (file == NULL) {
+    snprintf(reason, reasonSize, "can't open model");
+    return NULL;
+  }
+  if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0) {
+    content = malloc(size);
+    if (fread(content, 1, size, file) != (size_t) size) {
+      free(content);
+      content = NULL;
+    }
+  }
+  fclose(file);
+  if (content == NULL) {
+    snprintf(reason, reasonSize, "can't read model");
+    return NULL;
+  }
+
+  /* ModelProto.graph */
+  struct pbReader r = {content, content + size, 0};
+  int field, wireType;
+  while (pbNextField(&r, &field, &wireType)) {
+    if (field == 7 && wireType == 2) {
+      struct pbReader sub = pbSubMessage(&r);
+      parseGraph(&sub, &graph);
+      r.error |= sub.error;
+    } else {
+      pbSkip(&r, wireType);
+    }
+  }
+
+  /* Graph inputs can list initializers, the remaining one is the model input */
+  const struct onnxValueInfo* input = NULL;
+  int nModelInputs = 0;
+  for (size_t i = 0; i < graph.nInputs; i++) {
+    if (findInitializer(&graph, graph.inputs[i].name) == NULL) {
+      input = &graph.inputs[i];
+      nModelInputs++;
+    }
+  }
+
+  if (r.error) {
+    error = "can't parse model";
+  } else if (nModelInputs != 1 || graph.nOutputs != 1) {
+    error = "model needs exactly one input and one output";
+  } else if (input->elemType != ONNX_FLOAT && input->elemType != ONNX_DOUBLE) {
+    error = "element type isn't float or double";
+  } else {
+    error = buildLayers(&graph, input->name, graph.outputs[0].name, &specs, &nLayers);
+  }
+  if (error == NULL) {
+    if (specs[0].nIn != nInputs || specs[nLayers-1].nOut != nOutputs) {
+      error = "number of inputs or outputs doesn't match";
+    }
+    for (size_t l = 1; l < nLayers && error == NULL; l++) {
+      if (specs[l].nIn != specs[l-1].nOut) {
+        error = "shapes of consecutive layers don't match";
+      }
+    }
+  }
+
+  if (error == NULL) {
+    mlp = packDenseMLP(specs, nLayers, input->elemType == ONNX_DOUBLE);
+  } else {
+    snprintf(reason, reasonSize, "%s", error);
+  }
+
+  freeLayerSpecs(specs, nLayers);
+  freeGraph(&graph);
+  free(content);
+  return mlp;
+}
+
+/**
+ * @brief Free dense MLP.
+ *
+ * @param mlp   Pointer to dense MLP.
+ */
+void freeDenseMLP(struct denseMLP* mlp) {
+  if (mlp == NULL) {
+    return;
+  }
+  for (size_t l = 0; l < mlp->nLayers; l++) {
+    alignedFree(mlp->layers[l].weights);
+    alignedFree(mlp->layers[l].bias);
+  }
+  free(mlp->layers);
+  alignedFree(mlp->buffer[0]);
+  alignedFree(mlp->buffer[1]);
+  free(mlp);
+}
+
+/**
+ * @brief Evaluate dense MLP for one input vector.
+ *
+ * Not thread-safe, every instance needs its own dense MLP.
+ *
+ * @param mlp       Pointer to dense MLP.
+ * @param input     Input vector, length nInputs.
+ * @param output    Output vector on return, length nOutputs.
+ */
+void evalDenseMLP(struct denseMLP* mlp, const double* input, double* output) {
+  int current = 0;
+  pthread_once(&selectKernelOnce, selectDenseKernels);
+
+  /* Copy input, padding has to stay zero */
+  if (mlp->isDouble) {
+    double* x = mlp->buffer[0];
+    memcpy(x, input, mlp->nInputs * sizeof(double));
+    memset(x + mlp->nInputs, 0, (mlp->layers[0].ldIn - mlp->nInputs) * sizeof(double));
+  } else {
+    float* x = mlp->buffer[0];
+    for (size_t i = 0; i < mlp->nInputs; i++) {
+      x[i] = (float) input[i];
+    }
+    memset(x + mlp->nInputs, 0, (mlp->layers[0].ldIn - mlp->nInputs) * sizeof(float));
+  }
+
+  for (size_t l = 0; l < mlp->nLayers; l++) {
+    const struct denseLayer* layer = &mlp->layers[l];
+    if (mlp->isDouble) {
+      double* y = mlp->buffer[1 - current];
+      gemvDouble(layer->weights, layer->bias, mlp->buffer[current], y, layer->nOut, layer->ldIn, layer->activation);
+      memset(y + layer->nOut, 0, (layer->ldOut - layer->nOut) * sizeof(double));
+    } else {
+      float* y = mlp->buffer[1 - current];
+      gemvFloat(layer->weights, layer->bias, mlp->buffer[current], y, layer->nOut, layer->ldIn, layer->activation);
+      memset(y + layer->nOut, 0, (layer->ldOut - layer->nOut) * sizeof(float));
+    }
+    current = 1 - current;
+  }
+
+  if (mlp->isDouble) {
+    memcpy(output, mlp->buffer[current], mlp->nOutputs * sizeof(double));
+  } else {
+    const float* y = mlp->buffer[current];
+    for (size_t i = 0; i < mlp->nOutputs; i++) {
+      output[i] = y[i];
+    }
+  }
+}
+
+/**
+ * @brief Return 1 if dense MLP computes in double precision, 0 for float.
+ */
+int denseMLPIsDouble(const struct denseMLP* mlp) {
+  return mlp->isDouble;
+}
+
+/**
+ * @brief Return number of dense layers.
+ */
+size_t denseMLPNumLayers(const struct denseMLP* mlp) {
+  return mlp->nLayers;
+}
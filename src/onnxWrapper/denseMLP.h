@@ -0,0 +1,34 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef DENSE_MLP_H
+#define DENSE_MLP_H
+
+#include <stddef.h>
+
+struct denseMLP;
+
+/* Function prototypes */
+struct denseMLP* loadDenseMLP(const char* pathToONNX, size_t nInputs, size_t nOutputs, char* reason, size_t reasonSize);
+void freeDenseMLP(struct denseMLP* mlp);
+void evalDenseMLP(struct denseMLP* mlp, const double* input, double* output);
+int denseMLPIsDouble(const struct denseMLP* mlp);
+size_t denseMLPNumLayers(const struct denseMLP* mlp);
+
+#endif // DENSE_MLP_H
@@ -0,0 +1,183 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Pre-inference gate for the training domain of ONNX models.
+ *
+ * The grid occupancy index is written by writeDomainIndex in Julia. The file
+ * starts with the magic "NLSNNDOM", followed by uint32 version, uint32 nDims,
+ * uint32 nBins, nDims doubles min, nDims doubles max, uint64 nCells and nCells
+ * sorted uint64 cell hashes. A cell hash is the 64 bit FNV-1a hash of the
+ * uint32 cell coordinates in little-endian byte order.
+ */
+
+#include "domainGate.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DOMAIN_INDEX_MAGIC "NLSNNDOM"
+#define DOMAIN_INDEX_VERSION 1
+
+/**
+ * @brief Hash cell coordinate of x.
+ *
+ * @param index   Pointer to domain index.
+ * @param x       Input vector of length nDims.
+ * @param hash    Pointer to hash on return.
+ * @return int    Return 0 if x is outside of grid bounds, 1 otherwise.
+ */
+static int cellHash(const struct domainIndex* index, const double* x, uint64_t* hash) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+
+  for (size_t i = 0; i < index->nDims; i++) {
+    double width = index->max[i] - index->min[i];
+    uint32_t cell = 0;
+    if (!(x[i] >= index->min[i] && x[i] <= index->max[i])) {
+      return 0;
+    }
+    if (width > 0) {
+      double c = floor((x[i] - index->min[i]) / width * index->nBins);
+      cell = c >= index->nBins ? index->nBins - 1 : (uint32_t) c;
+    }
+    for (int b = 0; b < 4; b++) {
+      h ^= (cell >> (8*b)) & 0xff;
+      h *= 0x100000001b3ULL;
+    }
+  }
+
+  *hash = h;
+  return 1;
+}
+
+/**
+ * @brief Load grid occupancy index of training data.
+ *
+ * @param path                  Path to domain index file.
+ * @return struct domainIndex*  Pointer to domain index or NULL if file
+ *                              can't be read.
+ */
+struct domainIndex* loadDomainIndex(const char* path) {
+  char magic[8];
+  uint32_t header[3];
+  uint64_t nCells;
+  struct domainIndex* index;
+
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  if (fread(magic, 1, 8, file) != 8 || memcmp(magic, DOMAIN_INDEX_MAGIC, 8) != 0 ||
+      fread(header, sizeof header[0], 3, file) != 3 || header[0] != DOMAIN_INDEX_VERSION) {
+    fprintf(stderr, "loadDomainIndex: %s is no valid domain index.\n", path);
+    fclose(file);
+    return NULL;
+  }
+
+  index = calloc(1, sizeof *index);
+  index->nDims = header[1];
+  index->nBins = header[2];
+  index->min = calloc(index->nDims, sizeof index->min[0]);
+  index->max = calloc(index->nDims, sizeof index->max[0]);
+  if (fread(index->min, sizeof index->min[0], index->nDims, file) != index->nDims ||
+      fread(index->max, sizeof index->max[0], index->nDims, file) != index->nDims ||
+      fread(&nCells, sizeof nCells, 1, file) != 1) {
+    fprintf(stderr, "loadDomainIndex: Failed to read %s.\n", path);
+    freeDomainIndex(index);
+    fclose(file);
+    return NULL;
+  }
+  index->nCells = (size_t) nCells;
+  index->cells = malloc(index->nCells * sizeof index->cells[0]);
+  if (fread(index->cells, sizeof index->cells[0], index->nCells, file) != index->nCells) {
+    fprintf(stderr, "loadDomainIndex: Failed to read %s.\n", path);
+    freeDomainIndex(index);
+    fclose(file);
+    return NULL;
+  }
+
+  fclose(file);
+  return index;
+}
+
+/**
+ * @brief Free domain index.
+ *
+ * @param index   Pointer to domain index or NULL.
+ */
+void freeDomainIndex(struct domainIndex* index) {
+  if (index == NULL) {
+    return;
+  }
+  free(index->min);
+  free(index->max);
+  free(index->cells);
+  free(index);
+}
+
+/**
+ * @brief Return 1 if vector x is inside box [min, max].
+ *
+ * In contrast to isInBounds the bounds itself are part of the domain.
+ *
+ * @param x       Vector x.
+ * @param min     Array with minimum allowed values for x.
+ * @param max     Array with maximum allowed values for x.
+ * @param length  Length of arrays x, min, max.
+ * @return int    Return 1 if for all elements min[i]<=x[i]<=max[i] holds true.
+ *                Return 0 otherwise.
+ */
+int inDomainBox(const double* x, const double* min, const double* max, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (!(x[i] >= min[i] && x[i] <= max[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Return 1 if grid cell of x contains training data.
+ *
+ * @param index   Pointer to domain index.
+ * @param x       Input vector, only first nDims elements are checked.
+ * @return int    Return 1 if cell of x is occupied, 0 otherwise.
+ */
+int inDomainIndex(const struct domainIndex* index, const double* x) {
+  uint64_t hash;
+  size_t lo = 0;
+  size_t hi = index->nCells;
+
+  if (!cellHash(index, x, &hash)) {
+    return 0;
+  }
+
+  /* Binary search in sorted cell hashes */
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->cells[mid] < hash) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < index->nCells && index->cells[lo] == hash;
+}
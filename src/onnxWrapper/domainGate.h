@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef DOMAIN_GATE_H
+#define DOMAIN_GATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Domain gate applied before ONNX evaluation */
+enum domainGateMode {
+  DOMAIN_GATE_NONE,                   /* Evaluate ONNX model for every input */
+  DOMAIN_GATE_BOX,                    /* Inputs have to be inside min/max box */
+  DOMAIN_GATE_GRID                    /* Inputs have to be inside box and in occupied grid cell */
+};
+
+/* Grid occupancy index of training data */
+struct domainIndex {
+  size_t nDims;                       /* Number of gated inputs */
+  unsigned int nBins;                 /* Number of bins per dimension */
+  double* min;                        /* Lower grid bounds, length nDims */
+  double* max;                        /* Upper grid bounds, length nDims */
+  size_t nCells;                      /* Number of occupied cells */
+  uint64_t* cells;                    /* Sorted hashes of occupied cells */
+};
+
+/* Function prototypes */
+struct domainIndex* loadDomainIndex(const char* path);
+void freeDomainIndex(struct domainIndex* index);
+int inDomainBox(const double* x, const double* min, const double* max, size_t length);
+int inDomainIndex(const struct domainIndex* index, const double* x);
+
+#endif // DOMAIN_GATE_H
@@ -19,16 +19,16 @@
 
 #include "onnxWrapper.h"
 #include "errorControl.h"
+#include "acceptanceKernel.h"
 
+#include <float.h>
 #include <math.h>
-
-/* Private function prototypes */
-void float2DoubleArray(const float* floatArray, double* doubleArray, const size_t len);
+#include <string.h>
 
 /**
  * @brief Evaluate residuum function.
  *
- * Converts model_output to double array and evaluate residuum function.
+ * Evaluates residuum function at model output x.
  *
  * @param f         Residuum function.
  * @param userData  User data provided by caller.
@@ -36,7 +36,6 @@ void float2DoubleArray(const float* floatArray, double* doubleArray, const size_
  */
 void evalResidual(resFunction f, void* userData, struct OrtWrapperData* ortData) {
   const int iflag = 0; /* unused by resFunc */
-  float2DoubleArray(ortData->model_output, ortData->x, ortData->nRes);
   f(userData, ortData->x, ortData->res, &iflag);
 }
 
@@ -61,14 +60,14 @@ double norm(double* vec, size_t length) {
 /**
  * @brief Return 1 if vector x is inside bounds of min and max.
  *
- * @param x       Vector x.
+ * @param inputs  Vector x.
  * @param min     Array with minimum allowed values for x.
  * @param max     Array with maximum allowed values for x.
  * @param length  Length of arrays x, min, max.
  * @return int    Return 1 if for all elements min[i]<x[i]<max[i] holds true.
  *                Return 0 otherwise.
  */
-int isInBounds(float* inputs, double* min, double* max, size_t length) {
+int isInBounds(double* inputs, double* min, double* max, size_t length) {
   int inBounds = 1;
   for(size_t i=0; i<length; i++) {
     if (inputs[i] <= min[i] || inputs[i] >= max[i]) {
@@ -89,19 +88,19 @@ int isInBounds(float* inputs, double* min, double* max, size_t length) {
 void printResiduum(unsigned int id, double time, struct OrtWrapperData* ortData) {
   printf("Non-linear system %u residuum at time %f:\n", id, time);
   printf("res = [");
-  for(int i = 0; i < ortData->nRes-1; i++) {
+  for(size_t i = 0; i < ortData->nRes-1; i++) {
     printf("%e, ", ortData->res[i]);
   }
   printf("%e]\n", ortData->res[ortData->nRes-1]);
 }
 
 /**
- * @brief Compute scaled residual norm and save to CSV file.
+ * @brief Compute scaled residual norm and save to residual log.
  *
- * Checks if vector x was in bounds of min and max and saves boolean value to CSV file.
+ * Checks if vector x was in bounds of min and max and saves boolean value to log.
  * Computes euclidean norm of residuum and relative error of residuum and saves those to
- * CSV file as well.
- * Returns -1 if CSV file is not available.
+ * log as well. Writing to the log file is done asynchronously.
+ * Returns -1 if residual log is not available.
  *
  * @param time      Simulation time.
  * @param ortData   Pointer to ortData with residuum.
@@ -109,40 +108,447 @@ void printResiduum(unsigned int id, double time, struct OrtWrapperData* ortData)
  */
 double residualNorm(double time, struct OrtWrapperData* ortData) {
 
-  if(ortData->csvFile == NULL) {
-    printf("writeResiduum: Warning, no csvFile available.");
+  if(ortData->resLog == NULL) {
+    printf("writeResiduum: Warning, no residual log available.");
     return -1;
   }
 
-  if(ortData->csvFile == NULL) {
-    printf("writeResiduum: Warning, no csvFile available.");
-    return -1;
+  int inBounds = isInBounds(ortData->input, ortData->min, ortData->max, ortData->nInputs);
+
+  double scaled_res_norm = norm(ortData->res, ortData->nRes);
+
+  writeResidualLog(ortData->resLog, time, inBounds, scaled_res_norm, ortData->res);
+
+  return scaled_res_norm;
+}
+
+/**
+ * @brief Scale residual and compute its norm without counting or logging it.
+ *
+ * Each residual is scaled with the cached maximum norm of the corresponding
+ * Jacobian row, see updateResidualScaling. The norm of the scaled residual
+ * and the bounds check of the inputs are computed in the same pass, see
+ * acceptanceKernelScaled. Pass the result to recordResidualCheck once the
+ * check decided the call.
+ *
+ * @param ortData     Pointer to ortData with residuum. Residuum is scaled in place.
+ * @param isRegular   Pointer to int. On return 1 if Jacobian is regular, 0 otherwise.
+ * @param inBounds    Pointer to int. On return 1 if inputs are inside training area, 0 otherwise.
+ * @return            Return norm of scaled residual.
+ */
+double checkScaledResidual(struct OrtWrapperData* ortData, int* isRegular, int* inBounds) {
+  struct acceptanceResult result;
+
+  acceptanceKernelScaled(ortData->scaling.valid ? ortData->scaling.scale : NULL, ortData->res, ortData->nRes,
+                         ortData->input, ortData->min, ortData->max, ortData->nInputs,
+                         &result);
+
+  *isRegular = result.isRegular;
+  *inBounds = result.inBounds;
+  return result.norm;
+}
+
+/**
+ * @brief Count and log residual check of checkScaledResidual.
+ *
+ * Counts inputs outside of the training area in the telemetry. Only regular
+ * predictions are saved to the residual log. Call at most once per call of
+ * the replaced equation.
+ *
+ * @param time        Simulation time.
+ * @param ortData     Pointer to ortData with scaled residuum.
+ * @param norm        Norm of scaled residual.
+ * @param isRegular   1 if Jacobian is regular, 0 otherwise.
+ * @param inBounds    1 if inputs are inside training area, 0 otherwise.
+ */
+void recordResidualCheck(double time, struct OrtWrapperData* ortData, double norm, int isRegular, int inBounds) {
+  if (!inBounds) {
+    ortData->telemetry.nOutOfBounds++;
+  }
+  if (isRegular && ortData->resLog != NULL) {
+    writeResidualLog(ortData->resLog, time, inBounds, norm, ortData->res);
   }
+}
 
-  int inBounds = isInBounds(ortData->model_input, ortData->min, ortData->max, ortData->nInputs);
+/**
+ * @brief Scale residual, compute its norm and save to residual log.
+ *
+ * See checkScaledResidual and recordResidualCheck.
+ *
+ * @param time        Simulation time.
+ * @param ortData     Pointer to ortData with residuum. Residuum is scaled in place.
+ * @param isRegular   Pointer to int. On return 1 if Jacobian is regular, 0 otherwise.
+ * @return            Return norm of scaled residual.
+ */
+double scaledResidualNorm(double time, struct OrtWrapperData* ortData, int* isRegular) {
+  int inBounds;
+  double norm = checkScaledResidual(ortData, isRegular, &inBounds);
 
-  double scaled_res_norm = norm(ortData->res, ortData->nRes);
+  recordResidualCheck(time, ortData, norm, *isRegular, inBounds);
+  return norm;
+}
+
+/**
+ * @brief Scaled residual norm of a prediction evaluated outside of the FMU.
+ *
+ * Same check as scaledResidualNorm for residual and Jacobian row scaling
+ * computed by the caller, e.g. to compare models on held-out training data.
+ * Needs ortData initialized with logResiduum.
+ *
+ * @param ortData     Pointer to ortData.
+ * @param input       Inputs of prediction, length nInputs.
+ * @param res         Residuum at prediction, length nRes.
+ * @param scale       Maximum norm of each Jacobian row, length nRes.
+ * @param isRegular   Pointer to int. On return 1 if Jacobian is regular, 0 otherwise.
+ * @return            Return norm of scaled residual.
+ */
+double scaledResidualNormAt(struct OrtWrapperData* ortData, const double* input, const double* res, const double* scale, int* isRegular) {
+  memcpy(ortData->input, input, ortData->nInputs * sizeof(double));
+  memcpy(ortData->res, res, ortData->nRes * sizeof(double));
+  memcpy(ortData->scaling.scale, scale, ortData->nRes * sizeof(double));
+  ortData->scaling.valid = 1;
+  return scaledResidualNorm(0.0, ortData, isRegular);
+}
+
+/**
+ * @brief Decide if residual scaling has to be updated.
+ *
+ * The Jacobian is evaluated again during events, if the scaling tolerance of
+ * the residual check policy is 0 or if the inputs or outputs changed by more
+ * than the tolerance relative to the state of the last update.
+ * If an update is due, the caller has to compute the maximum norm of each
+ * Jacobian row into ortData->scaling.scale and call updateResidualScaling.
+ *
+ * @param ortData     Pointer to ortData with current inputs and outputs.
+ * @param isEvent     Non-zero if called during event or initialization.
+ * @return int        Return 1 if scaling has to be updated, 0 otherwise.
+ */
+int residualScalingDue(struct OrtWrapperData* ortData, int isEvent) {
+  const double tol = ortData->check.policy.scalingTolerance;
+  const double* state = ortData->scaling.state;
 
-  fprintf(ortData->csvFile, "%f,", time);
-  fprintf(ortData->csvFile, "%i,", inBounds);
-  fprintf(ortData->csvFile, "%f,", scaled_res_norm);
-  for(int i = 0; i < ortData->nRes-1; i++) {
-    fprintf(ortData->csvFile, "%e,", ortData->res[i]);
+  if (!ortData->scaling.valid || isEvent || tol <= 0) {
+    return 1;
+  }
+  for (size_t i = 0; i < ortData->nInputs; i++) {
+    if (fabs(ortData->input[i] - state[i]) > tol * fmax(fabs(state[i]), 1.0)) {
+      return 1;
+    }
+  }
+  state += ortData->nInputs;
+  for (size_t i = 0; i < ortData->nRes; i++) {
+    if (fabs(ortData->x[i] - state[i]) > tol * fmax(fabs(state[i]), 1.0)) {
+      return 1;
+    }
   }
-  fprintf(ortData->csvFile, "%e\n", ortData->res[ortData->nRes-1]);
 
-  return scaled_res_norm;
+  ortData->scaling.nReuses++;
+  return 0;
 }
 
 /**
- * @brief Copy float array into double array.
+ * @brief Save state of new residual scaling.
  *
- * @param floatArray      Pointer to float array.
- * @param doubleArray     Pointer to double array.
- * @param len             Length of floatArray and doubleArray.
+ * @param ortData     Pointer to ortData, ortData->scaling.scale updated by caller.
+ * @param success     Non-zero if Jacobian was evaluated, otherwise all rows
+ *                    are treated as singular.
  */
-void float2DoubleArray(const float* floatArray, double* doubleArray, const size_t len) {
-  for(int i = 0; i < len; i++) {
-    doubleArray[i] = floatArray[i];
+void updateResidualScaling(struct OrtWrapperData* ortData, int success) {
+  struct ResidualScaling* scaling = &ortData->scaling;
+
+  if (!success) {
+    memset(scaling->scale, 0, ortData->nRes * sizeof(double));
+  }
+  memcpy(scaling->state, ortData->input, ortData->nInputs * sizeof(double));
+  memcpy(scaling->state + ortData->nInputs, ortData->x, ortData->nRes * sizeof(double));
+  scaling->valid = 1;
+  scaling->nUpdates++;
+}
+
+/**
+ * @brief Evaluate residuum function for all rows of last batched evaluation.
+ *
+ * For each row i the inputs of batch row i are set with setInputs and f is
+ * evaluated at output row i. Residuals of row i are saved
+ * in res[i*nRes, ..., (i+1)*nRes-1].
+ * ORT data has to be initialized with logResiduum.
+ *
+ * @param f           Residuum function.
+ * @param setInputs   Function setting input variables of f from a model input row.
+ * @param userData    User data provided by caller, passed to f and setInputs.
+ * @param ortData     Pointer to ORT data after evalModelBatch.
+ * @param batchSize   Number of rows of last batched evaluation.
+ * @param res         Pointer to residual array of size batchSize*nRes on return.
+ */
+void evalResidualBatch(resFunction f, setInputsFunction setInputs, void* userData, struct OrtWrapperData* ortData, size_t batchSize, double* res) {
+  const int iflag = 0; /* unused by resFunc */
+  const size_t nInputs = ortData->nInputs;
+  const size_t nRes = ortData->nRes;
+
+  for(size_t i = 0; i < batchSize; i++) {
+    setInputs(userData, &ortData->batch_input[i*nInputs]);
+    f(userData, &ortData->batch_output[i*nRes], &res[i*nRes], &iflag);
+  }
+}
+
+/**
+ * @brief Scaled residual norm of each row of a batched evaluation.
+ *
+ * Same norm as scaledResidualNorm uses for acceptance, each residual is
+ * divided by the maximum norm of the Jacobian rows at its batch row.
+ *
+ * @param scale       Maximum norm of each Jacobian row for each batch row, size batchSize*nRes.
+ * @param res         Pointer to residual array of size batchSize*nRes. Residuum is scaled in place.
+ * @param nRes        Length of one residual row.
+ * @param batchSize   Number of rows.
+ * @param norms       Pointer to array of size batchSize with norm of each scaled row on return.
+ * @param isRegular   Pointer to array of size batchSize. On return 1 for rows with regular Jacobian, 0 otherwise.
+ */
+void residualNormBatch(const double* scale, double* res, size_t nRes, size_t batchSize, double* norms, int* isRegular) {
+  struct acceptanceResult result;
+
+  for(size_t i = 0; i < batchSize; i++) {
+    acceptanceKernelScaled(&scale[i*nRes], &res[i*nRes], nRes, NULL, NULL, NULL, 0, &result);
+    norms[i] = result.norm;
+    isRegular[i] = result.isRegular;
+  }
+}
+
+/**
+ * @brief Check if inputs are inside training domain before evaluating ONNX model.
+ *
+ * With DOMAIN_GATE_BOX the inputs have to be inside the training area
+ * boundaries min and max. With DOMAIN_GATE_GRID the grid cell of the inputs
+ * additionally has to contain training data. Falls back to the box if no
+ * domain index was loaded.
+ *
+ * @param ortData   Pointer to ORT data with inputs set.
+ * @param mode      Domain gate mode, see enum domainGateMode.
+ * @return int      Return 1 if ONNX model should be evaluated, 0 if inputs
+ *                  are outside training domain.
+ */
+int inTrainingDomain(struct OrtWrapperData* ortData, int mode) {
+  int inDomain = 1;
+
+  if (mode == DOMAIN_GATE_NONE) {
+    return 1;
+  }
+
+  ortData->nDomainCalls++;
+  inDomain = inDomainBox(ortData->input, ortData->min, ortData->max, ortData->nInputs);
+  if (inDomain && mode == DOMAIN_GATE_GRID && ortData->domain != NULL) {
+    inDomain = inDomainIndex(ortData->domain, ortData->input);
+  }
+  if (!inDomain) {
+    ortData->nDomainRejects++;
   }
+
+  return inDomain;
+}
+
+/**
+ * @brief Print domain gate statistics to stdout.
+ *
+ * @param equationName  Name of equation.
+ * @param ortData       Pointer to ORT data.
+ */
+void printDomainGateStats(const char* equationName, const struct OrtWrapperData* ortData) {
+  printf("%s domain gate: calls: %lu, rejected: %lu\n",
+         equationName, ortData->nDomainCalls, ortData->nDomainRejects);
+}
+
+/**
+ * @brief Initialize residual check scheduling.
+ *
+ * Starts with the policy interval.
+ * If policy is NULL every call is checked.
+ *
+ * @param state     Pointer to residual check state.
+ * @param policy    Pointer to residual check policy or NULL.
+ */
+void initResidualCheck(struct ResidualCheckState* state, const struct ResidualCheckPolicy* policy) {
+  memset(state, 0, sizeof *state);
+  if (policy != NULL) {
+    state->policy = *policy;
+  }
+  if (state->policy.interval == 0) {
+    state->policy.interval = 1;
+  }
+  if (state->policy.maxInterval < state->policy.interval) {
+    state->policy.maxInterval = state->policy.interval;
+  }
+  state->interval = state->policy.interval;
+  state->lastEventTime = -DBL_MAX;
+}
+
+/**
+ * @brief Decide if residual of current ONNX prediction has to be checked.
+ *
+ * Checks every interval-th call. Checks are forced during events and within
+ * the event window after the last event.
+ * If a check is due, the caller has to report the result with
+ * residualCheckResult.
+ *
+ * @param state     Pointer to residual check state.
+ * @param time      Simulation time.
+ * @param isEvent   Non-zero if called during event or initialization.
+ * @return int      Return 1 if residual has to be checked, 0 otherwise.
+ */
+int residualCheckDue(struct ResidualCheckState* state, double time, int isEvent) {
+  int forced;
+
+  state->nCalls++;
+  if (isEvent) {
+    state->lastEventTime = time;
+  }
+  forced = isEvent || time - state->lastEventTime <= state->policy.eventWindow;
+
+  if (++state->callsSinceCheck >= state->interval) {
+    state->callsSinceCheck = 0;
+    state->nChecks++;
+    return 1;
+  }
+  if (forced) {
+    state->callsSinceCheck = 0;
+    state->nChecks++;
+    state->nForced++;
+    return 1;
+  }
+
+  state->nSkipped++;
+  return 0;
+}
+
+/**
+ * @brief Update check interval with result of last residual check.
+ *
+ * After a reject every call is checked again. After backoffAccepts
+ * consecutive accepts the interval is doubled up to maxInterval.
+ * Without back-off the policy interval is restored instead.
+ *
+ * @param state     Pointer to residual check state.
+ * @param accepted  Non-zero if prediction was accepted.
+ */
+void residualCheckResult(struct ResidualCheckState* state, int accepted) {
+  const struct ResidualCheckPolicy* policy = &state->policy;
+
+  if (!accepted) {
+    state->nRejects++;
+    state->interval = 1;
+    state->consecutiveAccepts = 0;
+    return;
+  }
+
+  state->consecutiveAccepts++;
+  if (policy->backoffAccepts > 0) {
+    if (state->consecutiveAccepts >= policy->backoffAccepts && state->interval < policy->maxInterval) {
+      state->interval = 2*state->interval < policy->maxInterval ? 2*state->interval : policy->maxInterval;
+      state->consecutiveAccepts = 0;
+    }
+  } else if (state->interval < policy->interval) {
+    state->interval = policy->interval;
+  }
+}
+
+/**
+ * @brief Print residual check statistics to stdout.
+ *
+ * @param equationName  Name of equation.
+ * @param state         Pointer to residual check state.
+ */
+void printResidualCheckStats(const char* equationName, const struct ResidualCheckState* state) {
+  printf("%s residual checks: calls: %lu, checked: %lu, skipped: %lu, forced: %lu, rejected: %lu\n",
+         equationName, state->nCalls, state->nChecks, state->nSkipped, state->nForced, state->nRejects);
+}
+
+/**
+ * @brief Print number of Jacobian evaluations and reused residual scalings.
+ *
+ * @param equationName  Name of equation.
+ * @param scaling       Pointer to residual scaling.
+ */
+void printResidualScalingStats(const char* equationName, const struct ResidualScaling* scaling) {
+  printf("%s residual scaling: Jacobian evaluations: %lu, reused: %lu\n",
+         equationName, scaling->nUpdates, scaling->nReuses);
+}
+
+/**
+ * @brief Add solver statistics of one fallback step.
+ *
+ * @param stats         Pointer to fallback statistics.
+ * @param warmStart     Non-zero if solver was started from NN prediction.
+ * @param nIterations   Solver iterations of this step.
+ * @param nFEvals       Residual evaluations of this step.
+ * @param time          Solver time of this step in seconds.
+ */
+void recordFallback(struct FallbackStats* stats, int warmStart, unsigned long nIterations, unsigned long nFEvals, double time) {
+  if (warmStart) {
+    stats->nWarm++;
+    stats->warmIterations += nIterations;
+    stats->warmFEvals += nFEvals;
+    stats->warmTime += time;
+  } else {
+    stats->nCold++;
+    stats->coldIterations += nIterations;
+    stats->coldFEvals += nFEvals;
+    stats->coldTime += time;
+  }
+}
+
+/**
+ * @brief Print mean solver iterations of cold and warm started fallbacks to stdout.
+ *
+ * @param equationName  Name of equation.
+ * @param stats         Pointer to fallback statistics.
+ */
+void printFallbackStats(const char* equationName, const struct FallbackStats* stats) {
+  printf("%s NLS fallback: cold: %lu, mean iterations: %f, mean f evals: %f; warm: %lu, mean iterations: %f, mean f evals: %f\n",
+         equationName,
+         stats->nCold, stats->nCold ? (double) stats->coldIterations / stats->nCold : 0.0,
+         stats->nCold ? (double) stats->coldFEvals / stats->nCold : 0.0,
+         stats->nWarm, stats->nWarm ? (double) stats->warmIterations / stats->nWarm : 0.0,
+         stats->nWarm ? (double) stats->warmFEvals / stats->nWarm : 0.0);
+}
+
+/**
+ * @brief Count outcome of one call of a replaced equation.
+ *
+ * @param telemetry   Pointer to telemetry of equation.
+ * @param outcome     Outcome of call.
+ */
+void recordNNOutcome(struct NNTelemetry* telemetry, enum nnOutcome outcome) {
+  telemetry->nCalls++;
+  telemetry->nOutcome[outcome]++;
+}
+
+/**
+ * @brief Copy telemetry of equation to array.
+ *
+ * Values are ordered as in enum nnTelemetryIndex. Fallback time is in
+ * seconds, all other values are counts.
+ *
+ * @param ortData     Pointer to ORT data of equation.
+ * @param values      Array of length nValues.
+ * @param nValues     Maximum number of values to copy.
+ * @return size_t     Number of copied values.
+ */
+size_t nnTelemetryValues(const struct OrtWrapperData* ortData, double* values, size_t nValues) {
+  const struct NNTelemetry* telemetry = &ortData->telemetry;
+  const struct FallbackStats* fallback = &ortData->fallback;
+  double all[NN_TELEMETRY_N];
+  size_t n = nValues < NN_TELEMETRY_N ? nValues : NN_TELEMETRY_N;
+
+  all[NN_TELEMETRY_CALLS] = telemetry->nCalls;
+  all[NN_TELEMETRY_ACCEPTED] = telemetry->nOutcome[NN_ACCEPTED];
+  all[NN_TELEMETRY_UNCHECKED] = telemetry->nOutcome[NN_UNCHECKED];
+  all[NN_TELEMETRY_REJECTED_RESIDUAL] = telemetry->nOutcome[NN_REJECTED_RESIDUAL];
+  all[NN_TELEMETRY_REJECTED_SINGULAR] = telemetry->nOutcome[NN_REJECTED_SINGULAR];
+  all[NN_TELEMETRY_REJECTED_DOMAIN] = telemetry->nOutcome[NN_REJECTED_DOMAIN];
+  all[NN_TELEMETRY_OUT_OF_BOUNDS] = telemetry->nOutOfBounds;
+  all[NN_TELEMETRY_FALLBACKS] = fallback->nCold + fallback->nWarm;
+  all[NN_TELEMETRY_FALLBACK_TIME] = fallback->coldTime + fallback->warmTime;
+  all[NN_TELEMETRY_EXTRAPOLATED] = telemetry->nOutcome[NN_EXTRAPOLATED];
+
+  memcpy(values, all, n * sizeof values[0]);
+  return n;
 }
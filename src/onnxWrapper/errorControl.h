@@ -28,9 +28,108 @@ struct OrtWrapperData;
 /* Residual function prototype */
 typedef void (*resFunction)(void*, const double*, double*, const int*);
 
+/* Prototype of function setting input variables of residual function */
+typedef void (*setInputsFunction)(void*, const double*);
+
+/* Policy when to check residuals of accepted ONNX predictions */
+struct ResidualCheckPolicy {
+  unsigned int interval;              /* Check every interval-th call, 0 or 1 to check every call */
+  unsigned int maxInterval;           /* Upper limit for interval after back-off */
+  unsigned int backoffAccepts;        /* Consecutive accepts before interval is doubled, 0 to disable back-off */
+  double eventWindow;                 /* Check every call within eventWindow after an event */
+  double scalingTolerance;            /* Relative state change before residual scaling is updated, 0 to update every check */
+};
+
+/* State and statistics of residual check scheduling */
+struct ResidualCheckState {
+  struct ResidualCheckPolicy policy;
+  unsigned int interval;              /* Current check interval */
+  unsigned int callsSinceCheck;       /* Calls since last check */
+  unsigned int consecutiveAccepts;    /* Accepted checks since last reject or interval change */
+  double lastEventTime;               /* Time of last event */
+  unsigned long nCalls;               /* Number of scheduled calls */
+  unsigned long nChecks;              /* Number of performed checks */
+  unsigned long nSkipped;             /* Number of skipped checks */
+  unsigned long nForced;              /* Number of checks forced by events */
+  unsigned long nRejects;             /* Number of rejected predictions */
+};
+
+/* Cached residual scaling with maximum norm of Jacobian rows */
+struct ResidualScaling {
+  double* scale;                      /* Maximum norm of each Jacobian row, size nRes */
+  double* state;                      /* Inputs and outputs at last update, size nInputs+nRes */
+  double* work;                       /* Work array of Jacobian evaluation, size 2*nRes */
+  int valid;                          /* 1 after first update */
+  unsigned long nUpdates;             /* Number of Jacobian evaluations */
+  unsigned long nReuses;              /* Number of checks using cached scaling */
+};
+
+/* Non-linear solver statistics of fallback steps */
+struct FallbackStats {
+  unsigned long nCold;                /* Solves starting from extrapolated values */
+  unsigned long coldIterations;       /* Solver iterations of cold solves */
+  unsigned long coldFEvals;           /* Residual evaluations of cold solves */
+  unsigned long nWarm;                /* Solves starting from rejected NN prediction */
+  unsigned long warmIterations;       /* Solver iterations of warm solves */
+  unsigned long warmFEvals;           /* Residual evaluations of warm solves */
+  double coldTime;                    /* Time of cold solves in seconds */
+  double warmTime;                    /* Time of warm solves in seconds */
+};
+
+/* Outcome of one call of a replaced equation */
+enum nnOutcome {
+  NN_ACCEPTED,                        /* Residual checked and accepted */
+  NN_UNCHECKED,                       /* Used without residual check */
+  NN_REJECTED_RESIDUAL,               /* Residual norm above tolerance */
+  NN_REJECTED_SINGULAR,               /* Jacobian singular, residual can't be scaled */
+  NN_REJECTED_DOMAIN,                 /* Inputs rejected by domain gate, model not evaluated */
+  NN_EXTRAPOLATED                     /* Extrapolated solution checked and accepted, model not evaluated */
+};
+
+/* Order of telemetry values returned by nnTelemetryValues */
+enum nnTelemetryIndex {
+  NN_TELEMETRY_CALLS,
+  NN_TELEMETRY_ACCEPTED,
+  NN_TELEMETRY_UNCHECKED,
+  NN_TELEMETRY_REJECTED_RESIDUAL,
+  NN_TELEMETRY_REJECTED_SINGULAR,
+  NN_TELEMETRY_REJECTED_DOMAIN,
+  NN_TELEMETRY_OUT_OF_BOUNDS,
+  NN_TELEMETRY_FALLBACKS,
+  NN_TELEMETRY_FALLBACK_TIME,
+  NN_TELEMETRY_EXTRAPOLATED,
+  NN_TELEMETRY_N
+};
+
+/* Acceptance counters of a replaced equation */
+struct NNTelemetry {
+  unsigned long nCalls;               /* Calls of replaced equation */
+  unsigned long nOutcome[NN_EXTRAPOLATED+1]; /* Calls for each enum nnOutcome */
+  unsigned long nOutOfBounds;         /* Checked predictions with inputs outside training area */
+};
+
 /* Function prototypes */
 void evalResidual(resFunction f, void* userData, struct OrtWrapperData* ortData);
 void printResiduum(unsigned int id, double time, struct OrtWrapperData* ortData);
 double residualNorm(double time, struct OrtWrapperData* ortData);
+double scaledResidualNorm(double time, struct OrtWrapperData* ortData, int* isRegular);
+double checkScaledResidual(struct OrtWrapperData* ortData, int* isRegular, int* inBounds);
+void recordResidualCheck(double time, struct OrtWrapperData* ortData, double norm, int isRegular, int inBounds);
+double scaledResidualNormAt(struct OrtWrapperData* ortData, const double* input, const double* res, const double* scale, int* isRegular);
+int residualScalingDue(struct OrtWrapperData* ortData, int isEvent);
+void updateResidualScaling(struct OrtWrapperData* ortData, int success);
+void evalResidualBatch(resFunction f, setInputsFunction setInputs, void* userData, struct OrtWrapperData* ortData, size_t batchSize, double* res);
+void residualNormBatch(const double* scale, double* res, size_t nRes, size_t batchSize, double* norms, int* isRegular);
+int inTrainingDomain(struct OrtWrapperData* ortData, int mode);
+void printDomainGateStats(const char* equationName, const struct OrtWrapperData* ortData);
+void initResidualCheck(struct ResidualCheckState* state, const struct ResidualCheckPolicy* policy);
+int residualCheckDue(struct ResidualCheckState* state, double time, int isEvent);
+void residualCheckResult(struct ResidualCheckState* state, int accepted);
+void printResidualCheckStats(const char* equationName, const struct ResidualCheckState* state);
+void printResidualScalingStats(const char* equationName, const struct ResidualScaling* scaling);
+void recordFallback(struct FallbackStats* stats, int warmStart, unsigned long nIterations, unsigned long nFEvals, double time);
+void recordNNOutcome(struct NNTelemetry* telemetry, enum nnOutcome outcome);
+size_t nnTelemetryValues(const struct OrtWrapperData* ortData, double* values, size_t nValues);
+void printFallbackStats(const char* equationName, const struct FallbackStats* stats);
 
 #endif  // ERROR_CONTROL_H
@@ -0,0 +1,272 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Cache of checked ONNX predictions of a replaced equation.
+ *
+ * During event iteration, step rejections and repeated solver evaluations an
+ * equation is often called again with the same inputs. The cache maps the
+ * inputs, optionally rounded to multiples of a quantum, to the prediction and
+ * the result of its residual check. Bit-identical inputs skip inference and
+ * residual check. Inputs that only match after rounding skip inference, but
+ * their prediction has to pass the residual check again. Each key hashes to a
+ * set of EVAL_CACHE_WAYS entries, the least recently used entry of the set is
+ * replaced on insertion.
+ */
+
+#include "evalCache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Quantize inputs into key and hash it.
+ *
+ * Without quantum the key is the bit pattern of the inputs, with -0 mapped
+ * to 0. The hash is the 64 bit FNV-1a hash of the key words.
+ *
+ * @param cache   Pointer to evaluation cache.
+ * @param input   Inputs of length nInputs.
+ * @param key     Key of length nInputs on return.
+ * @param hash    Pointer to hash on return.
+ * @return int    Return 0 if inputs can't be cached, 1 otherwise.
+ */
+static int cacheKey(const struct EvalCache* cache, const double* input, int64_t* key, uint64_t* hash) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+
+  for (size_t i = 0; i < cache->nInputs; i++) {
+    double x = input[i];
+    if (!isfinite(x)) {
+      return 0;
+    }
+    if (cache->quantum > 0) {
+      double q = round(x / cache->quantum);
+      if (fabs(q) >= 9.2e18) {
+        return 0;
+      }
+      key[i] = (int64_t) q;
+    } else {
+      if (x == 0) {
+        x = 0;
+      }
+      memcpy(&key[i], &x, sizeof key[i]);
+    }
+    for (int byte = 0; byte < 8; byte++) {
+      h ^= ((uint64_t) key[i] >> (8*byte)) & 0xff;
+      h *= 0x100000001b3ULL;
+    }
+  }
+  *hash = h;
+  return 1;
+}
+
+/**
+ * @brief Find entry with key in its set.
+ *
+ * @return long   Index of entry or -1 if key isn't cached.
+ */
+static long findEntry(const struct EvalCache* cache, const int64_t* key, uint64_t hash) {
+  size_t first = (hash % cache->nSets) * EVAL_CACHE_WAYS;
+
+  for (size_t e = first; e < first + EVAL_CACHE_WAYS; e++) {
+    if (cache->lastUse[e] != 0 && cache->hash[e] == hash
+        && memcmp(&cache->key[e*cache->nInputs], key, cache->nInputs * sizeof key[0]) == 0) {
+      return (long) e;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Allocate empty evaluation cache.
+ *
+ * @param capacity      Number of entries, rounded up to a multiple of EVAL_CACHE_WAYS.
+ * @param quantum       Round inputs to multiples of quantum. Use 0 to only
+ *                      match bit-identical inputs.
+ * @param nInputs       Number of inputs.
+ * @param nOutputs      Number of outputs.
+ * @return struct EvalCache*  Pointer to cache or NULL if capacity is 0.
+ */
+struct EvalCache* createEvalCache(size_t capacity, double quantum, size_t nInputs, size_t nOutputs) {
+  struct EvalCache* cache;
+  size_t nEntries;
+
+  if (capacity == 0) {
+    return NULL;
+  }
+  cache = calloc(1, sizeof *cache);
+  cache->nInputs = nInputs;
+  cache->nOutputs = nOutputs;
+  cache->nSets = (capacity + EVAL_CACHE_WAYS - 1) / EVAL_CACHE_WAYS;
+  cache->quantum = quantum > 0 ? quantum : 0;
+  nEntries = cache->nSets * EVAL_CACHE_WAYS;
+  cache->hash = calloc(nEntries, sizeof cache->hash[0]);
+  cache->key = calloc(nEntries * nInputs, sizeof cache->key[0]);
+  cache->input = cache->quantum > 0 ? calloc(nEntries * nInputs, sizeof cache->input[0]) : NULL;
+  cache->output = calloc(nEntries * nOutputs, sizeof cache->output[0]);
+  cache->verdict = calloc(nEntries, sizeof cache->verdict[0]);
+  cache->lastUse = calloc(nEntries, sizeof cache->lastUse[0]);
+  cache->scratchKey = calloc(nInputs > 0 ? nInputs : 1, sizeof cache->scratchKey[0]);
+  return cache;
+}
+
+/**
+ * @brief Free evaluation cache.
+ *
+ * @param cache   Pointer to evaluation cache, can be NULL.
+ */
+void freeEvalCache(struct EvalCache* cache) {
+  if (cache == NULL) {
+    return;
+  }
+  free(cache->hash);
+  free(cache->key);
+  free(cache->input);
+  free(cache->output);
+  free(cache->verdict);
+  free(cache->lastUse);
+  free(cache->scratchKey);
+  free(cache);
+}
+
+/**
+ * @brief Remove all entries and statistics, e.g. after reset of simulation.
+ *
+ * @param cache   Pointer to evaluation cache, can be NULL.
+ */
+void clearEvalCache(struct EvalCache* cache) {
+  if (cache == NULL) {
+    return;
+  }
+  memset(cache->lastUse, 0, cache->nSets * EVAL_CACHE_WAYS * sizeof cache->lastUse[0]);
+  cache->clock = 0;
+  cache->nHits = 0;
+  cache->nNearHits = 0;
+  cache->nMisses = 0;
+  cache->nEvictions = 0;
+}
+
+/* Inputs of entry e are identical to input, always true without quantum */
+static int sameInputs(const struct EvalCache* cache, long e, const double* input) {
+  if (cache->input == NULL) {
+    return 1;
+  }
+  for (size_t i = 0; i < cache->nInputs; i++) {
+    if (cache->input[e*cache->nInputs + i] != input[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Look up cached prediction for inputs.
+ *
+ * @param cache     Pointer to evaluation cache.
+ * @param input     Inputs of length nInputs.
+ * @param output    Cached prediction of length nOutputs on return, unchanged on miss.
+ * @param verdict   Pointer to cached residual check result on return, only
+ *                  valid for EVAL_CACHE_EXACT.
+ * @return enum evalCacheResult   EVAL_CACHE_EXACT if the prediction was
+ *                  checked for the same inputs, EVAL_CACHE_NEAR if the inputs
+ *                  only match after rounding to the quantum, EVAL_CACHE_MISS
+ *                  otherwise.
+ */
+enum evalCacheResult lookupEvalCache(struct EvalCache* cache, const double* input, double* output, int* verdict) {
+  int64_t* key = cache->scratchKey;
+  uint64_t hash;
+  long e;
+
+  if (!cacheKey(cache, input, key, &hash) || (e = findEntry(cache, key, hash)) < 0) {
+    cache->nMisses++;
+    return EVAL_CACHE_MISS;
+  }
+  cache->lastUse[e] = ++cache->clock;
+  memcpy(output, &cache->output[e*cache->nOutputs], cache->nOutputs * sizeof output[0]);
+  cache->nHits++;
+  if (!sameInputs(cache, e, input)) {
+    cache->nNearHits++;
+    return EVAL_CACHE_NEAR;
+  }
+  *verdict = cache->verdict[e];
+  return EVAL_CACHE_EXACT;
+}
+
+/**
+ * @brief Save checked prediction for inputs.
+ *
+ * Replaces an entry with the same key, otherwise an empty or the least
+ * recently used entry of the set. The verdict is reused for later calls
+ * with identical inputs.
+ *
+ * @param cache     Pointer to evaluation cache.
+ * @param input     Inputs of length nInputs.
+ * @param output    Prediction of length nOutputs.
+ * @param verdict   Residual check result of prediction, enum nnOutcome.
+ */
+void storeEvalCache(struct EvalCache* cache, const double* input, const double* output, int verdict) {
+  int64_t* key = cache->scratchKey;
+  uint64_t hash;
+  long e;
+
+  if (!cacheKey(cache, input, key, &hash)) {
+    return;
+  }
+  e = findEntry(cache, key, hash);
+  if (e < 0) {
+    size_t first = (hash % cache->nSets) * EVAL_CACHE_WAYS;
+    e = (long) first;
+    for (size_t i = first + 1; i < first + EVAL_CACHE_WAYS; i++) {
+      if (cache->lastUse[i] < cache->lastUse[e]) {
+        e = (long) i;
+      }
+    }
+    if (cache->lastUse[e] != 0) {
+      cache->nEvictions++;
+    }
+    cache->hash[e] = hash;
+    memcpy(&cache->key[e*cache->nInputs], key, cache->nInputs * sizeof key[0]);
+  }
+  if (cache->input != NULL) {
+    memcpy(&cache->input[e*cache->nInputs], input, cache->nInputs * sizeof input[0]);
+  }
+  memcpy(&cache->output[e*cache->nOutputs], output, cache->nOutputs * sizeof output[0]);
+  cache->verdict[e] = verdict;
+  cache->lastUse[e] = ++cache->clock;
+}
+
+/**
+ * @brief Print hits, misses and evictions of evaluation cache.
+ *
+ * @param equationName  Name of equation.
+ * @param cache         Pointer to evaluation cache, nothing is printed for NULL.
+ */
+void printEvalCacheStats(const char* equationName, const struct EvalCache* cache) {
+  unsigned long nLookups;
+
+  if (cache == NULL) {
+    return;
+  }
+  nLookups = cache->nHits + cache->nMisses;
+  printf("%s evaluation cache: lookups: %lu, hits: %lu (%.1f%%), checked again: %lu, evictions: %lu\n",
+         equationName, nLookups, cache->nHits,
+         nLookups > 0 ? 100.0 * cache->nHits / nLookups : 0.0, cache->nNearHits, cache->nEvictions);
+}
@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EVAL_CACHE_H
+#define EVAL_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVAL_CACHE_WAYS 4             /* Entries per set, evicted least recently used first */
+
+/* Result of cache lookup */
+enum evalCacheResult {
+  EVAL_CACHE_MISS,                    /* No entry with same key */
+  EVAL_CACHE_EXACT,                   /* Entry for bit-identical inputs, verdict can be reused */
+  EVAL_CACHE_NEAR                     /* Entry for inputs with same quantized key, verdict has to be checked again */
+};
+
+/* Set-associative cache of checked predictions, keyed on inputs */
+struct EvalCache {
+  size_t nInputs;                     /* Length of key */
+  size_t nOutputs;                    /* Length of cached prediction */
+  size_t nSets;                       /* Number of sets of EVAL_CACHE_WAYS entries */
+  double quantum;                     /* Inputs are rounded to multiples of quantum, 0 for bit-identical inputs */
+  uint64_t* hash;                     /* Hash of key of each entry */
+  int64_t* key;                       /* Quantized inputs of each entry, size nEntries*nInputs */
+  double* input;                      /* Inputs of each entry if quantum > 0, size nEntries*nInputs */
+  double* output;                     /* Prediction of each entry, size nEntries*nOutputs */
+  int* verdict;                       /* Residual check result of each entry, enum nnOutcome */
+  uint64_t* lastUse;                  /* Time stamp of last use of each entry, 0 if empty */
+  int64_t* scratchKey;                /* Key of current lookup, size nInputs */
+  uint64_t clock;                     /* Incremented on every lookup and store */
+  unsigned long nHits;                /* Lookups returning cached prediction */
+  unsigned long nNearHits;            /* Hits of inputs only matching after quantization */
+  unsigned long nMisses;              /* Lookups without matching entry */
+  unsigned long nEvictions;           /* Entries replaced by new predictions */
+};
+
+/* Function prototypes */
+struct EvalCache* createEvalCache(size_t capacity, double quantum, size_t nInputs, size_t nOutputs);
+void freeEvalCache(struct EvalCache* cache);
+void clearEvalCache(struct EvalCache* cache);
+enum evalCacheResult lookupEvalCache(struct EvalCache* cache, const double* input, double* output, int* verdict);
+void storeEvalCache(struct EvalCache* cache, const double* input, const double* output, int verdict);
+void printEvalCacheStats(const char* equationName, const struct EvalCache* cache);
+
+#endif // EVAL_CACHE_H
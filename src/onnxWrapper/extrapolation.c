@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Extrapolation of previous solutions of a replaced equation.
+ *
+ * On smooth trajectories the iteration variables can be predicted by a
+ * polynomial through the last solutions. The prediction is tried before the
+ * ONNX model and has to pass the same residual check.
+ */
+
+#include "extrapolation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Initialize empty solution history.
+ *
+ * @param history   Pointer to solution history.
+ * @param nX        Number of iteration variables.
+ */
+void initSolutionHistory(struct SolutionHistory* history, size_t nX) {
+  history->nX = nX;
+  history->count = 0;
+  history->head = 0;
+  history->x = calloc(SOLUTION_HISTORY_LENGTH*nX, sizeof history->x[0]);
+  history->nTries = 0;
+  history->nAccepted = 0;
+}
+
+/**
+ * @brief Free solution history.
+ *
+ * @param history   Pointer to solution history.
+ */
+void freeSolutionHistory(struct SolutionHistory* history) {
+  free(history->x);
+  history->x = NULL;
+  history->count = 0;
+}
+
+/**
+ * @brief Drop all solutions and statistics, e.g. after reset of simulation.
+ *
+ * @param history   Pointer to solution history.
+ */
+void clearSolutionHistory(struct SolutionHistory* history) {
+  history->count = 0;
+  history->head = 0;
+  history->nTries = 0;
+  history->nAccepted = 0;
+}
+
+/**
+ * @brief Get storage for solution at time.
+ *
+ * Solutions after time belong to rejected steps and are dropped.
+ * A solution at the time of the newest entry is overwritten, so times in the
+ * history are strictly increasing.
+ *
+ * @param history   Pointer to solution history.
+ * @param time      Simulation time of solution.
+ * @return double*  Array of length nX the caller has to fill.
+ */
+double* solutionHistorySlot(struct SolutionHistory* history, double time) {
+  while (history->count > 0 && time < history->time[history->head]) {
+    history->head = (history->head + SOLUTION_HISTORY_LENGTH - 1) % SOLUTION_HISTORY_LENGTH;
+    history->count--;
+  }
+  if (history->count == 0 || time > history->time[history->head]) {
+    history->head = (history->head + 1) % SOLUTION_HISTORY_LENGTH;
+    if (history->count < SOLUTION_HISTORY_LENGTH) {
+      history->count++;
+    }
+    history->time[history->head] = time;
+  }
+  return history->x + history->head*history->nX;
+}
+
+/**
+ * @brief Extrapolate solution to time.
+ *
+ * Evaluates the Lagrange polynomial through the last order+1 solutions.
+ * At the time of the newest solution that solution is returned.
+ *
+ * @param history   Pointer to solution history.
+ * @param order     Polynomial order, see enum extrapolationOrder.
+ * @param time      Simulation time to extrapolate to.
+ * @param x         Extrapolated solution of length nX on return.
+ * @return int      Return 1 on success, 0 if there are not enough solutions
+ *                  before time.
+ */
+int extrapolateSolution(const struct SolutionHistory* history, int order, double time, double* x) {
+  size_t nPoints = (size_t) order + 1;
+  size_t index[SOLUTION_HISTORY_LENGTH];
+  double weight[SOLUTION_HISTORY_LENGTH];
+
+  if (order <= EXTRAPOLATION_NONE || nPoints > SOLUTION_HISTORY_LENGTH || history->count < nPoints
+      || time < history->time[history->head]) {
+    return 0;
+  }
+
+  for (size_t k = 0; k < nPoints; k++) {
+    index[k] = (history->head + SOLUTION_HISTORY_LENGTH - k) % SOLUTION_HISTORY_LENGTH;
+  }
+  for (size_t k = 0; k < nPoints; k++) {
+    weight[k] = 1.0;
+    for (size_t j = 0; j < nPoints; j++) {
+      if (j != k) {
+        weight[k] *= (time - history->time[index[j]]) / (history->time[index[k]] - history->time[index[j]]);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < history->nX; i++) {
+    x[i] = 0;
+    for (size_t k = 0; k < nPoints; k++) {
+      x[i] += weight[k] * history->x[index[k]*history->nX + i];
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Count result of residual check of an extrapolated solution.
+ *
+ * @param history   Pointer to solution history.
+ * @param accepted  Non-zero if extrapolation passed the residual check.
+ */
+void recordExtrapolation(struct SolutionHistory* history, int accepted) {
+  history->nTries++;
+  if (accepted) {
+    history->nAccepted++;
+  }
+}
+
+/**
+ * @brief Print number of checked and accepted extrapolations.
+ *
+ * @param equationName  Name of equation.
+ * @param history       Pointer to solution history.
+ */
+void printExtrapolationStats(const char* equationName, const struct SolutionHistory* history) {
+  printf("%s extrapolation: tries: %lu, accepted: %lu (%.1f%%)\n",
+         equationName, history->nTries, history->nAccepted,
+         history->nTries > 0 ? 100.0 * history->nAccepted / history->nTries : 0.0);
+}
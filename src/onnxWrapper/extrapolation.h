@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EXTRAPOLATION_H
+#define EXTRAPOLATION_H
+
+#include <stddef.h>
+
+#define SOLUTION_HISTORY_LENGTH 3     /* Enough points for quadratic extrapolation */
+
+/* Order of extrapolation predictor tried before the ONNX model */
+enum extrapolationOrder {
+  EXTRAPOLATION_NONE,                 /* Always evaluate ONNX model */
+  EXTRAPOLATION_LINEAR,               /* Line through last two solutions */
+  EXTRAPOLATION_QUADRATIC             /* Parabola through last three solutions */
+};
+
+/* Ring buffer of recent solutions of a replaced equation */
+struct SolutionHistory {
+  size_t nX;                          /* Number of iteration variables */
+  size_t count;                       /* Number of stored solutions */
+  size_t head;                        /* Index of newest solution */
+  double time[SOLUTION_HISTORY_LENGTH];
+  double* x;                          /* Solutions, size SOLUTION_HISTORY_LENGTH*nX */
+  unsigned long nTries;               /* Number of extrapolations checked */
+  unsigned long nAccepted;            /* Number of extrapolations accepted */
+};
+
+/* Function prototypes */
+void initSolutionHistory(struct SolutionHistory* history, size_t nX);
+void freeSolutionHistory(struct SolutionHistory* history);
+void clearSolutionHistory(struct SolutionHistory* history);
+double* solutionHistorySlot(struct SolutionHistory* history, double time);
+int extrapolateSolution(const struct SolutionHistory* history, int order, double time, double* x);
+void recordExtrapolation(struct SolutionHistory* history, int accepted);
+void printExtrapolationStats(const char* equationName, const struct SolutionHistory* history);
+
+#endif // EXTRAPOLATION_H
@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Process-wide registry of the ORT state of FMU instances, keyed by the DATA
+ * pointer of the instance.
+ *
+ * Every call of a replaced equation looks up its instance, so lookups are
+ * lock-free and O(1): each thread remembers the instance it found last, and
+ * other keys are searched in one hash bucket only. Entries are reused but
+ * never freed. Unregistering an instance increments a generation counter,
+ * which invalidates the remembered instance of all threads.
+ */
+
+#include "instanceRegistry.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct instanceEntry {
+  int used;                           /* Claimed by an instance, accessed atomically */
+  const void* key;                    /* Owner of instance, NULL if entry is unused */
+  void* instance;
+  struct instanceEntry* next;         /* Next entry of same bucket */
+};
+
+static struct instanceEntry* buckets_global[INSTANCE_REGISTRY_BUCKETS];
+static unsigned long generation_global = 0;   /* Number of unregistered instances */
+
+/* Instance found last by this thread */
+static __thread const void* lastKey = NULL;
+static __thread void* lastInstance = NULL;
+static __thread unsigned long lastGeneration = 0;
+
+/**
+ * @brief Bucket of key, Fibonacci hashing of the pointer.
+ */
+static inline struct instanceEntry** bucket(const void* key) {
+  uint64_t h = (uint64_t)(uintptr_t) key * 0x9E3779B97F4A7C15ULL;
+  return &buckets_global[h >> (64 - INSTANCE_REGISTRY_BITS)];
+}
+
+/**
+ * @brief Register instance of key in an unused or new entry.
+ *
+ * @param key       Key of instance, e.g. DATA of FMU instance.
+ * @param instance  Pointer to instance state.
+ */
+void registerOrtInstance(const void* key, void* instance) {
+  struct instanceEntry** head = bucket(key);
+  struct instanceEntry* entry;
+
+  for (entry = __atomic_load_n(head, __ATOMIC_ACQUIRE); entry != NULL; entry = entry->next) {
+    int unused = 0;
+    if (__atomic_compare_exchange_n(&entry->used, &unused, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+  if (entry == NULL) {
+    entry = calloc(1, sizeof *entry);
+    entry->used = 1;
+    entry->next = __atomic_load_n(head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(head, &entry->next, entry, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+  entry->instance = instance;
+  __atomic_store_n(&entry->key, key, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Release entry of key for reuse.
+ *
+ * @param key       Key of instance.
+ */
+void unregisterOrtInstance(const void* key) {
+  struct instanceEntry* entry;
+
+  for (entry = __atomic_load_n(bucket(key), __ATOMIC_ACQUIRE); entry != NULL; entry = entry->next) {
+    if (__atomic_load_n(&entry->key, __ATOMIC_ACQUIRE) == key) {
+      __atomic_store_n(&entry->key, NULL, __ATOMIC_RELAXED);
+      __atomic_store_n(&entry->used, 0, __ATOMIC_RELEASE);
+      __atomic_fetch_add(&generation_global, 1, __ATOMIC_RELEASE);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Find instance of key.
+ *
+ * @param key       Key of instance.
+ * @return void*    Pointer to instance state, NULL if key isn't registered.
+ */
+void* findOrtInstance(const void* key) {
+  unsigned long generation = __atomic_load_n(&generation_global, __ATOMIC_ACQUIRE);
+  struct instanceEntry* entry;
+
+  if (key == NULL) {
+    return NULL;
+  }
+  if (key == lastKey && generation == lastGeneration) {
+    return lastInstance;
+  }
+  for (entry = __atomic_load_n(bucket(key), __ATOMIC_ACQUIRE); entry != NULL; entry = entry->next) {
+    if (__atomic_load_n(&entry->key, __ATOMIC_ACQUIRE) == key) {
+      lastKey = key;
+      lastInstance = entry->instance;
+      lastGeneration = generation;
+      return entry->instance;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,31 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INSTANCE_REGISTRY_H
+#define INSTANCE_REGISTRY_H
+
+#define INSTANCE_REGISTRY_BITS 12     /* 2^bits hash buckets, lookups stay O(1) up to about as many instances */
+#define INSTANCE_REGISTRY_BUCKETS (1 << INSTANCE_REGISTRY_BITS)
+
+/* Function prototypes */
+void registerOrtInstance(const void* key, void* instance);
+void unregisterOrtInstance(const void* key);
+void* findOrtInstance(const void* key);
+
+#endif // INSTANCE_REGISTRY_H
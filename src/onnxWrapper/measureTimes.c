@@ -25,15 +25,192 @@
 
 #include "measureTimes.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static const char* latencyPhaseNames[LATENCY_NPHASES] = {"total", "inference", "residual", "jacobian", "fallback"};
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ *
+ * Uses CLOCK_MONOTONIC or QueryPerformanceCounter on Windows.
+ *
+ * @return uint64_t   Time in ns since an unspecified starting point.
+ */
+uint64_t nowNs() {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency = {0};
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+  return (uint64_t) ((double) counter.QuadPart * 1e9 / (double) frequency.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
 void tic(struct timer* t) {
-  gettimeofday(&(t->start), NULL);
+  t->start = nowNs();
 }
 
 double toc(struct timer* t) {
-  double elapsedTime;
-  gettimeofday(&(t->stop), NULL);
-  elapsedTime = (t->stop.tv_sec - t->start.tv_sec) * 1000.0;      // sec to ms
-  elapsedTime += (t->stop.tv_usec - t->start.tv_usec) / 1000.0;   // us to ms
+  t->stop = nowNs();
+  return (t->stop - t->start) / 1e6;    // ns to ms
+}
+
+/**
+ * @brief Bucket of latency ns.
+ *
+ * Values below 4 ns have their own bucket. Above, each power of two is
+ * split into 4 buckets, so the relative bucket width is at most 25%.
+ */
+static unsigned int latencyBucket(uint64_t ns) {
+  unsigned int e = 0;
+  if (ns < 4) {
+    return (unsigned int) ns;
+  }
+#ifdef __GNUC__
+  e = 63 - __builtin_clzll(ns);
+#else
+  while (ns >> (e+1)) {
+    e++;
+  }
+#endif
+  return 4*(e-1) + ((ns >> (e-2)) & 3);
+}
+
+/**
+ * @brief Upper bound in ns of latency bucket.
+ */
+static uint64_t latencyBucketUpper(unsigned int bucket) {
+  unsigned int e, sub;
+  if (bucket < 4) {
+    return bucket + 1;
+  }
+  e = bucket/4 + 1;
+  sub = bucket % 4;
+  return (uint64_t) (5 + sub) << (e-2);
+}
+
+/**
+ * @brief Add measured latency to histogram of phase.
+ *
+ * @param latency   Pointer to latency histograms of equation.
+ * @param phase     Measured phase.
+ * @param ns        Latency in ns.
+ */
+void recordLatency(struct equationLatency* latency, enum latencyPhase phase, uint64_t ns) {
+  struct latencyHistogram* hist = &latency->phase[phase];
+  hist->count++;
+  hist->sum += ns;
+  if (ns > hist->max) {
+    hist->max = ns;
+  }
+  hist->buckets[latencyBucket(ns)]++;
+}
+
+/**
+ * @brief Percentile of latency histogram.
+ *
+ * @param hist        Pointer to latency histogram.
+ * @param p           Percentile in [0, 1].
+ * @return uint64_t   Upper bound of bucket containing percentile p in ns,
+ *                    at most maximum latency.
+ */
+uint64_t latencyPercentile(const struct latencyHistogram* hist, double p) {
+  uint64_t rank;
+  uint64_t cumulative = 0;
+
+  if (hist->count == 0) {
+    return 0;
+  }
+  rank = (uint64_t) (p * hist->count);
+  if (rank < 1) {
+    rank = 1;
+  }
+  for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+    cumulative += hist->buckets[i];
+    if (cumulative >= rank) {
+      uint64_t upper = latencyBucketUpper(i);
+      return upper < hist->max ? upper : hist->max;
+    }
+  }
+  return hist->max;
+}
+
+/**
+ * @brief Print p50, p99 and maximum latency of each measured phase to stdout.
+ *
+ * @param name      Name of equation.
+ * @param latency   Pointer to latency histograms of equation.
+ */
+void printLatency(const char* name, const struct equationLatency* latency) {
+  for (int phase = 0; phase < LATENCY_NPHASES; phase++) {
+    const struct latencyHistogram* hist = &latency->phase[phase];
+    if (hist->count == 0) {
+      continue;
+    }
+    printf("%s %s: calls: %llu, mean: %.3f us, p50: %.3f us, p99: %.3f us, max: %.3f us\n",
+           name, latencyPhaseNames[phase], (unsigned long long) hist->count,
+           hist->sum / 1e3 / hist->count,
+           latencyPercentile(hist, 0.5) / 1e3,
+           latencyPercentile(hist, 0.99) / 1e3,
+           hist->max / 1e3);
+  }
+}
+
+/**
+ * @brief Write latency histograms to CSV file.
+ *
+ * One row for each non-empty bucket of each equation and phase. The
+ * summary columns count, sum, max, p50 and p99 are repeated for all
+ * buckets of a phase.
+ *
+ * @param fileName  Name of CSV file.
+ * @param names     Names of equations.
+ * @param latency   Array of latency histograms of n equations.
+ * @param n         Number of equations.
+ * @return int      Return 0 on success, -1 if file can't be written.
+ */
+int writeLatencyFile(const char* fileName, const char* const* names, const struct equationLatency* latency, size_t n) {
+  FILE* file = fopen(fileName, "w");
+  if (file == NULL) {
+    fprintf(stderr, "writeLatencyFile: Could not open %s\n", fileName);
+    return -1;
+  }
+
+  fprintf(file, "equation,phase,count,sum_ns,max_ns,p50_ns,p99_ns,bucket_lower_ns,bucket_upper_ns,bucket_count\n");
+  for (size_t i = 0; i < n; i++) {
+    for (int phase = 0; phase < LATENCY_NPHASES; phase++) {
+      const struct latencyHistogram* hist = &latency[i].phase[phase];
+      uint64_t lower = 0;
+      if (hist->count == 0) {
+        continue;
+      }
+      for (unsigned int b = 0; b < LATENCY_BUCKETS; b++) {
+        uint64_t upper = latencyBucketUpper(b);
+        if (hist->buckets[b] > 0) {
+          fprintf(file, "%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+                  names[i], latencyPhaseNames[phase],
+                  (unsigned long long) hist->count, (unsigned long long) hist->sum,
+                  (unsigned long long) hist->max,
+                  (unsigned long long) latencyPercentile(hist, 0.5),
+                  (unsigned long long) latencyPercentile(hist, 0.99),
+                  (unsigned long long) lower, (unsigned long long) upper,
+                  (unsigned long long) hist->buckets[b]);
+        }
+        lower = upper;
+      }
+    }
+  }
 
-  return elapsedTime;
+  fclose(file);
+  return 0;
 }
@@ -26,15 +26,45 @@
 #ifndef MEASURE_TIMES_H
 #define MEASURE_TIMES_H
 
+#include <stdint.h>
 #include <stdio.h>
-#include <sys/time.h>
+
+#define LATENCY_BUCKETS 256           /* 4 log-spaced buckets per power of two nanoseconds */
 
 struct timer {
-  struct timeval start;
-  struct timeval stop;
+  uint64_t start;
+  uint64_t stop;
+};
+
+/* Measured phases of a replaced equation */
+enum latencyPhase {
+  LATENCY_TOTAL,                      /* Complete call of replaced equation */
+  LATENCY_INFERENCE,                  /* evalModel */
+  LATENCY_RESIDUAL,                   /* Residual evaluation, scaling and norm */
+  LATENCY_JACOBIAN,                   /* getResidualScaling */
+  LATENCY_FALLBACK,                   /* Non-linear solver after rejected or gated prediction */
+  LATENCY_NPHASES
+};
+
+/* Log-bucketed latency histogram in nanoseconds */
+struct latencyHistogram {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[LATENCY_BUCKETS];
+};
+
+/* Latency histograms of all phases of one equation */
+struct equationLatency {
+  struct latencyHistogram phase[LATENCY_NPHASES];
 };
 
 void tic(struct timer* t);
 double toc(struct timer* t);
+uint64_t nowNs();
+void recordLatency(struct equationLatency* latency, enum latencyPhase phase, uint64_t ns);
+uint64_t latencyPercentile(const struct latencyHistogram* hist, double p);
+void printLatency(const char* name, const struct equationLatency* latency);
+int writeLatencyFile(const char* fileName, const char* const* names, const struct equationLatency* latency, size_t n);
 
 #endif // MEASURE_TIMES_H
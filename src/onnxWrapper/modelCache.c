@@ -0,0 +1,245 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "onnxWrapper.h"
+#include "modelCache.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define makeDir(path) _mkdir(path)
+#define getProcessId() _getpid()
+#define PATH_SEPARATOR "\\"
+#else
+#include <unistd.h>
+#define makeDir(path) mkdir(path, 0755)
+#define getProcessId() getpid()
+#define PATH_SEPARATOR "/"
+#endif
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/**
+ * @brief Update 64 bit FNV-1a hash with bytes of buffer.
+ *
+ * @param hash        Hash value to update.
+ * @param buffer      Pointer to bytes.
+ * @param len         Number of bytes.
+ * @return uint64_t   Updated hash value.
+ */
+static uint64_t fnv1a(uint64_t hash, const void* buffer, size_t len) {
+  const unsigned char* bytes = buffer;
+  for(size_t i = 0; i < len; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * @brief Update hash with integer value.
+ */
+static uint64_t fnv1aInt(uint64_t hash, int value) {
+  return fnv1a(hash, &value, sizeof value);
+}
+
+/**
+ * @brief Get directory for optimized model cache.
+ *
+ * The user cache directory is `$XDG_CACHE_HOME/NonLinearSystemNeuralNetworkFMU`,
+ * `$HOME/.cache/NonLinearSystemNeuralNetworkFMU` or
+ * `%LOCALAPPDATA%\NonLinearSystemNeuralNetworkFMU` on Windows and is created
+ * if it doesn't exist.
+ *
+ * @param location        Cache location, see enum modelCacheLocation.
+ * @param resourcesDir    FMU resources directory.
+ * @param buffer          Buffer for directory path.
+ * @param len             Length of buffer.
+ * @return const char*    Cache directory or NULL if caching is disabled or
+ *                        no directory was found.
+ */
+const char* modelCacheDir(int location, const char* resourcesDir, char* buffer, size_t len) {
+  const char* baseDir;
+  const char* subDir = "";
+
+  switch (location) {
+  case MODEL_CACHE_RESOURCES:
+    snprintf(buffer, len, "%s", resourcesDir);
+    return buffer;
+  case MODEL_CACHE_USER:
+#ifdef _WIN32
+    baseDir = getenv("LOCALAPPDATA");
+#else
+    baseDir = getenv("XDG_CACHE_HOME");
+    if (baseDir == NULL || baseDir[0] == '\0') {
+      baseDir = getenv("HOME");
+      subDir = PATH_SEPARATOR ".cache";
+    }
+#endif
+    if (baseDir == NULL || baseDir[0] == '\0') {
+      return NULL;
+    }
+    snprintf(buffer, len, "%s%s", baseDir, subDir);
+    makeDir(buffer);
+    snprintf(buffer, len, "%s%s" PATH_SEPARATOR "NonLinearSystemNeuralNetworkFMU", baseDir, subDir);
+    if (makeDir(buffer) != 0 && errno != EEXIST) {
+      fprintf(stderr, "modelCacheDir: Could not create cache directory %s\n", buffer);
+      return NULL;
+    }
+    return buffer;
+  default:
+    return NULL;
+  }
+}
+
+/**
+ * @brief Get path of optimized model in cache.
+ *
+ * The cache key is a hash of the ONNX file content, the ORT version and all
+ * session settings.
+ *
+ * @param cacheDir      Cache directory.
+ * @param pathToONNX    Path to ONNX model.
+ * @param ortVersion    ONNX Runtime version string.
+ * @param options       Session settings.
+ * @param cachePath     Buffer for path of cached model.
+ * @param len           Length of buffer.
+ * @return int          Return 1 on success, 0 if ONNX file couldn't be read.
+ */
+int modelCachePath(const char* cacheDir, const char* pathToONNX, const char* ortVersion, const struct OrtWrapperOptions* options, char* cachePath, size_t len) {
+  uint64_t hash = FNV_OFFSET;
+  unsigned char buffer[4096];
+  size_t nRead;
+
+  FILE* file = fopen(pathToONNX, "rb");
+  if (file == NULL) {
+    return 0;
+  }
+  while ((nRead = fread(buffer, 1, sizeof buffer, file)) > 0) {
+    hash = fnv1a(hash, buffer, nRead);
+  }
+  fclose(file);
+
+  hash = fnv1a(hash, ortVersion, strlen(ortVersion));
+  hash = fnv1aInt(hash, options->intraOpNumThreads);
+  hash = fnv1aInt(hash, options->interOpNumThreads);
+  hash = fnv1aInt(hash, options->parallelExecution);
+  hash = fnv1aInt(hash, options->graphOptimizationLevel);
+  hash = fnv1aInt(hash, options->allowSpinning);
+  hash = fnv1aInt(hash, options->enableMemPattern);
+  hash = fnv1aInt(hash, options->enableCpuMemArena);
+
+  /* Strip directory and extension of ONNX file name */
+  const char* baseName = pathToONNX;
+  for (const char* c = pathToONNX; *c != '\0'; c++) {
+    if (*c == '/' || *c == '\\') {
+      baseName = c + 1;
+    }
+  }
+  const char* extension = strrchr(baseName, '.');
+  int baseNameLen = extension != NULL ? (int)(extension - baseName) : (int)strlen(baseName);
+
+  snprintf(cachePath, len, "%s" PATH_SEPARATOR "%.*s_%016" PRIx64 ".optimized.onnx", cacheDir, baseNameLen, baseName, hash);
+  return 1;
+}
+
+/**
+ * @brief Check if optimized model exists in cache.
+ *
+ * @param cachePath   Path of cached model.
+ * @return int        Return 1 if cached model exists, 0 otherwise.
+ */
+int modelCacheExists(const char* cachePath) {
+  struct stat buffer;
+  return stat(cachePath, &buffer) == 0;
+}
+
+/**
+ * @brief Get process specific temporary path for writing optimized model.
+ *
+ * ORT writes the optimized model while creating the session. Writing to a
+ * temporary file first prevents other processes from loading a partially
+ * written model.
+ *
+ * @param cachePath   Path of cached model.
+ * @param tmpPath     Buffer for temporary path.
+ * @param len         Length of buffer.
+ */
+void modelCacheTmpPath(const char* cachePath, char* tmpPath, size_t len) {
+  snprintf(tmpPath, len, "%s.%d.tmp", cachePath, (int) getProcessId());
+}
+
+/**
+ * @brief Move optimized model from temporary path into cache.
+ *
+ * If another process already added the model to the cache the temporary file
+ * is removed.
+ *
+ * @param tmpPath     Temporary path of optimized model.
+ * @param cachePath   Path of cached model.
+ */
+void commitModelCache(const char* tmpPath, const char* cachePath) {
+  if (rename(tmpPath, cachePath) != 0) {
+    remove(tmpPath);
+  }
+}
+
+/**
+ * @brief Read session creation time of uncached model.
+ *
+ * @param cachePath   Path of cached model.
+ * @return double     Session creation time in ms of uncached model, -1 if unknown.
+ */
+double readModelCacheTime(const char* cachePath) {
+  char timePath[2048];
+  double sessionTime = -1;
+  snprintf(timePath, sizeof timePath, "%s.time", cachePath);
+  FILE* file = fopen(timePath, "r");
+  if (file != NULL) {
+    if (fscanf(file, "%lf", &sessionTime) != 1) {
+      sessionTime = -1;
+    }
+    fclose(file);
+  }
+  return sessionTime;
+}
+
+/**
+ * @brief Save session creation time of uncached model next to cached model.
+ *
+ * @param cachePath     Path of cached model.
+ * @param sessionTime   Session creation time in ms.
+ */
+void writeModelCacheTime(const char* cachePath, double sessionTime) {
+  char timePath[2048];
+  snprintf(timePath, sizeof timePath, "%s.time", cachePath);
+  FILE* file = fopen(timePath, "w");
+  if (file != NULL) {
+    fprintf(file, "%f\n", sessionTime);
+    fclose(file);
+  }
+}
@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* forward types */
+struct OrtWrapperOptions;
+
+/* Location of optimized model cache */
+enum modelCacheLocation {
+  MODEL_CACHE_NONE = 0,               /* Don't cache optimized models */
+  MODEL_CACHE_RESOURCES = 1,          /* Cache in FMU resources directory */
+  MODEL_CACHE_USER = 2                /* Cache in user cache directory */
+};
+
+/* Function prototypes */
+const char* modelCacheDir(int location, const char* resourcesDir, char* buffer, size_t len);
+int modelCachePath(const char* cacheDir, const char* pathToONNX, const char* ortVersion, const struct OrtWrapperOptions* options, char* cachePath, size_t len);
+int modelCacheExists(const char* cachePath);
+void modelCacheTmpPath(const char* cachePath, char* tmpPath, size_t len);
+void commitModelCache(const char* tmpPath, const char* cachePath);
+double readModelCacheTime(const char* cachePath);
+void writeModelCacheTime(const char* cachePath, double sessionTime);
+
+#endif // MODEL_CACHE_H
@@ -26,10 +26,15 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "onnxWrapper.h"
+#include "denseMLP.h"
+#include "measureTimes.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -53,6 +58,77 @@ wchar_t* wideCharCopy(const char* str) {
     }                                                        \
   } while (0);
 
+/* Process-wide ORT environment shared by all equations */
+static OrtEnv* sharedEnv = NULL;
+static unsigned int sharedEnvRefCount = 0;
+static pthread_mutex_t sharedEnvMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Get reference to process-wide ORT environment.
+ *
+ * The first call creates the environment with global intra- and inter-op
+ * thread pools, all further calls only increase the reference counter.
+ * Sessions attached to this environment have to disable their per-session
+ * threads to use the global thread pools.
+ *
+ * @param g_ort           ONNX runtime API
+ * @param logId           Log identifier for the environment.
+ * @param numThreads      Number of threads of global intra-op thread pool. Use 0 for default number of threads.
+ * @param allowSpinning   Let idle threads of global thread pools spin-wait.
+ * @return OrtEnv*        Pointer to shared environment.
+ */
+static OrtEnv* acquireSharedEnv(const OrtApi* g_ort, const char* logId, int numThreads, int allowSpinning) {
+  pthread_mutex_lock(&sharedEnvMutex);
+  if (sharedEnvRefCount == 0) {
+    OrtThreadingOptions* threading_options;
+    ORT_ABORT_ON_ERROR(g_ort->CreateThreadingOptions(&threading_options));
+    ORT_ABORT_ON_ERROR(g_ort->SetGlobalIntraOpNumThreads(threading_options, numThreads));
+    ORT_ABORT_ON_ERROR(g_ort->SetGlobalInterOpNumThreads(threading_options, 1));
+    ORT_ABORT_ON_ERROR(g_ort->SetGlobalSpinControl(threading_options, allowSpinning));
+    ORT_ABORT_ON_ERROR(g_ort->CreateEnvWithGlobalThreadPools(ORT_LOGGING_LEVEL_WARNING, logId, threading_options, &sharedEnv));
+    g_ort->ReleaseThreadingOptions(threading_options);
+    assert(sharedEnv != NULL);
+  }
+  sharedEnvRefCount++;
+  pthread_mutex_unlock(&sharedEnvMutex);
+
+  return sharedEnv;
+}
+
+/**
+ * @brief Release reference to process-wide ORT environment.
+ *
+ * Environment and global thread pools are freed when the last reference is
+ * released.
+ *
+ * @param g_ort       ONNX runtime API
+ */
+static void releaseSharedEnv(const OrtApi* g_ort) {
+  pthread_mutex_lock(&sharedEnvMutex);
+  assert(sharedEnvRefCount > 0);
+  sharedEnvRefCount--;
+  if (sharedEnvRefCount == 0) {
+    g_ort->ReleaseEnv(sharedEnv);
+    sharedEnv = NULL;
+  }
+  pthread_mutex_unlock(&sharedEnvMutex);
+}
+
+/* Sessions shared by all instances with same model and settings, guarded by sharedEnvMutex */
+struct sharedSession {
+  char key[2560];                     /* Path to ONNX model and session settings */
+  OrtSessionOptions* session_options;
+  OrtSession* session;
+  unsigned int refCount;
+  int loading;                        /* 1 while the session is created outside of sharedEnvMutex */
+  pthread_cond_t loaded;              /* Signaled when loading is done */
+  int modelCacheHit;                  /* 1 if session was created from optimized model cache */
+  double sessionTime;                 /* Time to create session in ms */
+  double sessionTimeSaved;            /* Time saved by optimized model cache in ms */
+  struct sharedSession* next;
+};
+static struct sharedSession* sharedSessions = NULL;
+
 /**
  * @brief Verify that the ONNX model has one input and one output.
  *
@@ -68,45 +144,328 @@ void verify_input_output_count(const OrtApi* g_ort, OrtSession* session) {
 }
 
 /**
- * @brief Initialize ORT data for ONNX model.
+ * @brief Get element type of input or output tensor of ONNX model.
  *
- * @param equationName              Name of equation.
- * @param pathToONNX                Path to ONNX model.
- * @param modelName                 Name of ONNX model.
- * @param nInputs                   Number of inputs to ONNX model.
- * @param nOutputs                  Number of outputs of ONNX model.
- * @param logResiduum               Initialize CSV file for residuum errors.
- * @param numThreads                Number of threads for parallel node execution. Use 0 for default number of threads.
- * @return struct OrtWrapperData*   Pointer to ORT wrapper data.
+ * @param g_ort       ONNX runtime API
+ * @param session     ONNX session
+ * @param isInput     1 for input tensor, 0 for output tensor.
+ * @return ONNXTensorElementDataType  Element type of tensor.
  */
-struct OrtWrapperData* initOrtData(const char* equationName, const char* pathToONNX, const char* modelName, unsigned int nInputs, unsigned int nOutputs, int logResiduum, int numThreads) {
-  struct OrtWrapperData* ortData = calloc(1, sizeof (struct OrtWrapperData));
+static ONNXTensorElementDataType tensorElementType(const OrtApi* g_ort, OrtSession* session, int isInput) {
+  OrtTypeInfo* type_info;
+  const OrtTensorTypeAndShapeInfo* tensor_info;
+  ONNXTensorElementDataType type;
+
+  if (isInput) {
+    ORT_ABORT_ON_ERROR(g_ort->SessionGetInputTypeInfo(session, 0, &type_info));
+  } else {
+    ORT_ABORT_ON_ERROR(g_ort->SessionGetOutputTypeInfo(session, 0, &type_info));
+  }
+  ORT_ABORT_ON_ERROR(g_ort->CastTypeInfoToTensorInfo(type_info, &tensor_info));
+  ORT_ABORT_ON_ERROR(g_ort->GetTensorElementType(tensor_info, &type));
+  g_ort->ReleaseTypeInfo(type_info);
+
+  return type;
+}
+
+/**
+ * @brief Copy double array into float array.
+ *
+ * @param doubleArray     Pointer to double array.
+ * @param floatArray      Pointer to float array.
+ * @param len             Length of doubleArray and floatArray.
+ */
+static void double2FloatArray(const double* doubleArray, float* floatArray, const size_t len) {
+  for(size_t i = 0; i < len; i++) {
+    floatArray[i] = (float) doubleArray[i];
+  }
+}
+
+/**
+ * @brief Copy float array into double array.
+ *
+ * @param floatArray      Pointer to float array.
+ * @param doubleArray     Pointer to double array.
+ * @param len             Length of floatArray and doubleArray.
+ */
+static void float2DoubleArray(const float* floatArray, double* doubleArray, const size_t len) {
+  for(size_t i = 0; i < len; i++) {
+    doubleArray[i] = floatArray[i];
+  }
+}
+
+/**
+ * @brief Default session settings.
+ *
+ * Use global thread pools of shared environment, sequential execution, all
+ * graph optimizations, no spinning and ORT defaults for memory pattern and
+ * arena.
+ *
+ * @return struct OrtWrapperOptions  Default options.
+ */
+struct OrtWrapperOptions defaultOrtWrapperOptions() {
+  struct OrtWrapperOptions options = {
+    .intraOpNumThreads = 0,
+    .interOpNumThreads = 0,
+    .parallelExecution = 0,
+    .graphOptimizationLevel = ORT_ENABLE_ALL,
+    .allowSpinning = 0,
+    .enableMemPattern = 1,
+    .enableCpuMemArena = 1,
+    .fastPath = 0,
+    .backend = ONNX_BACKEND_ORT,
+    .aotModel = NULL,
+    .cacheDir = NULL,
+    .evalCacheSize = 0,
+    .evalCacheQuantum = 0,
+    .residualLogFormat = RES_LOG_CSV
+  };
+  return options;
+}
+
+/**
+ * @brief Create session options from wrapper options.
+ *
+ * If intraOpNumThreads and interOpNumThreads are both 0 the session uses the
+ * global thread pools of the shared environment. Otherwise the session gets
+ * its own thread pools.
+ *
+ * @param g_ort                 ONNX runtime API
+ * @param options               Session settings.
+ * @return OrtSessionOptions*   Pointer to session options.
+ */
+static OrtSessionOptions* createSessionOptions(const OrtApi* g_ort, const struct OrtWrapperOptions* options) {
+  OrtSessionOptions* session_options;
+  ORT_ABORT_ON_ERROR(g_ort->CreateSessionOptions(&session_options));
+
+  if (options->intraOpNumThreads <= 0 && options->interOpNumThreads <= 0) {
+    /* Use global thread pools of shared environment */
+    ORT_ABORT_ON_ERROR(g_ort->DisablePerSessionThreads(session_options));
+  } else {
+    ORT_ABORT_ON_ERROR(g_ort->SetIntraOpNumThreads(session_options, options->intraOpNumThreads > 0 ? options->intraOpNumThreads : 1));
+    ORT_ABORT_ON_ERROR(g_ort->SetInterOpNumThreads(session_options, options->interOpNumThreads > 0 ? options->interOpNumThreads : 1));
+    ORT_ABORT_ON_ERROR(g_ort->AddSessionConfigEntry(session_options, "session.intra_op.allow_spinning", options->allowSpinning ? "1" : "0"));
+    ORT_ABORT_ON_ERROR(g_ort->AddSessionConfigEntry(session_options, "session.inter_op.allow_spinning", options->allowSpinning ? "1" : "0"));
+  }
+
+  ORT_ABORT_ON_ERROR(g_ort->SetSessionExecutionMode(session_options, options->parallelExecution ? ORT_PARALLEL : ORT_SEQUENTIAL));
+  ORT_ABORT_ON_ERROR(g_ort->SetSessionGraphOptimizationLevel(session_options, (GraphOptimizationLevel) options->graphOptimizationLevel));
+
+  /* Memory pattern and arena only pay off for larger, varying tensors */
+  if (options->enableMemPattern && !options->fastPath) {
+    ORT_ABORT_ON_ERROR(g_ort->EnableMemPattern(session_options));
+  } else {
+    ORT_ABORT_ON_ERROR(g_ort->DisableMemPattern(session_options));
+  }
+  if (options->enableCpuMemArena && !options->fastPath) {
+    ORT_ABORT_ON_ERROR(g_ort->EnableCpuMemArena(session_options));
+  } else {
+    ORT_ABORT_ON_ERROR(g_ort->DisableCpuMemArena(session_options));
+  }
+
+  return session_options;
+}
+
+/**
+ * @brief Create ORT session from ONNX file.
+ *
+ * @param g_ort             ONNX runtime API
+ * @param env               ORT environment.
+ * @param path              Path to ONNX model.
+ * @param session_options   Session options.
+ * @return OrtSession*      Pointer to session.
+ */
+static OrtSession* createSessionFromFile(const OrtApi* g_ort, OrtEnv* env, const char* path, OrtSessionOptions* session_options) {
+  OrtSession* session;
+#ifdef _WIN32
+  wchar_t* path_utf = wideCharCopy(path);
+  ORT_ABORT_ON_ERROR(g_ort->CreateSession(env, path_utf, session_options, &session));
+  free(path_utf);
+#else
+  ORT_ABORT_ON_ERROR(g_ort->CreateSession(env, path, session_options, &session));
+#endif
+  return session;
+}
+
+/**
+ * @brief Set path where ORT saves the optimized model on session creation.
+ *
+ * @param g_ort             ONNX runtime API
+ * @param session_options   Session options.
+ * @param path              Path of optimized model.
+ */
+static void setOptimizedModelPath(const OrtApi* g_ort, OrtSessionOptions* session_options, const char* path) {
+#ifdef _WIN32
+  wchar_t* path_utf = wideCharCopy(path);
+  ORT_ABORT_ON_ERROR(g_ort->SetOptimizedModelFilePath(session_options, path_utf));
+  free(path_utf);
+#else
+  ORT_ABORT_ON_ERROR(g_ort->SetOptimizedModelFilePath(session_options, path));
+#endif
+}
+
+/**
+ * @brief Get reference to session shared by all instances.
+ *
+ * Sessions are shared between all ORT wrapper data with the same ONNX model
+ * and session settings, e.g. the same equation of several FMU instances.
+ * ORT sessions are thread-safe for concurrent Run calls, every instance
+ * binds its own input and output tensors.
+ * The first call creates the session and uses the optimized model cache if
+ * options->cacheDir is set. The session is created without holding
+ * sharedEnvMutex, so sessions of different models are created in parallel.
+ * Further calls with the same model and settings wait until it is loaded.
+ *
+ * @param g_ort                   ONNX runtime API
+ * @param env                     Shared ORT environment.
+ * @param pathToONNX              Path to ONNX model.
+ * @param options                 Session settings.
+ * @param created                 Set to 1 if this call created the session, 0 if it was shared.
+ * @return struct sharedSession*  Pointer to shared session.
+ */
+static struct sharedSession* acquireSharedSession(const OrtApi* g_ort, OrtEnv* env, const char* pathToONNX, const struct OrtWrapperOptions* options, int* created) {
+  char key[2560];
+  struct sharedSession* shared;
+
+  int keyLen = snprintf(key, sizeof key, "%s|%d|%d|%d|%d|%d|%d|%d|%d|%s", pathToONNX,
+           options->intraOpNumThreads, options->interOpNumThreads, options->parallelExecution,
+           options->graphOptimizationLevel, options->allowSpinning, options->enableMemPattern,
+           options->enableCpuMemArena, options->fastPath, options->cacheDir != NULL ? options->cacheDir : "");
+  if (keyLen < 0 || (size_t) keyLen >= sizeof key) {
+    fprintf(stderr, "acquireSharedSession: Path to ONNX model %s too long.\n", pathToONNX);
+    abort();
+  }
+
+  pthread_mutex_lock(&sharedEnvMutex);
+  for (shared = sharedSessions; shared != NULL; shared = shared->next) {
+    if (strcmp(shared->key, key) == 0) {
+      shared->refCount++;
+      while (shared->loading) {
+        pthread_cond_wait(&shared->loaded, &sharedEnvMutex);
+      }
+      *created = 0;
+      pthread_mutex_unlock(&sharedEnvMutex);
+      return shared;
+    }
+  }
+
+  /* Insert placeholder and create session without holding the lock */
+  shared = calloc(1, sizeof *shared);
+  memcpy(shared->key, key, (size_t) keyLen + 1);
+  pthread_cond_init(&shared->loaded, NULL);
+  shared->loading = 1;
+  shared->refCount = 1;
+  shared->next = sharedSessions;
+  sharedSessions = shared;
+  pthread_mutex_unlock(&sharedEnvMutex);
+
+  shared->session_options = createSessionOptions(g_ort, options);
+
+  /* Create session, use optimized model cache if available */
+  char cachePath[2048];
+  char tmpCachePath[2048];
+  struct timer t;
+  int useCache = options->cacheDir != NULL &&
+                 modelCachePath(options->cacheDir, pathToONNX, OrtGetApiBase()->GetVersionString(), options, cachePath, sizeof cachePath);
+  tic(&t);
+  if (useCache && modelCacheExists(cachePath)) {
+    /* Cached model is already optimized */
+    ORT_ABORT_ON_ERROR(g_ort->SetSessionGraphOptimizationLevel(shared->session_options, ORT_DISABLE_ALL));
+    shared->session = createSessionFromFile(g_ort, env, cachePath, shared->session_options);
+    shared->modelCacheHit = 1;
+  } else if (useCache) {
+    modelCacheTmpPath(cachePath, tmpCachePath, sizeof tmpCachePath);
+    setOptimizedModelPath(g_ort, shared->session_options, tmpCachePath);
+    shared->session = createSessionFromFile(g_ort, env, pathToONNX, shared->session_options);
+    commitModelCache(tmpCachePath, cachePath);
+  } else {
+    shared->session = createSessionFromFile(g_ort, env, pathToONNX, shared->session_options);
+  }
+  shared->sessionTime = toc(&t);
+  if (shared->modelCacheHit) {
+    double uncachedTime = readModelCacheTime(cachePath);
+    shared->sessionTimeSaved = uncachedTime > 0 ? uncachedTime - shared->sessionTime : 0;
+  } else if (useCache) {
+    writeModelCacheTime(cachePath, shared->sessionTime);
+  }
+
+  pthread_mutex_lock(&sharedEnvMutex);
+  shared->loading = 0;
+  pthread_cond_broadcast(&shared->loaded);
+  *created = 1;
+  pthread_mutex_unlock(&sharedEnvMutex);
+
+  return shared;
+}
+
+/**
+ * @brief Release reference to shared session.
+ *
+ * Session and session options are freed when the last reference is released.
+ *
+ * @param g_ort       ONNX runtime API
+ * @param shared      Pointer to shared session.
+ */
+static void releaseSharedSession(const OrtApi* g_ort, struct sharedSession* shared) {
+  pthread_mutex_lock(&sharedEnvMutex);
+  assert(shared->refCount > 0);
+  shared->refCount--;
+  if (shared->refCount == 0) {
+    struct sharedSession** it = &sharedSessions;
+    while (*it != shared) {
+      it = &(*it)->next;
+    }
+    *it = shared->next;
+    g_ort->ReleaseSessionOptions(shared->session_options);
+    g_ort->ReleaseSession(shared->session);
+    pthread_cond_destroy(&shared->loaded);
+    free(shared);
+  }
+  pthread_mutex_unlock(&sharedEnvMutex);
+}
+
+/* Model runs in an ORT session, not in the dense MLP engine or a compiled network */
+static int usesOrtSession(const struct OrtWrapperData* ortData) {
+  return ortData->mlp == NULL && ortData->aotModel == NULL;
+}
 
+/**
+ * @brief Create or share ORT session and bind input and output tensors.
+ *
+ * @param ortData         Pointer to ORT wrapper data.
+ * @param pathToONNX      Path to ONNX model.
+ * @param modelName       Name of ONNX model.
+ * @param nInputs         Number of inputs to ONNX model.
+ * @param nOutputs        Number of outputs of ONNX model.
+ * @param numThreads      Number of threads of global intra-op thread pool.
+ * @param options         Session settings.
+ * @return int            Return 1 on success, 0 if ORT can't be initialized.
+ */
+static int initOrtSession(struct OrtWrapperData* ortData, const char* pathToONNX, const char* modelName, unsigned int nInputs, unsigned int nOutputs, int numThreads, const struct OrtWrapperOptions* options) {
   /* Initialize ORT */
   const OrtApi* g_ort;
   OrtEnv* env;
   OrtSessionOptions* session_options;
   OrtSession* session;
+  struct sharedSession* shared;
+  int created;
 
   g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
   if (!g_ort) {
     fprintf(stderr, "Failed to init ONNX Runtime engine.\n");
-    return NULL;
+    return 0;
+  }
+  env = acquireSharedEnv(g_ort, modelName, numThreads, options->allowSpinning);
+  shared = acquireSharedSession(g_ort, env, pathToONNX, options, &created);
+  session_options = shared->session_options;
+  session = shared->session;
+  ortData->shared = shared;
+  ortData->modelCacheHit = shared->modelCacheHit;
+  if (created) {
+    /* Only creator of session reports its creation time */
+    ortData->sessionTime = shared->sessionTime;
+    ortData->sessionTimeSaved = shared->sessionTimeSaved;
   }
-  ORT_ABORT_ON_ERROR(g_ort->CreateEnv(ORT_LOGGING_LEVEL_WARNING, modelName, &env));
-  assert(env != NULL);
-  ORT_ABORT_ON_ERROR(g_ort->CreateSessionOptions(&session_options));
-  /* Use only 1 additional thread */
-  ORT_ABORT_ON_ERROR(g_ort->SetIntraOpNumThreads(session_options, 1));
-  ORT_ABORT_ON_ERROR(g_ort->SetInterOpNumThreads(session_options, 1));
-
-#ifdef _WIN32
-  wchar_t* pathToONNX_utf = wideCharCopy(pathToONNX);
-  ORT_ABORT_ON_ERROR(g_ort->CreateSession(env, pathToONNX_utf, session_options, &session));
-  free(pathToONNX_utf);
-#else
-  ORT_ABORT_ON_ERROR(g_ort->CreateSession(env, pathToONNX, session_options, &session));
-#endif
   verify_input_output_count(g_ort, session);
 
   ortData->g_ort = g_ort;
@@ -117,66 +476,145 @@ struct OrtWrapperData* initOrtData(const char* equationName, const char* pathToO
   OrtAllocator* allocator;
   ORT_ABORT_ON_ERROR(g_ort->GetAllocatorWithDefaultOptions(&allocator));
 
-  /* Initialize model_input and model_output */
+  /* Element type of model, double tensors are bound directly to input and x */
+  ONNXTensorElementDataType elementType = tensorElementType(g_ort, session, 1);
+  if (elementType != tensorElementType(g_ort, session, 0)) {
+    fprintf(stderr, "initOrtData: Input and output of ONNX model %s need the same element type.\n", pathToONNX);
+    abort();
+  }
+  if (elementType != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && elementType != ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE) {
+    fprintf(stderr, "initOrtData: Element type %d of ONNX model %s not supported. Use float or double.\n", (int) elementType, pathToONNX);
+    abort();
+  }
+  ortData->elementType = elementType;
+  const int isDouble = elementType == ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE;
+
+  /* Initialize input and output arrays */
   ortData->nInputs = nInputs;
-  ortData->model_input = calloc(nInputs, sizeof ortData->model_input[0]);
-  ortData->model_output = calloc(nOutputs, sizeof ortData->model_output[0]);
+  ortData->nOutputs = nOutputs;
+  ortData->input = calloc(nInputs, sizeof ortData->input[0]);
+  ortData->x = calloc(nOutputs, sizeof ortData->x[0]);
+  if (!isDouble) {
+    ortData->model_input = calloc(nInputs, sizeof ortData->model_input[0]);
+    ortData->model_output = calloc(nOutputs, sizeof ortData->model_output[0]);
+  }
 
   /* Initialize input and output tensors */
   unsigned int model_input_ele_count = nInputs;
   unsigned int model_output_ele_count = nOutputs;
+  const size_t element_size = isDouble ? sizeof(double) : sizeof(float);
+  void* input_data = isDouble ? (void*) ortData->input : (void*) ortData->model_input;
+  void* output_data = isDouble ? (void*) ortData->x : (void*) ortData->model_output;
 
-  OrtMemoryInfo* memory_info = ortData->memory_info;
+  OrtMemoryInfo* memory_info;
   ORT_ABORT_ON_ERROR(g_ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
+  ortData->memory_info = memory_info;
   const int64_t input_shape[] = {1, model_input_ele_count};
   const size_t input_shape_len = sizeof(input_shape) / sizeof(input_shape[0]);
-  const size_t model_input_len = model_input_ele_count * sizeof(float);
+  const size_t model_input_len = model_input_ele_count * element_size;
   ortData->input_names = calloc(1, sizeof ortData->input_names[0]);
   ORT_ABORT_ON_ERROR(g_ort->SessionGetInputName(session, 0, allocator, (char**) ortData->input_names));
 
   const int64_t output_shape[] = {1, model_output_ele_count};
   const size_t output_shape_len = sizeof(output_shape) / sizeof(output_shape[0]);
-  const size_t model_output_len = model_output_ele_count * sizeof(float);
+  const size_t model_output_len = model_output_ele_count * element_size;
   ortData->output_names = calloc(1, sizeof ortData->output_names[0]);
   ORT_ABORT_ON_ERROR(g_ort->SessionGetOutputName(session, 0, allocator, (char**) ortData->output_names));
 
-  ORT_ABORT_ON_ERROR(g_ort->CreateTensorWithDataAsOrtValue(memory_info, ortData->model_input, model_input_len, input_shape,
-                                                           input_shape_len, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,
+  ORT_ABORT_ON_ERROR(g_ort->CreateTensorWithDataAsOrtValue(memory_info, input_data, model_input_len, input_shape,
+                                                           input_shape_len, elementType,
                                                            &ortData->input_tensor));
 
-  ORT_ABORT_ON_ERROR(g_ort->CreateTensorWithDataAsOrtValue(memory_info, ortData->model_output, model_output_len, output_shape,
-                                                           output_shape_len, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,
+  ORT_ABORT_ON_ERROR(g_ort->CreateTensorWithDataAsOrtValue(memory_info, output_data, model_output_len, output_shape,
+                                                           output_shape_len, elementType,
                                                            &ortData->output_tensor));
 
+  /* Reuse run options, bind tensors once for fast path */
+  ORT_ABORT_ON_ERROR(g_ort->CreateRunOptions(&ortData->run_options));
+  if (options->fastPath) {
+    ORT_ABORT_ON_ERROR(g_ort->CreateIoBinding(session, &ortData->io_binding));
+    ORT_ABORT_ON_ERROR(g_ort->BindInput(ortData->io_binding, ortData->input_names[0], ortData->input_tensor));
+    ORT_ABORT_ON_ERROR(g_ort->BindOutput(ortData->io_binding, ortData->output_names[0], ortData->output_tensor));
+  } else {
+    ortData->io_binding = NULL;
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Initialize ORT data for ONNX model.
+ *
+ * @param equationName              Name of equation.
+ * @param pathToONNX                Path to ONNX model.
+ * @param modelName                 Name of ONNX model.
+ * @param nInputs                   Number of inputs to ONNX model.
+ * @param nOutputs                  Number of outputs of ONNX model.
+ * @param logResiduum               Initialize log file for residuum errors.
+ * @param numThreads                Number of threads of global intra-op thread pool shared by all equations.
+ *                                  Only used by the first call. Use 0 for default number of threads.
+ * @param options                   Session settings for this equation. Use NULL for default settings.
+ *                                  If options->cacheDir is set the optimized model is loaded from
+ *                                  the cache or saved to it on first use.
+ * @return struct OrtWrapperData*   Pointer to ORT wrapper data.
+ */
+struct OrtWrapperData* initOrtData(const char* equationName, const char* pathToONNX, const char* modelName, unsigned int nInputs, unsigned int nOutputs, int logResiduum, int numThreads, const struct OrtWrapperOptions* options) {
+  struct OrtWrapperData* ortData = calloc(1, sizeof (struct OrtWrapperData));
+  struct OrtWrapperOptions default_options = defaultOrtWrapperOptions();
+  if (options == NULL) {
+    options = &default_options;
+  }
+
+  /* Use compiled network or built-in dense MLP engine if requested and supported, ORT otherwise */
+  if (options->backend == ONNX_BACKEND_AOT) {
+    ortData->aotModel = options->aotModel;
+    if (ortData->aotModel == NULL) {
+      printf("initOrtData: Falling back to ONNX Runtime for %s: no compiled model\n", pathToONNX);
+    }
+  } else if (options->backend == ONNX_BACKEND_DENSE_MLP) {
+    char reason[256];
+    ortData->mlp = loadDenseMLP(pathToONNX, nInputs, nOutputs, reason, sizeof reason);
+    if (ortData->mlp == NULL) {
+      printf("initOrtData: Falling back to ONNX Runtime for %s: %s\n", pathToONNX, reason);
+    }
+  }
+  if (!usesOrtSession(ortData)) {
+    ortData->nInputs = nInputs;
+    ortData->nOutputs = nOutputs;
+    /* Compiled networks convert to their element type internally */
+    ortData->elementType = ortData->mlp != NULL && !denseMLPIsDouble(ortData->mlp) ? ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT : ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE;
+    ortData->input = calloc(nInputs, sizeof ortData->input[0]);
+    ortData->x = calloc(nOutputs, sizeof ortData->x[0]);
+  } else if (!initOrtSession(ortData, pathToONNX, modelName, nInputs, nOutputs, numThreads, options)) {
+    free(ortData);
+    return NULL;
+  }
+
   if (logResiduum) {
     /* Initialize residuum arrays */
     ortData->nRes = (size_t) nOutputs;
-    ortData->x = calloc(ortData->nRes, sizeof ortData->x[0]);
     ortData->res = calloc(ortData->nRes, sizeof ortData->res[0]);
-    char csvFilePath[2048];
-    snprintf(csvFilePath, 2048, "%s_residuum.csv", equationName);
-    ortData->csvFile = fopen(csvFilePath, "w");
-    fprintf(ortData->csvFile, "time,");
-    fprintf(ortData->csvFile, "inBounds,");
-    fprintf(ortData->csvFile, "scaled_res_norm,");
-    for(int i=0; i<ortData->nRes-1; i++) {
-      fprintf(ortData->csvFile, "res[%i],", i);
-    }
-    fprintf(ortData->csvFile, "res[%li]\n", ortData->nRes-1);
-
-    /* Initialize training area boundaries */
-    ortData->min = calloc(nInputs, sizeof ortData->min[0]);
-    ortData->max = calloc(nInputs, sizeof ortData->max[0]);
+    ortData->resLog = openResidualLog(equationName, ortData->nRes, options->residualLogFormat);
+    initResidualCheck(&ortData->check, NULL);
+    memset(&ortData->scaling, 0, sizeof ortData->scaling);
+    ortData->scaling.scale = calloc(ortData->nRes, sizeof ortData->scaling.scale[0]);
+    ortData->scaling.state = calloc(nInputs + ortData->nRes, sizeof ortData->scaling.state[0]);
+    ortData->scaling.work = calloc(2*ortData->nRes, sizeof ortData->scaling.work[0]);
   } else {
     ortData->nRes = 0;
-    ortData->x = NULL;
     ortData->res = NULL;
-    ortData->csvFile = NULL;
-
-    ortData->min = NULL;
-    ortData->max = NULL;
+    memset(&ortData->scaling, 0, sizeof ortData->scaling);
+    ortData->resLog = NULL;
   }
 
+  initSolutionHistory(&ortData->history, nOutputs);
+  ortData->evalCache = createEvalCache(options->evalCacheSize, options->evalCacheQuantum, nInputs, nOutputs);
+
+  /* Initialize training area boundaries, used by residual log and domain gate */
+  ortData->min = calloc(nInputs, sizeof ortData->min[0]);
+  ortData->max = calloc(nInputs, sizeof ortData->max[0]);
+  ortData->domain = NULL;
+
   return ortData;
 }
 
@@ -187,71 +625,291 @@ struct OrtWrapperData* initOrtData(const char* equationName, const char* pathToO
  */
 void deinitOrtData(struct OrtWrapperData* ortData) {
   /* Free memory */
-  ortData->g_ort->ReleaseMemoryInfo(ortData->memory_info);
-  ortData->g_ort->ReleaseValue(ortData->output_tensor);
-  ortData->g_ort->ReleaseValue(ortData->input_tensor);
+  if (!usesOrtSession(ortData)) {
+    freeDenseMLP(ortData->mlp);
+  } else {
+    if (ortData->io_binding != NULL) {
+      ortData->g_ort->ReleaseIoBinding(ortData->io_binding);
+    }
+    ortData->g_ort->ReleaseRunOptions(ortData->run_options);
+    ortData->g_ort->ReleaseMemoryInfo(ortData->memory_info);
+    ortData->g_ort->ReleaseValue(ortData->output_tensor);
+    ortData->g_ort->ReleaseValue(ortData->input_tensor);
+    if (ortData->batch_input_tensor != NULL) {
+      ortData->g_ort->ReleaseValue(ortData->batch_input_tensor);
+      ortData->g_ort->ReleaseValue(ortData->batch_output_tensor);
+    }
+    free((char*)ortData->input_names[0]);
+    free(ortData->input_names);
+    free((char*)ortData->output_names[0]);
+    free(ortData->output_names);
 
+    /* Free ORT */
+    releaseSharedSession(ortData->g_ort, ortData->shared);
+    releaseSharedEnv(ortData->g_ort);
+  }
+  free(ortData->batch_input);
+  free(ortData->batch_output);
+  free(ortData->batch_model_input);
+  free(ortData->batch_model_output);
+
+  free(ortData->input);
   free(ortData->model_input);
-  free((char*)ortData->input_names[0]);
-  free(ortData->input_names);
   free(ortData->model_output);
-  free((char*)ortData->output_names[0]);
-  free(ortData->output_names);
-
-  /* Free ORT */
-  ortData->g_ort->ReleaseSessionOptions(ortData->session_options);
-  ortData->g_ort->ReleaseSession(ortData->session);
-  ortData->g_ort->ReleaseEnv(ortData->env);
 
   /* Free residuum data */
   free(ortData->x);
   free(ortData->res);
-  if (ortData->csvFile != NULL) {
-    fclose(ortData->csvFile);
-  }
+  free(ortData->scaling.scale);
+  free(ortData->scaling.state);
+  free(ortData->scaling.work);
+  closeResidualLog(ortData->resLog);
+  freeSolutionHistory(&ortData->history);
+  freeEvalCache(ortData->evalCache);
 
-  /* Free training are boundaries */
+  /* Free training area boundaries */
   free(ortData->min);
   free(ortData->max);
+  freeDomainIndex(ortData->domain);
 
   free(ortData);
 }
 
+/**
+ * @brief Reset ORT data for a new simulation run of the same instance.
+ *
+ * Session, tensors, residual log and domain index are kept. Solution
+ * history, cached predictions, residual scaling, check schedule and all
+ * statistics are cleared.
+ *
+ * @param ortData   Pointer to ORT data.
+ */
+void resetOrtData(struct OrtWrapperData* ortData) {
+  struct ResidualCheckPolicy policy = ortData->check.policy;
+
+  initResidualCheck(&ortData->check, &policy);
+  ortData->scaling.valid = 0;
+  ortData->scaling.nUpdates = 0;
+  ortData->scaling.nReuses = 0;
+  memset(&ortData->fallback, 0, sizeof ortData->fallback);
+  memset(&ortData->telemetry, 0, sizeof ortData->telemetry);
+  clearSolutionHistory(&ortData->history);
+  clearEvalCache(ortData->evalCache);
+  ortData->nDomainCalls = 0;
+  ortData->nDomainRejects = 0;
+}
+
 /**
  * @brief Return pointer to input array of ONNX model.
  *
  * @param ortData   Pointer to ORT wrapper data.
- * @return float*   Pointer to input array.
+ * @return double*  Pointer to input array.
  */
-float* inputDataPtr(struct OrtWrapperData* ortData) {
-  return ortData->model_input;
+double* inputDataPtr(struct OrtWrapperData* ortData) {
+  return ortData->input;
 }
 
 /**
  * @brief Return pointer to output array of ONNX model.
  *
  * @param ortData   Pointer to ORT wrapper data.
- * @return float*   Pointer to output array.
+ * @return double*  Pointer to output array.
  */
-float* outputDataPtr(struct OrtWrapperData* ortData) {
-  return ortData->model_output;
+double* outputDataPtr(struct OrtWrapperData* ortData) {
+  return ortData->x;
 }
 
 /**
  * @brief Evaluate ONNX model.
  *
- * @param ortData 
+ * Reads inputs from ortData->input and writes outputs to ortData->x.
+ * Float models convert inputs and outputs, double models run directly on
+ * these arrays.
+ * With fast path the tensors are already bound to the session and no names
+ * are looked up. Compiled networks and models loaded by the dense MLP backend
+ * don't use ORT.
+ *
+ * @param ortData   Pointer to ORT wrapper data.
  */
 void evalModel(struct OrtWrapperData* ortData) {
   const OrtApi* g_ort = ortData->g_ort;
+  const int isDouble = ortData->elementType == ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE;
+  if (ortData->aotModel != NULL) {
+    ortData->aotModel(ortData->input, ortData->x);
+    return;
+  }
+  if (ortData->mlp != NULL) {
+    evalDenseMLP(ortData->mlp, ortData->input, ortData->x);
+    return;
+  }
+  if (!isDouble) {
+    double2FloatArray(ortData->input, ortData->model_input, ortData->nInputs);
+  }
+  if (ortData->io_binding != NULL) {
+    ORT_ABORT_ON_ERROR(g_ort->RunWithBinding(ortData->session, ortData->run_options, ortData->io_binding));
+  } else {
+    ORT_ABORT_ON_ERROR(
+      g_ort->Run(
+        ortData->session,
+        ortData->run_options,
+        ortData->input_names,
+        (const OrtValue* const*)&ortData->input_tensor,
+        1,
+        ortData->output_names,
+        1,
+        &ortData->output_tensor));
+  }
+  if (!isDouble) {
+    float2DoubleArray(ortData->model_output, ortData->x, ortData->nOutputs);
+  }
+}
+
+/**
+ * @brief Return pointer to input rows for batched evaluation.
+ *
+ * Makes sure batch arrays can hold `batchSize` rows and binds the batch
+ * tensors to shape {batchSize, nInputs} and {batchSize, nOutputs}.
+ * Arrays grow when needed and are reused across calls, tensors are only
+ * re-created when the batch size changes.
+ * Previous content of the input rows is lost when the arrays grow.
+ *
+ * @param ortData     Pointer to ORT wrapper data.
+ * @param batchSize   Number of rows to evaluate.
+ * @return double*    Pointer to row-major input array of size batchSize*nInputs.
+ */
+double* batchInputDataPtr(struct OrtWrapperData* ortData, size_t batchSize) {
+  const OrtApi* g_ort = ortData->g_ort;
+  const int isDouble = ortData->elementType == ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE;
+  assert(batchSize > 0);
+
+  if (batchSize > ortData->batchCapacity) {
+    size_t capacity = ortData->batchCapacity > 0 ? ortData->batchCapacity : 1;
+    while (capacity < batchSize) {
+      capacity *= 2;
+    }
+    free(ortData->batch_input);
+    free(ortData->batch_output);
+    ortData->batch_input = calloc(capacity*ortData->nInputs, sizeof ortData->batch_input[0]);
+    ortData->batch_output = calloc(capacity*ortData->nOutputs, sizeof ortData->batch_output[0]);
+    if (!isDouble && usesOrtSession(ortData)) {
+      free(ortData->batch_model_input);
+      free(ortData->batch_model_output);
+      ortData->batch_model_input = calloc(capacity*ortData->nInputs, sizeof ortData->batch_model_input[0]);
+      ortData->batch_model_output = calloc(capacity*ortData->nOutputs, sizeof ortData->batch_model_output[0]);
+    }
+    ortData->batchCapacity = capacity;
+    ortData->batchSize = 0;   /* Tensors point to freed memory */
+  }
+
+  if (!usesOrtSession(ortData)) {
+    ortData->batchSize = batchSize;
+  } else if (batchSize != ortData->batchSize) {
+    if (ortData->batch_input_tensor != NULL) {
+      g_ort->ReleaseValue(ortData->batch_input_tensor);
+      g_ort->ReleaseValue(ortData->batch_output_tensor);
+    }
+    const size_t element_size = isDouble ? sizeof(double) : sizeof(float);
+    void* input_data = isDouble ? (void*) ortData->batch_input : (void*) ortData->batch_model_input;
+    void* output_data = isDouble ? (void*) ortData->batch_output : (void*) ortData->batch_model_output;
+    const int64_t input_shape[] = {batchSize, ortData->nInputs};
+    const int64_t output_shape[] = {batchSize, ortData->nOutputs};
+    ORT_ABORT_ON_ERROR(g_ort->CreateTensorWithDataAsOrtValue(ortData->memory_info, input_data,
+                                                             batchSize*ortData->nInputs*element_size, input_shape, 2,
+                                                             ortData->elementType, &ortData->batch_input_tensor));
+    ORT_ABORT_ON_ERROR(g_ort->CreateTensorWithDataAsOrtValue(ortData->memory_info, output_data,
+                                                             batchSize*ortData->nOutputs*element_size, output_shape, 2,
+                                                             ortData->elementType, &ortData->batch_output_tensor));
+    ortData->batchSize = batchSize;
+  }
+
+  return ortData->batch_input;
+}
+
+/**
+ * @brief Return pointer to output rows of batched evaluation.
+ *
+ * @param ortData   Pointer to ORT wrapper data.
+ * @return double*  Pointer to row-major output array of size batchSize*nOutputs.
+ */
+double* batchOutputDataPtr(struct OrtWrapperData* ortData) {
+  return ortData->batch_output;
+}
+
+/**
+ * @brief Evaluate ONNX model for batchSize input rows in a single run.
+ *
+ * Input rows have to be written to batchInputDataPtr(ortData, batchSize)
+ * before. The ONNX model needs a dynamic first (batch) dimension.
+ *
+ * @param ortData     Pointer to ORT wrapper data.
+ * @param batchSize   Number of rows to evaluate.
+ */
+void evalModelBatch(struct OrtWrapperData* ortData, size_t batchSize) {
+  const OrtApi* g_ort = ortData->g_ort;
+  const int isDouble = ortData->elementType == ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE;
+  batchInputDataPtr(ortData, batchSize);
+  if (ortData->aotModel != NULL) {
+    for (size_t row = 0; row < batchSize; row++) {
+      ortData->aotModel(&ortData->batch_input[row*ortData->nInputs], &ortData->batch_output[row*ortData->nOutputs]);
+    }
+    return;
+  }
+  if (ortData->mlp != NULL) {
+    for (size_t row = 0; row < batchSize; row++) {
+      evalDenseMLP(ortData->mlp, &ortData->batch_input[row*ortData->nInputs], &ortData->batch_output[row*ortData->nOutputs]);
+    }
+    return;
+  }
+  if (!isDouble) {
+    double2FloatArray(ortData->batch_input, ortData->batch_model_input, batchSize*ortData->nInputs);
+  }
   ORT_ABORT_ON_ERROR(
     g_ort->Run(
       ortData->session,
-      NULL,
+      ortData->run_options,
       ortData->input_names,
-      (const OrtValue* const*)&ortData->input_tensor,
+      (const OrtValue* const*)&ortData->batch_input_tensor,
       1,
       ortData->output_names,
       1,
-      &ortData->output_tensor));
+      &ortData->batch_output_tensor));
+  if (!isDouble) {
+    float2DoubleArray(ortData->batch_model_output, ortData->batch_output, batchSize*ortData->nOutputs);
+  }
+}
+
+/**
+ * @brief Compare outputs of ortData with an ONNX Runtime session of the same model.
+ *
+ * Evaluates the compiled network or dense MLP of ortData and a temporary ORT
+ * session with default settings for every input row. The error of each
+ * output is relative to the ORT value, absolute for values smaller than 1.
+ *
+ * @param ortData     Pointer to ORT wrapper data to check.
+ * @param pathToONNX  Path to ONNX model of ortData.
+ * @param inputs      Row-major input samples, size nSamples*nInputs.
+ * @param nSamples    Number of input samples.
+ * @param maxError    Maximum error over all samples and outputs on return.
+ * @return int        Return 1 on success, 0 if ORT session can't be created.
+ */
+int checkModelParity(struct OrtWrapperData* ortData, const char* pathToONNX, const double* inputs, size_t nSamples, double* maxError) {
+  struct OrtWrapperData* reference = initOrtData("parity", pathToONNX, "parity", ortData->nInputs, ortData->nOutputs, 0, 0, NULL);
+  if (reference == NULL) {
+    return 0;
+  }
+
+  *maxError = 0;
+  for (size_t sample = 0; sample < nSamples; sample++) {
+    memcpy(ortData->input, &inputs[sample*ortData->nInputs], ortData->nInputs * sizeof(double));
+    memcpy(reference->input, &inputs[sample*ortData->nInputs], ortData->nInputs * sizeof(double));
+    evalModel(ortData);
+    evalModel(reference);
+    for (size_t i = 0; i < ortData->nOutputs; i++) {
+      double error = fabs(ortData->x[i] - reference->x[i]) / fmax(fabs(reference->x[i]), 1.0);
+      *maxError = fmax(*maxError, isnan(error) ? INFINITY : error);
+    }
+  }
+
+  deinitOrtData(reference);
+  return 1;
 }
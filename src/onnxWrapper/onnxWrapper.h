@@ -21,35 +21,106 @@
 #define ONNX_WWRAPPER_H
 
 #include "onnxruntime_c_api.h"
+#include "domainGate.h"
 #include "errorControl.h"
+#include "evalCache.h"
+#include "extrapolation.h"
+#include "instanceRegistry.h"
+#include "modelCache.h"
+#include "residualLog.h"
+#include "sessionLoader.h"
+
+/* Inference engine of ONNX model */
+enum onnxBackend {
+  ONNX_BACKEND_ORT,                   /* ONNX Runtime session */
+  ONNX_BACKEND_DENSE_MLP,             /* Built-in dense MLP engine, falls back to ORT for unsupported models */
+  ONNX_BACKEND_AOT                    /* Network compiled into the FMU sources, see OrtWrapperOptions.aotModel */
+};
+
+/* Network compiled ahead-of-time, reads nInputs and writes nOutputs values */
+typedef void (*aotModelFunction)(const double* input, double* output);
+
+/* Session settings for a single equation */
+struct OrtWrapperOptions {
+  int intraOpNumThreads;              /* Intra-op threads of own thread pool, 0 to use global thread pool */
+  int interOpNumThreads;              /* Inter-op threads of own thread pool, 0 to use global thread pool */
+  int parallelExecution;              /* Execute graph nodes in parallel (ORT_PARALLEL) instead of sequential */
+  int graphOptimizationLevel;         /* GraphOptimizationLevel: 0, 1, 2 or 99 */
+  int allowSpinning;                  /* Let idle threads spin-wait for new work */
+  int enableMemPattern;               /* Enable memory pattern optimization */
+  int enableCpuMemArena;              /* Enable CPU memory arena */
+  int fastPath;                       /* Bind tensors once with IoBinding, disables memory pattern and CPU memory arena */
+  int backend;                        /* Inference engine, see enum onnxBackend */
+  aotModelFunction aotModel;          /* Compiled network of ONNX_BACKEND_AOT, falls back to ORT if NULL */
+  const char* cacheDir;               /* Directory for optimized model cache, NULL to disable cache */
+  size_t evalCacheSize;               /* Number of cached checked predictions, 0 to disable evaluation cache */
+  double evalCacheQuantum;            /* Round inputs of evaluation cache keys to multiples of quantum, 0 for exact inputs */
+  int residualLogFormat;              /* Format of residual log, see enum residualLogFormat */
+};
 
 struct OrtWrapperData {
   const OrtApi* g_ort;
-  OrtEnv* env;
-  OrtSessionOptions* session_options;
-  OrtSession* session;
+  OrtEnv* env;                        /* Shared process-wide environment */
+  struct sharedSession* shared;       /* Session shared by all instances of the same model */
+  OrtSessionOptions* session_options; /* Options of shared session, read-only */
+  OrtSession* session;                /* Shared session, read-only */
+  int modelCacheHit;                  /* 1 if session was created from optimized model cache */
+  double sessionTime;                 /* Time in ms to create session */
+  double sessionTimeSaved;            /* Time in ms saved by loading from optimized model cache */
+  struct denseMLP* mlp;               /* Built-in dense MLP engine, NULL if model runs in ORT session */
+  aotModelFunction aotModel;          /* Compiled network, NULL if model runs in ORT session or dense MLP */
   size_t nInputs;                     /* Number of inputs */
-  float* model_input;                 /* Input variables (used variables) */
+  size_t nOutputs;                    /* Number of outputs */
+  ONNXTensorElementDataType elementType;  /* Element type of input and output tensors, float or double */
+  double* input;                      /* Input variables (used variables), tensor data for double models */
+  float* model_input;                 /* Float tensor data of input, NULL for double models */
   const char** input_names;           /* Names of input variables */
-  float* model_output;                /* Output variables (iteration variables x) */
+  float* model_output;                /* Float tensor data of output, NULL for double models */
   const char** output_names;          /* Names of output variables */
   OrtMemoryInfo* memory_info;
   OrtValue* input_tensor;
   OrtValue* output_tensor;
+  OrtRunOptions* run_options;         /* Run options reused by every call */
+  OrtIoBinding* io_binding;           /* Input and output tensors bound to session, NULL without fast path */
+
+  /* Batched inference */
+  size_t batchSize;                   /* Number of rows of batch tensors */
+  size_t batchCapacity;               /* Number of allocated rows of batch_input and batch_output */
+  double* batch_input;                /* Input rows, size batchCapacity*nInputs */
+  double* batch_output;               /* Output rows, size batchCapacity*nOutputs */
+  float* batch_model_input;           /* Float tensor data of batch_input, NULL for double models */
+  float* batch_model_output;          /* Float tensor data of batch_output, NULL for double models */
+  OrtValue* batch_input_tensor;
+  OrtValue* batch_output_tensor;
 
   /* Residuum */
-  double* x;                          /* Double version of model_output */
-  double* res;                        /* Residuum f(x), x is model_output */
-  size_t nRes;                        /* Length of arrays x and res */
-  FILE * csvFile;                     /* Log file for residuum values */
+  double* x;                          /* Output variables (iteration variables x), tensor data for double models */
+  double* res;                        /* Residuum f(x) */
+  size_t nRes;                        /* Length of array res */
+  struct residualLog* resLog;         /* Asynchronous log for residuum values */
+  struct ResidualCheckState check;    /* Scheduling of residual checks */
+  struct ResidualScaling scaling;     /* Cached scaling of residuum */
+  struct FallbackStats fallback;      /* Solver statistics of fallback to non-linear solver */
+  struct NNTelemetry telemetry;       /* Acceptance counters */
+  struct SolutionHistory history;     /* Recent solutions for extrapolation predictor */
+  struct EvalCache* evalCache;        /* Checked predictions of recent inputs, NULL if disabled */
 
   /* Training area */
-  double* min;                        /* Minimum allowed values for model_input, size nInputs */
-  double* max;                        /* Maximum allowed values for model_input, size nInputs */
+  double* min;                        /* Minimum allowed values for input, size nInputs */
+  double* max;                        /* Maximum allowed values for input, size nInputs */
+  struct domainIndex* domain;         /* Grid occupancy index of training data or NULL */
+  unsigned long nDomainCalls;         /* Number of calls of domain gate */
+  unsigned long nDomainRejects;       /* Number of inputs rejected by domain gate */
 };
 
-struct OrtWrapperData* initOrtData(const char* equationName, const char* pathToONNX, const char* modelName, unsigned int nInputs, unsigned int nOutputs, int logResiduum, int numThreads);
+struct OrtWrapperOptions defaultOrtWrapperOptions();
+struct OrtWrapperData* initOrtData(const char* equationName, const char* pathToONNX, const char* modelName, unsigned int nInputs, unsigned int nOutputs, int logResiduum, int numThreads, const struct OrtWrapperOptions* options);
 void deinitOrtData(struct OrtWrapperData* ortData);
+void resetOrtData(struct OrtWrapperData* ortData);
 void evalModel(struct OrtWrapperData* ortData);
+double* batchInputDataPtr(struct OrtWrapperData* ortData, size_t batchSize);
+double* batchOutputDataPtr(struct OrtWrapperData* ortData);
+void evalModelBatch(struct OrtWrapperData* ortData, size_t batchSize);
+int checkModelParity(struct OrtWrapperData* ortData, const char* pathToONNX, const double* inputs, size_t nSamples, double* maxError);
 
 #endif // ONNX_WWRAPPER_H
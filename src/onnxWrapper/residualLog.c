@@ -0,0 +1,204 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "residualLog.h"
+
+#define RES_LOG_CAPACITY 4096         /* Number of records in ring buffer */
+#define RES_LOG_NAME_LEN 16           /* Length of column names in binary header */
+
+/**
+ * @brief Write header of residual log.
+ *
+ * @param log   Pointer to residual log.
+ */
+static void writeHeader(struct residualLog* log) {
+  if (log->format == RES_LOG_BINARY) {
+    const uint32_t version = 1;
+    const uint32_t nCols = (uint32_t) log->recordSize;
+    const char* fixedNames[] = {"time", "inBounds", "scaled_res_norm"};
+    char name[RES_LOG_NAME_LEN];
+    int len;
+    fwrite(RES_LOG_MAGIC, 1, 8, log->file);
+    fwrite(&version, sizeof version, 1, log->file);
+    fwrite(&nCols, sizeof nCols, 1, log->file);
+    for(size_t i = 0; i < log->recordSize; i++) {
+      memset(name, 0, sizeof name);
+      if (i < 3) {
+        len = snprintf(name, sizeof name, "%s", fixedNames[i]);
+      } else {
+        len = snprintf(name, sizeof name, "res[%zu]", i-3);
+      }
+      if (len < 0 || (size_t) len >= sizeof name) {
+        fprintf(stderr, "writeHeader: Column name %zu truncated to \"%s\"\n", i, name);
+      }
+      fwrite(name, 1, sizeof name, log->file);
+    }
+  } else {
+    fprintf(log->file, "time,");
+    fprintf(log->file, "inBounds,");
+    fprintf(log->file, "scaled_res_norm,");
+    for(size_t i = 0; i < log->nRes-1; i++) {
+      fprintf(log->file, "res[%zu],", i);
+    }
+    fprintf(log->file, "res[%zu]\n", log->nRes-1);
+  }
+}
+
+/**
+ * @brief Write single record to log file.
+ *
+ * @param log       Pointer to residual log.
+ * @param record    Record with recordSize doubles.
+ */
+static void writeRecord(struct residualLog* log, const double* record) {
+  if (log->format == RES_LOG_BINARY) {
+    fwrite(record, sizeof(double), log->recordSize, log->file);
+  } else {
+    fprintf(log->file, "%f,", record[0]);
+    fprintf(log->file, "%i,", (int) record[1]);
+    fprintf(log->file, "%f,", record[2]);
+    for(size_t i = 0; i < log->nRes-1; i++) {
+      fprintf(log->file, "%e,", record[3+i]);
+    }
+    fprintf(log->file, "%e\n", record[3+log->nRes-1]);
+  }
+}
+
+/**
+ * @brief Background writer draining the ring buffer into the log file.
+ *
+ * Sleeps shortly when the ring buffer is empty. Drains all remaining records
+ * after stop is set.
+ *
+ * @param arg       Pointer to residual log.
+ * @return void*    NULL
+ */
+static void* residualLogWriter(void* arg) {
+  struct residualLog* log = arg;
+  const struct timespec idle = {0, 1000000};   /* 1 ms */
+
+  while (1) {
+    size_t tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&log->head, memory_order_acquire);
+    if (tail == head) {
+      if (atomic_load_explicit(&log->stop, memory_order_acquire)) {
+        break;
+      }
+      nanosleep(&idle, NULL);
+      continue;
+    }
+    for(; tail != head; tail++) {
+      writeRecord(log, &log->ring[(tail & (log->capacity-1))*log->recordSize]);
+    }
+    atomic_store_explicit(&log->tail, tail, memory_order_release);
+  }
+  fflush(log->file);
+
+  return NULL;
+}
+
+/**
+ * @brief Open residual log and start background writer thread.
+ *
+ * @param equationName          Name of equation, used for file name.
+ * @param nRes                  Length of residual vector.
+ * @param format                Output format, see enum residualLogFormat.
+ * @return struct residualLog*  Pointer to residual log or NULL if file couldn't be opened.
+ */
+struct residualLog* openResidualLog(const char* equationName, size_t nRes, int format) {
+  char filePath[2048];
+  struct residualLog* log = calloc(1, sizeof (struct residualLog));
+
+  log->format = format;
+  if (format == RES_LOG_BINARY) {
+    snprintf(filePath, sizeof filePath, "%s_residuum.bin", equationName);
+    log->file = fopen(filePath, "wb");
+  } else {
+    snprintf(filePath, sizeof filePath, "%s_residuum.csv", equationName);
+    log->file = fopen(filePath, "w");
+  }
+  if (log->file == NULL) {
+    fprintf(stderr, "openResidualLog: Could not open %s\n", filePath);
+    free(log);
+    return NULL;
+  }
+
+  log->nRes = nRes;
+  log->recordSize = 3 + nRes;
+  log->capacity = RES_LOG_CAPACITY;
+  log->ring = malloc(log->capacity * log->recordSize * sizeof(double));
+  atomic_init(&log->head, 0);
+  atomic_init(&log->tail, 0);
+  atomic_init(&log->stop, 0);
+
+  writeHeader(log);
+  pthread_create(&log->writer, NULL, residualLogWriter, log);
+
+  return log;
+}
+
+/**
+ * @brief Add record to residual log.
+ *
+ * Copies the record into the ring buffer, formatting and I/O happen on the
+ * writer thread. Only waits if the ring buffer is full.
+ * Must only be called from one thread.
+ *
+ * @param log       Pointer to residual log.
+ * @param time      Simulation time.
+ * @param inBounds  1 if inputs are inside training area, 0 otherwise.
+ * @param norm      Scaled residual norm.
+ * @param res       Residual vector of length nRes.
+ */
+void writeResidualLog(struct residualLog* log, double time, int inBounds, double norm, const double* res) {
+  size_t head = atomic_load_explicit(&log->head, memory_order_relaxed);
+  while (head - atomic_load_explicit(&log->tail, memory_order_acquire) >= log->capacity) {
+    sched_yield();
+  }
+
+  double* record = &log->ring[(head & (log->capacity-1))*log->recordSize];
+  record[0] = time;
+  record[1] = inBounds;
+  record[2] = norm;
+  memcpy(&record[3], res, log->nRes*sizeof(double));
+
+  atomic_store_explicit(&log->head, head+1, memory_order_release);
+}
+
+/**
+ * @brief Write remaining records, stop writer thread and close log.
+ *
+ * @param log   Pointer to residual log.
+ */
+void closeResidualLog(struct residualLog* log) {
+  if (log == NULL) {
+    return;
+  }
+  atomic_store_explicit(&log->stop, 1, memory_order_release);
+  pthread_join(log->writer, NULL);
+  fclose(log->file);
+  free(log->ring);
+  free(log);
+}
@@ -0,0 +1,64 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef RESIDUAL_LOG_H
+#define RESIDUAL_LOG_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/* Output format of residual log */
+enum residualLogFormat {
+  RES_LOG_CSV = 0,                    /* Text file <equationName>_residuum.csv */
+  RES_LOG_BINARY = 1                  /* Binary file <equationName>_residuum.bin */
+};
+
+/* Magic bytes at start of binary residual log */
+#define RES_LOG_MAGIC "NLSNNRES"
+
+/*
+ * Binary residual log layout (native byte order):
+ *   char[8]   magic "NLSNNRES"
+ *   uint32    version, currently 1
+ *   uint32    number of columns nCols = 3 + nRes
+ *   nCols x char[16]  zero padded column names "time", "inBounds", "scaled_res_norm", "res[i]"
+ *   records of nCols doubles until end of file
+ */
+
+/* Asynchronous residual log */
+struct residualLog {
+  FILE* file;                         /* Output file */
+  int format;                         /* Output format, see enum residualLogFormat */
+  size_t nRes;                        /* Length of residual vector */
+  size_t recordSize;                  /* Number of doubles per record: time, inBounds, norm, res[0..nRes-1] */
+  size_t capacity;                    /* Number of records in ring buffer, power of two */
+  double* ring;                       /* Ring buffer with capacity*recordSize doubles */
+  atomic_size_t head;                 /* Next record to write, only changed by simulation thread */
+  atomic_size_t tail;                 /* Next record to read, only changed by writer thread */
+  atomic_int stop;                    /* Signal writer thread to drain buffer and exit */
+  pthread_t writer;                   /* Background writer thread */
+};
+
+/* Function prototypes */
+struct residualLog* openResidualLog(const char* equationName, size_t nRes, int format);
+void writeResidualLog(struct residualLog* log, double time, int inBounds, double norm, const double* res);
+void closeResidualLog(struct residualLog* log);
+
+#endif // RESIDUAL_LOG_H
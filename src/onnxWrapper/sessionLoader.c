@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Deferred creation of ORT data of replaced equations.
+ *
+ * Each equation owns a slot that is filled exactly once, either by the
+ * simulation thread on the first call of the equation or by a background
+ * loader thread. The slot state is published with release semantics, so a
+ * thread seeing ORT_SLOT_READY also sees the complete ORT data.
+ */
+
+#include "sessionLoader.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Background threads working through the slots in order */
+struct sessionLoader {
+  struct ortDataSlot* slots;
+  size_t nSlots;
+  size_t next;                        /* Index of next slot to load, accessed atomically */
+  int nThreads;                       /* Number of started threads */
+  pthread_t* threads;
+};
+
+/**
+ * @brief Initialize empty slot.
+ *
+ * @param slot      Pointer to slot.
+ * @param init      Function creating ORT data of equation.
+ * @param userData  Argument of init.
+ */
+void initOrtDataSlot(struct ortDataSlot* slot, ortDataInitFunction init, void* userData) {
+  slot->init = init;
+  slot->userData = userData;
+  slot->ortData = NULL;
+  __atomic_store_n(&slot->state, ORT_SLOT_EMPTY, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Create ORT data of slot if no other thread does.
+ *
+ * @param slot    Pointer to slot.
+ * @return int    Return 1 if this call created the ORT data, 0 if the slot
+ *                was already loading or ready.
+ */
+int loadOrtDataSlot(struct ortDataSlot* slot) {
+  int expected = ORT_SLOT_EMPTY;
+
+  if (!__atomic_compare_exchange_n(&slot->state, &expected, ORT_SLOT_LOADING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+  slot->ortData = slot->init(slot->userData);
+  __atomic_store_n(&slot->state, ORT_SLOT_READY, __ATOMIC_RELEASE);
+  return 1;
+}
+
+/**
+ * @brief Get ORT data of slot without waiting for other threads.
+ *
+ * @param slot      Pointer to slot.
+ * @param load      Create ORT data in calling thread if nobody started yet.
+ * @return struct OrtWrapperData*   Pointer to ORT data or NULL if it isn't
+ *                                  ready yet or creation failed.
+ */
+struct OrtWrapperData* getOrtDataSlot(struct ortDataSlot* slot, int load) {
+  int state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+
+  if (state == ORT_SLOT_EMPTY && load) {
+    loadOrtDataSlot(slot);
+    state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+  }
+  return state == ORT_SLOT_READY ? slot->ortData : NULL;
+}
+
+/**
+ * @brief Thread function of session loader.
+ */
+static void* sessionLoaderThread(void* arg) {
+  struct sessionLoader* loader = (struct sessionLoader*) arg;
+  size_t i;
+
+  while ((i = __atomic_fetch_add(&loader->next, 1, __ATOMIC_RELAXED)) < loader->nSlots) {
+    loadOrtDataSlot(&loader->slots[i]);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Start background threads creating ORT data of all slots.
+ *
+ * Slots are loaded in order. If no thread can be started the slots are
+ * loaded in the calling thread.
+ *
+ * @param slots     Array of slots, has to stay valid until joinSessionLoader.
+ * @param nSlots    Number of slots.
+ * @param nThreads  Number of loader threads, at most nSlots are started.
+ * @return struct sessionLoader*  Pointer to loader, pass to joinSessionLoader.
+ */
+struct sessionLoader* startSessionLoader(struct ortDataSlot* slots, size_t nSlots, int nThreads) {
+  struct sessionLoader* loader = calloc(1, sizeof *loader);
+
+  loader->slots = slots;
+  loader->nSlots = nSlots;
+  if (nThreads < 1) {
+    nThreads = 1;
+  }
+  if ((size_t) nThreads > nSlots) {
+    nThreads = (int) nSlots;
+  }
+  loader->threads = calloc(nThreads > 0 ? nThreads : 1, sizeof loader->threads[0]);
+  for (int i = 0; i < nThreads; i++) {
+    if (pthread_create(&loader->threads[loader->nThreads], NULL, sessionLoaderThread, loader) == 0) {
+      loader->nThreads++;
+    }
+  }
+  if (loader->nThreads == 0 && nSlots > 0) {
+    printf("startSessionLoader: Can't start loader threads, loading %zu sessions now.\n", nSlots);
+    sessionLoaderThread(loader);
+  }
+  return loader;
+}
+
+/**
+ * @brief Wait for loader threads and free loader.
+ *
+ * @param loader  Pointer to loader, can be NULL.
+ */
+void joinSessionLoader(struct sessionLoader* loader) {
+  if (loader == NULL) {
+    return;
+  }
+  for (int i = 0; i < loader->nThreads; i++) {
+    pthread_join(loader->threads[i], NULL);
+  }
+  free(loader->threads);
+  free(loader);
+}
@@ -0,0 +1,60 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SESSION_LOADER_H
+#define SESSION_LOADER_H
+
+#include <stddef.h>
+
+struct OrtWrapperData;
+struct sessionLoader;
+
+/* When ORT data of replaced equations is created */
+enum sessionLoading {
+  SESSION_LOADING_EAGER,              /* During FMU setup, before simulation starts */
+  SESSION_LOADING_LAZY,               /* On first call of equation */
+  SESSION_LOADING_BACKGROUND          /* In background threads started during FMU setup */
+};
+
+/* State of an ORT data slot */
+enum ortDataSlotState {
+  ORT_SLOT_EMPTY,                     /* Not requested yet */
+  ORT_SLOT_LOADING,                   /* Created by some thread */
+  ORT_SLOT_READY                      /* ortData can be used, NULL if creation failed */
+};
+
+/* Creates ORT data of one equation */
+typedef struct OrtWrapperData* (*ortDataInitFunction)(void* userData);
+
+/* ORT data of one equation, created at most once by any thread */
+struct ortDataSlot {
+  ortDataInitFunction init;           /* Called with userData to create ortData */
+  void* userData;
+  int state;                          /* See enum ortDataSlotState, accessed atomically */
+  struct OrtWrapperData* ortData;     /* Valid once state is ORT_SLOT_READY */
+};
+
+/* Function prototypes */
+void initOrtDataSlot(struct ortDataSlot* slot, ortDataInitFunction init, void* userData);
+int loadOrtDataSlot(struct ortDataSlot* slot);
+struct OrtWrapperData* getOrtDataSlot(struct ortDataSlot* slot, int load);
+struct sessionLoader* startSessionLoader(struct ortDataSlot* slots, size_t nSlots, int nThreads);
+void joinSessionLoader(struct sessionLoader* loader);
+
+#endif // SESSION_LOADER_H
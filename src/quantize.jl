@@ -0,0 +1,354 @@
+#
+# Copyright (c) 2023 Andreas Heuermann
+#
+# This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+#
+
+# INT8 quantization of dense float ONNX models, saved in QDQ format.
+
+const ONNX_UINT8 = 2
+const ONNX_INT8 = 3
+
+"""
+Dense layer with symmetric INT8 weights and asymmetric UInt8 input.
+"""
+struct QuantizedLayer
+  weights::Matrix{Int8}       # nOut × nIn
+  weightScale::Float32
+  inputScale::Float32
+  inputZeroPoint::UInt8
+  bias::Vector{Float32}
+  activation::Symbol
+end
+
+"""
+Quantize layers of float `network`. Input ranges are calibrated on `X` with one column per sample.
+"""
+function quantizeNetwork(network::DenseNetwork, X::AbstractMatrix{Float64})::Vector{QuantizedLayer}
+  layers = QuantizedLayer[]
+  A = Float32.(X)
+  for layer in network.layers
+    # Range has to contain 0, so zero is exact
+    lo = min(minimum(A), 0.0f0)
+    hi = max(maximum(A), 0.0f0)
+    inputScale = hi > lo ? (hi - lo) / 255.0f0 : 1.0f0
+    inputZeroPoint = UInt8(clamp(round(-lo / inputScale), 0, 255))
+    maxWeight = maximum(abs, layer.weights)
+    weightScale = maxWeight > 0 ? Float32(maxWeight / 127) : 1.0f0
+    weights = Int8.(clamp.(round.(layer.weights ./ weightScale), -127, 127))
+    push!(layers, QuantizedLayer(weights, weightScale, inputScale, inputZeroPoint, Float32.(layer.bias), layer.activation))
+
+    A = activate.(Float32.(layer.weights) * A .+ Float32.(layer.bias), layer.activation)
+  end
+  return layers
+end
+
+# Minimal protobuf encoder for the ONNX messages of the QDQ model
+function pbVarint(io::IO, value::Integer)
+  v = UInt64(value)
+  while v >= 0x80
+    write(io, UInt8(v & 0x7f | 0x80))
+    v >>= 7
+  end
+  write(io, UInt8(v))
+end
+
+pbInt(io::IO, field::Integer, value::Integer) = (pbVarint(io, field << 3); pbVarint(io, value))
+pbBytes(io::IO, field::Integer, bytes::Vector{UInt8}) = (pbVarint(io, field << 3 | 2); pbVarint(io, length(bytes)); write(io, bytes))
+pbString(io::IO, field::Integer, str::String) = pbBytes(io, field, Vector{UInt8}(str))
+
+function pbMessage(f::Function)::Vector{UInt8}
+  io = IOBuffer()
+  f(io)
+  return take!(io)
+end
+
+littleEndianBytes(values::AbstractArray) = collect(reinterpret(UInt8, htol.(vec(values))))
+
+function onnxTensor(name::String, dims::Vector{Int}, dataType::Integer, values::AbstractArray)::Vector{UInt8}
+  return pbMessage() do io
+    for dim in dims
+      pbInt(io, 1, dim)
+    end
+    pbInt(io, 2, dataType)
+    pbString(io, 8, name)
+    pbBytes(io, 9, littleEndianBytes(values))
+  end
+end
+
+function onnxNode(opType::String, inputs::Vector{String}, output::String)::Vector{UInt8}
+  return pbMessage() do io
+    for input in inputs
+      pbString(io, 1, input)
+    end
+    pbString(io, 2, output)
+    pbString(io, 4, opType)
+  end
+end
+
+"""
+ValueInfoProto of float tensor {batch, n}.
+"""
+function onnxValueInfo(name::String, n::Integer)::Vector{UInt8}
+  shape = pbMessage() do io
+    pbBytes(io, 1, pbMessage(dim -> pbString(dim, 2, "batch")))
+    pbBytes(io, 1, pbMessage(dim -> pbInt(dim, 1, n)))
+  end
+  tensorType = pbMessage() do io
+    pbInt(io, 1, ONNX_FLOAT)
+    pbBytes(io, 2, shape)
+  end
+  return pbMessage() do io
+    pbString(io, 1, name)
+    pbBytes(io, 2, pbMessage(type -> pbBytes(type, 1, tensorType)))
+  end
+end
+
+"""
+Write quantized layers as ONNX model in QDQ format with float input "x" and output "y".
+"""
+function writeQuantizedOnnx(layers::Vector{QuantizedLayer}, outFile::String)
+  activations = Dict(:tanh => "Tanh", :relu => "Relu", :sigmoid => "Sigmoid")
+  graph = pbMessage() do io
+    current = "x"
+    for (l, layer) in enumerate(layers)
+      isLast = l == length(layers)
+      nOut, nIn = size(layer.weights)
+      # Initializers are row-major, MatMul weights have shape {nIn, nOut}
+      for tensor in (onnxTensor("x_scale$l", Int[], ONNX_FLOAT, [layer.inputScale]),
+                     onnxTensor("x_zero_point$l", Int[], ONNX_UINT8, [layer.inputZeroPoint]),
+                     onnxTensor("W_quantized$l", [nIn, nOut], ONNX_INT8, layer.weights),
+                     onnxTensor("W_scale$l", Int[], ONNX_FLOAT, [layer.weightScale]),
+                     onnxTensor("W_zero_point$l", Int[], ONNX_INT8, Int8[0]),
+                     onnxTensor("b$l", [nOut], ONNX_FLOAT, layer.bias))
+        pbBytes(io, 5, tensor)
+      end
+
+      z = isLast && layer.activation == :none ? "y" : "z$l"
+      for node in (onnxNode("QuantizeLinear", [current, "x_scale$l", "x_zero_point$l"], "x_quantized$l"),
+                   onnxNode("DequantizeLinear", ["x_quantized$l", "x_scale$l", "x_zero_point$l"], "x_dequantized$l"),
+                   onnxNode("DequantizeLinear", ["W_quantized$l", "W_scale$l", "W_zero_point$l"], "W$l"),
+                   onnxNode("MatMul", ["x_dequantized$l", "W$l"], "m$l"),
+                   onnxNode("Add", ["m$l", "b$l"], z))
+        pbBytes(io, 1, node)
+      end
+      current = z
+      if layer.activation != :none
+        current = isLast ? "y" : "a$l"
+        pbBytes(io, 1, onnxNode(activations[layer.activation], [z], current))
+      end
+    end
+    pbString(io, 2, "quantized")
+    pbBytes(io, 11, onnxValueInfo("x", size(first(layers).weights, 2)))
+    pbBytes(io, 12, onnxValueInfo("y", size(last(layers).weights, 1)))
+  end
+
+  model = pbMessage() do io
+    pbInt(io, 1, 7)                                   # ir_version
+    pbString(io, 2, "NonLinearSystemNeuralNetworkFMU")
+    pbBytes(io, 8, pbMessage(opset -> (pbString(opset, 1, ""); pbInt(opset, 2, 13))))
+    pbBytes(io, 7, graph)
+  end
+  write(outFile, model)
+end
+
+"""
+Build ONNX wrapper library in `buildDir` against ONNX Runtime from environment variable `ORT_DIR`.
+
+Returns path to shared library.
+"""
+function buildOnnxWrapperLib(buildDir::String)::String
+  if !haskey(ENV, "ORT_DIR")
+    error("Environment variable ORT_DIR isn't set, can't build ONNX wrapper.")
+  end
+  srcDir = joinpath(@__DIR__, "onnxWrapper")
+  run(`cmake -S $(srcDir) -B $(buildDir) -DORT_DIR=$(ENV["ORT_DIR"])`)
+  run(`cmake --build $(buildDir)`)
+  for file in readdir(buildDir)
+    if occursin("onnxWrapper", file) && endswith(file, "." * Libdl.dlext)
+      return joinpath(buildDir, file)
+    end
+  end
+  error("Can't find ONNX wrapper library in $(buildDir).")
+end
+
+"""
+Predictions of ONNX model `onnxFile` for inputs `X` with one column per sample.
+
+The model runs in the same ONNX Runtime session as in the ONNX FMU, see
+`initOrtData` and `evalModel` of the ONNX wrapper library `lib`.
+Returns pointer to ORT wrapper data and predictions, free with `deinitOrtData`.
+"""
+function wrapperPredictions(lib::Ptr{Nothing}, onnxFile::String, X::Matrix{Float64}, nOutputs::Integer, logName::String)
+  nInputs = size(X, 1)
+  ortData = ccall(Libdl.dlsym(lib, :initOrtData),
+                  Ptr{Nothing},
+                  (Cstring, Cstring, Cstring, Cuint, Cuint, Cint, Cint, Ptr{Nothing}),
+                  logName, onnxFile, "quantizeOnnx", nInputs, nOutputs, 1, 1, C_NULL)
+  if ortData == C_NULL
+    error("Can't load $(onnxFile) with ONNX wrapper.")
+  end
+  input = unsafe_wrap(Array, ccall(Libdl.dlsym(lib, :inputDataPtr), Ptr{Cdouble}, (Ptr{Nothing},), ortData), nInputs)
+  output = unsafe_wrap(Array, ccall(Libdl.dlsym(lib, :outputDataPtr), Ptr{Cdouble}, (Ptr{Nothing},), ortData), nOutputs)
+
+  predictions = Matrix{Float64}(undef, nOutputs, size(X, 2))
+  for k in axes(X, 2)
+    input .= X[:, k]
+    ccall(Libdl.dlsym(lib, :evalModel), Cvoid, (Ptr{Nothing},), ortData)
+    predictions[:, k] .= output
+  end
+  return ortData, predictions
+end
+
+"""
+Number of samples of each ONNX model whose predictions pass the residual check of equation `eq`.
+
+Models are evaluated with the ONNX wrapper library `lib` and residuals and
+Jacobians with the equation interface of `fmuPath`. The scaled residual norm
+is computed by `scaledResidualNormAt` of the wrapper, like the residual
+check of the ONNX FMU.
+"""
+function residualAcceptance(lib::Ptr{Nothing},
+                            fmuPath::String,
+                            eq::ProfilingInfo,
+                            onnxFiles::Vector{String},
+                            X::Matrix{Float64},
+                            maxRelError::Float64,
+                            workDir::String)::Vector{Int}
+  nOutputs = length(eq.iterationVariables)
+  inputs = Matrix{Float64}(X[1:length(eq.usingVars), :])
+  fmu = FMI.fmiLoad(fmuPath)
+  try
+    FMI.fmiInstantiate!(fmu; loggingOn = false, externalCallbacks=false)
+    FMI.fmiSetupExperiment(fmu)
+    FMI.fmiEnterInitializationMode(fmu)
+    FMI.fmiExitInitializationMode(fmu)
+    vrInputs = FMI.fmiStringToValueReference(fmu.modelDescription, eq.usingVars)
+
+    nAccepted = Int[]
+    for (i, onnxFile) in enumerate(onnxFiles)
+      ortData, x = wrapperPredictions(lib, onnxFile, X, nOutputs, joinpath(workDir, "model$(i)"))
+      try
+        _, res, jac, sampleStatus = fmiEvaluateJacobianBatch(fmu, eq.eqInfo.id, vrInputs, inputs, x)
+        accepted = 0
+        isRegular = Ref{Cint}(0)
+        for k in axes(x, 2)
+          rowNorms = vec(maximum(abs, jac[:, :, k]; dims=2))
+          resNorm = ccall(Libdl.dlsym(lib, :scaledResidualNormAt),
+                          Cdouble,
+                          (Ptr{Nothing}, Ptr{Cdouble}, Ptr{Cdouble}, Ptr{Cdouble}, Ref{Cint}),
+                          ortData, X[:, k], res[:, k], rowNorms, isRegular)
+          if sampleStatus[k] == fmi2OK && isRegular[] != 0 && resNorm <= maxRelError
+            accepted += 1
+          end
+        end
+        push!(nAccepted, accepted)
+      finally
+        ccall(Libdl.dlsym(lib, :deinitOrtData), Cvoid, (Ptr{Nothing},), ortData)
+      end
+    end
+    return nAccepted
+  finally
+    FMI.fmiUnload(fmu)
+  end
+end
+
+"""
+    quantizeOnnx(onnxFile, outFile, fmu, eq, csvFile; usePrevSol=false, maxRelError=1e-4, heldOutStep=5, workDir=mktempdir())
+
+Quantize dense float ONNX model to INT8 and compare residual acceptance rates.
+
+Weights are quantized symmetrically per layer, the inputs of each layer
+asymmetrically to UInt8 with ranges calibrated on training data `csvFile`.
+The model is saved in QDQ format with float input and output, so ONNX Runtime
+loads it like the original model and fuses the layers into integer kernels.
+
+Every `heldOutStep`-th row of `csvFile` isn't used for calibration. For these
+rows both models are evaluated by ONNX Runtime through the ONNX wrapper
+library of the FMU, and their predictions are checked with the scaled
+residual of equation `eq` of `fmu`, like the residual check of the ONNX FMU.
+The INT8 model is accepted if its acceptance rate isn't lower than the one of
+the float model. The wrapper library is built with CMake against ONNX Runtime
+from environment variable `ORT_DIR`, the same as for [`buildWithOnnx`](@ref).
+
+# Arguments
+  - `onnxFile::String`:     Path to float ONNX model of dense network.
+  - `outFile::String`:      Path to quantized ONNX model.
+  - `fmu::String`:          Path to FMU with equation interface, see [`addEqInterface2FMU`](@ref).
+  - `eq::ProfilingInfo`:    Profiling info of equation.
+  - `csvFile::String`:      Training data with columns for inputs and iteration variables of `eq`.
+
+# Keywords
+  - `usePrevSol::Bool`:       ONNX uses previous solution as additional input.
+  - `maxRelError::Float64`:   Maximum allowed scaled residual norm (default: 1e-4).
+  - `heldOutStep::Integer`:   Every `heldOutStep`-th row is held out from calibration (default: 5).
+  - `workDir::String`:        Directory for wrapper library build and residual logs (default: temporary directory).
+
+# Returns
+  - `true` if INT8 model is accepted, `false` otherwise.
+  - DataFrame with file size, number of held-out samples, accepted samples and
+    acceptance rate of both models side by side.
+
+See also [`buildWithOnnx`](@ref).
+"""
+function quantizeOnnx(onnxFile::String,
+                      outFile::String,
+                      fmu::String,
+                      eq::ProfilingInfo,
+                      csvFile::String;
+                      usePrevSol::Bool = false,
+                      maxRelError::Float64 = 1e-4,
+                      heldOutStep::Integer = 5,
+                      workDir::String = mktempdir())::Tuple{Bool, DataFrames.DataFrame}
+  if heldOutStep < 2
+    error("heldOutStep has to be at least 2.")
+  end
+  inputNames = usePrevSol ? vcat(eq.usingVars, eq.iterationVariables) : eq.usingVars
+  network = readDenseNetwork(onnxFile, length(inputNames), length(eq.iterationVariables))
+  if network isa String
+    error("Can't quantize $(onnxFile): $(network)")
+  elseif network.isDouble
+    error("Can't quantize $(onnxFile): Only float models can be quantized.")
+  end
+
+  df = CSV.read(csvFile, DataFrames.DataFrame; ntasks=1)
+  X = Matrix{Float64}(permutedims(Matrix(df[:, inputNames])))
+  heldOut = [i % heldOutStep == 0 for i in axes(X, 2)]
+  if !any(heldOut)
+    error("Not enough training data in $(csvFile) to hold out samples.")
+  end
+
+  layers = quantizeNetwork(network, X[:, .!heldOut])
+  writeQuantizedOnnx(layers, outFile)
+
+  # Compare both models in ONNX Runtime on held-out data
+  XHeldOut = X[:, heldOut]
+  lib = Libdl.dlopen(buildOnnxWrapperLib(joinpath(workDir, "onnxWrapper")))
+  nAccepted = try
+    residualAcceptance(lib, fmu, eq, [onnxFile, outFile], XHeldOut, maxRelError, workDir)
+  finally
+    Libdl.dlclose(lib)
+  end
+
+  nSamples = size(XHeldOut, 2)
+  report = DataFrames.DataFrame(model = ["float", "int8"],
+                                file = [onnxFile, outFile],
+                                bytes = filesize.([onnxFile, outFile]),
+                                samples = [nSamples, nSamples],
+                                accepted = nAccepted,
+                                acceptanceRate = nAccepted ./ nSamples)
+  return nAccepted[2] >= nAccepted[1], report
+end
@@ -0,0 +1,86 @@
+#
+# Copyright (c) 2023 Andreas Heuermann
+#
+# This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+#
+
+const RES_LOG_MAGIC = "NLSNNRES"
+const RES_LOG_NAME_LEN = 16
+
+"""
+    readResidualLog(file)
+
+Read residual log written by an ONNX FMU during simulation.
+
+Reads binary logs `<modelName>_eq<id>_residuum.bin` as well as CSV logs
+`<modelName>_eq<id>_residuum.csv`.
+
+# Arguments
+  - `file::String`: Path to residual log.
+
+# Returns
+  - `DataFrames.DataFrame` with columns `time`, `inBounds`, `scaled_res_norm`
+    and `res[i]` for each residual.
+
+See also [`convertResidualLog`](@ref), [`buildWithOnnx`](@ref).
+"""
+function readResidualLog(file::String)::DataFrames.DataFrame
+  if endswith(file, ".csv")
+    return CSV.read(file, DataFrames.DataFrame; ntasks=1)
+  end
+
+  open(file, "r") do io
+    magic = String(read(io, length(RES_LOG_MAGIC)))
+    if magic != RES_LOG_MAGIC
+      error("File $(file) is not a binary residual log.")
+    end
+    version = read(io, UInt32)
+    if version != 1
+      error("Binary residual log version $(version) not supported.")
+    end
+    nCols = Int(read(io, UInt32))
+    colNames = [rstrip(String(read(io, RES_LOG_NAME_LEN)), '\0') for _ in 1:nCols]
+
+    data = reinterpret(Float64, read(io))
+    nRows = div(length(data), nCols)
+    values = permutedims(reshape(data[1:nRows*nCols], nCols, nRows))
+
+    df = DataFrames.DataFrame(values, colNames)
+    df.inBounds = Int.(df.inBounds)
+    return df
+  end
+end
+
+"""
+    convertResidualLog(binFile, csvFile=replace(binFile, r"\\.bin\$" => ".csv"))
+
+Convert binary residual log to CSV file.
+
+# Arguments
+  - `binFile::String`: Path to binary residual log.
+  - `csvFile::String`: Path to CSV file to write.
+
+# Returns
+  - Path to CSV file.
+
+See also [`readResidualLog`](@ref).
+"""
+function convertResidualLog(binFile::String,
+                            csvFile::String = replace(binFile, r"\.bin$" => ".csv"))::String
+  df = readResidualLog(binFile)
+  CSV.write(csvFile, df)
+  return csvFile
+end
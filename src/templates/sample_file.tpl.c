@@ -0,0 +1,196 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Streaming binary output of sampled data points.
+ *
+ * Rows are written directly into a memory mapping of the sample file, which
+ * grows by doubling its capacity. Only the mapped pages are kept in memory, so
+ * the number of samples is bound by disk space.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sample_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define SAMPLE_FILE_INITIAL_CAPACITY 4096
+
+/**
+ * @brief Write header of sample file into buffer.
+ *
+ * @param header      Buffer of size headerSize.
+ * @param nCols       Number of columns.
+ * @param nRows       Number of rows.
+ * @param colNames    Array of nCols column names.
+ */
+static void writeSampleFileHeader(char* header, size_t nCols, size_t nRows, const char** colNames) {
+  uint32_t version = 1;
+  uint32_t nCols32 = (uint32_t) nCols;
+  uint64_t nRows64 = (uint64_t) nRows;
+
+  memcpy(header, SAMPLE_FILE_MAGIC, 8);
+  memcpy(header + 8, &version, sizeof version);
+  memcpy(header + 12, &nCols32, sizeof nCols32);
+  memcpy(header + 16, &nRows64, sizeof nRows64);
+  if (colNames != NULL) {
+    for (size_t i = 0; i < nCols; i++) {
+      strncpy(header + 24 + i*SAMPLE_FILE_NAME_LEN, colNames[i], SAMPLE_FILE_NAME_LEN - 1);
+    }
+  }
+}
+
+#ifndef _WIN32
+/**
+ * @brief Resize sample file and map header and capacity rows.
+ *
+ * @param file        Pointer to sample file.
+ * @param capacity    New capacity in rows.
+ * @return int        Return 1 on success, 0 otherwise.
+ */
+static int mapSampleFile(struct sampleFile* file, size_t capacity) {
+  size_t mapSize = file->headerSize + capacity*file->nCols*sizeof(double);
+
+  if (file->map != NULL) {
+    munmap(file->map, file->mapSize);
+    file->map = NULL;
+  }
+  if (ftruncate(file->fd, (off_t) mapSize) != 0) {
+    return 0;
+  }
+  file->map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+  if (file->map == MAP_FAILED) {
+    file->map = NULL;
+    return 0;
+  }
+  file->mapSize = mapSize;
+  file->capacity = capacity;
+  return 1;
+}
+#endif
+
+/**
+ * @brief Create sample file and write header.
+ *
+ * @param fileName              Path of sample file, overwritten if it exists.
+ * @param nCols                 Number of doubles per row.
+ * @param colNames              Array of nCols column names, names longer than
+ *                              63 characters are truncated.
+ * @return struct sampleFile*   Pointer to sample file or NULL on error.
+ */
+struct sampleFile* openSampleFile(const char* fileName, size_t nCols, const char** colNames) {
+  struct sampleFile* file = calloc(1, sizeof(struct sampleFile));
+  file->nCols = nCols;
+  file->headerSize = 24 + nCols*SAMPLE_FILE_NAME_LEN;
+
+#ifdef _WIN32
+  char* header = calloc(file->headerSize, 1);
+  file->file = fopen(fileName, "wb");
+  if (file->file == NULL) {
+    free(header);
+    free(file);
+    return NULL;
+  }
+  writeSampleFileHeader(header, nCols, 0, colNames);
+  fwrite(header, 1, file->headerSize, file->file);
+  free(header);
+  file->row = malloc(nCols*sizeof(double));
+#else
+  file->fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file->fd < 0) {
+    free(file);
+    return NULL;
+  }
+  if (!mapSampleFile(file, SAMPLE_FILE_INITIAL_CAPACITY)) {
+    close(file->fd);
+    free(file);
+    return NULL;
+  }
+  writeSampleFileHeader(file->map, nCols, 0, colNames);
+#endif
+
+  return file;
+}
+
+/**
+ * @brief Get pointer to next row of sample file.
+ *
+ * Fill the row and call commitSampleFileRow to add it to the file. The row is
+ * overwritten by the next call if it isn't committed.
+ *
+ * @param file        Pointer to sample file.
+ * @return double*    Pointer to nCols doubles or NULL if file can't grow.
+ */
+double* sampleFileRow(struct sampleFile* file) {
+#ifdef _WIN32
+  return file->row;
+#else
+  if (file->nRows == file->capacity && !mapSampleFile(file, 2*file->capacity)) {
+    return NULL;
+  }
+  return (double*) (file->map + file->headerSize) + file->nRows*file->nCols;
+#endif
+}
+
+/**
+ * @brief Add row returned by sampleFileRow to sample file.
+ *
+ * @param file        Pointer to sample file.
+ * @return int        Return 1 on success, 0 otherwise.
+ */
+int commitSampleFileRow(struct sampleFile* file) {
+#ifdef _WIN32
+  if (fwrite(file->row, sizeof(double), file->nCols, file->file) != file->nCols) {
+    return 0;
+  }
+#endif
+  file->nRows++;
+  return 1;
+}
+
+/**
+ * @brief Write number of rows, truncate file to its content and close it.
+ *
+ * @param file        Pointer to sample file, freed on return.
+ * @return int        Return 1 on success, 0 otherwise.
+ */
+int closeSampleFile(struct sampleFile* file) {
+  uint64_t nRows64 = (uint64_t) file->nRows;
+  int success = 1;
+
+#ifdef _WIN32
+  success = fseek(file->file, 16, SEEK_SET) == 0 && fwrite(&nRows64, sizeof nRows64, 1, file->file) == 1;
+  success = fclose(file->file) == 0 && success;
+  free(file->row);
+#else
+  memcpy(file->map + 16, &nRows64, sizeof nRows64);
+  munmap(file->map, file->mapSize);
+  success = ftruncate(file->fd, (off_t) (file->headerSize + file->nRows*file->nCols*sizeof(double))) == 0;
+  success = close(file->fd) == 0 && success;
+#endif
+  free(file);
+
+  return success;
+}
@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SAMPLE_FILE_H
+#define SAMPLE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Magic bytes at start of sample file */
+#define SAMPLE_FILE_MAGIC "NLSNNSMP"
+#define SAMPLE_FILE_NAME_LEN 64
+
+/*
+ * Sample file layout (native byte order):
+ *   char[8]   magic "NLSNNSMP"
+ *   uint32    version, currently 1
+ *   uint32    number of columns nCols
+ *   uint64    number of rows nRows
+ *   nCols x char[64]  zero padded column names
+ *   nRows records of nCols doubles
+ */
+
+/* Binary sample file written through a memory mapping */
+struct sampleFile {
+  size_t nCols;                       /* Number of doubles per row */
+  size_t nRows;                       /* Number of committed rows */
+  size_t capacity;                    /* Number of rows that fit into mapping */
+  size_t headerSize;                  /* Size of header in bytes, data starts here */
+#ifdef _WIN32
+  FILE* file;                         /* No mapping, rows are written with fwrite */
+  double* row;                        /* Buffer for next row */
+#else
+  int fd;                             /* File descriptor of sample file */
+  char* map;                          /* Mapping of header and capacity rows */
+  size_t mapSize;                     /* Size of mapping in bytes */
+#endif
+};
+
+/* Function prototypes */
+struct sampleFile* openSampleFile(const char* fileName, size_t nCols, const char** colNames);
+double* sampleFileRow(struct sampleFile* file);
+int commitSampleFileRow(struct sampleFile* file);
+int closeSampleFile(struct sampleFile* file);
+
+#endif // SAMPLE_FILE_H
@@ -6,7 +6,12 @@
 // GNU version 3 is obtained from: http://www.gnu.org/copyleft/gpl.html.
 //
 
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
 #include "special_interface.h"
+#include "sample_file.h"
 #include "../simulation/solver/solver_main.h"
 #include "../simulation/solver/nonlinearSolverHybrd.h"
 #include "../simulation/solver/nonlinearSolverHomotopy.h"
@@ -46,6 +51,62 @@ static inline void setThreadData(ModelInstance* comp)
 /* Forwarded equations */
 <<FORWARD_EQUATION_BLOCK>>
 
+typedef void (*equationFunction)(DATA* data, threadData_t* threadData);
+
+/**
+ * @brief Get equation function of equation.
+ *
+ * @param eqNumber            Equation number.
+ * @return equationFunction   Pointer to equation function or NULL if FMU has no
+ *                            interface for equation eqNumber.
+ */
+static equationFunction getEquationFunction(const size_t eqNumber)
+{
+  switch (eqNumber)
+  {
+<<EQUATION_FUNCTION_CASES>>
+  default:
+    return NULL;
+  }
+}
+
+typedef void (*residualFunction)(RESIDUAL_USERDATA* userData, const double* xloc, double* res, const int* iflag);
+
+/**
+ * @brief Get residual function of non-linear equation.
+ *
+ * @param eqNumber            Equation number.
+ * @return residualFunction   Pointer to residual function or NULL if FMU has no
+ *                            interface for equation eqNumber.
+ */
+static residualFunction getResidualFunction(const size_t eqNumber)
+{
+  switch (eqNumber)
+  {
+<<RESIDUAL_FUNCTION_CASES>>
+  default:
+    return NULL;
+  }
+}
+
+/**
+ * @brief Get number of non-linear system of equation.
+ *
+ * @param data          Pointer to simulation data.
+ * @param eqNumber      Equation number.
+ * @return long         Index of non-linear system or -1 if eqNumber isn't a
+ *                      non-linear system.
+ */
+static long getNLSSystemNumber(DATA* data, const size_t eqNumber)
+{
+  for (long i = 0; i < data->modelData->nNonLinearSystems; i++) {
+    if (data->simulationInfo->nonlinearSystemData[i].equationIndex == eqNumber) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 /**
  * @brief Evaluate equation.
  *
@@ -93,6 +154,291 @@ fmi2Status myfmi2EvaluateEq(fmi2Component c, const size_t eqNumber)
   return fmi2OK;
 }
 
+/**
+ * @brief Evaluate equation for one sample of a batch.
+ *
+ * @param comp          Pointer to FMU component.
+ * @param eqFunction    Equation function to evaluate.
+ * @return int          Return 1 on success, 0 if equation function threw an error.
+ */
+static int evaluateEqSample(ModelInstance* comp, equationFunction eqFunction)
+{
+  DATA* data = comp->fmuData;
+  threadData_t *threadData = comp->threadData;
+  int success = 0;
+
+  /* try */
+  MMC_TRY_INTERNAL(simulationJumpBuffer)
+
+  eqFunction(data, threadData);
+  comp->_need_update = 0;
+  success = 1;
+
+  /* catch */
+  MMC_CATCH_INTERNAL(simulationJumpBuffer)
+
+  return success;
+}
+
+/**
+ * @brief Evaluate equation for a batch of samples.
+ *
+ * For each sample the time, inputs and start values of the output variables
+ * are set, the equation is evaluated and the outputs are read. All arrays are
+ * contiguous with one row per sample.
+ *
+ * @param c             Pointer to FMU component.
+ * @param eqNumber      Equation to evaluate.
+ * @param nSamples      Number of samples.
+ * @param vrInputs      Value references of input variables, length nInputs.
+ * @param nInputs       Number of input variables.
+ * @param vrOutputs     Value references of output variables, length nOutputs.
+ * @param nOutputs      Number of output variables.
+ * @param time          Time of each sample, length nSamples, or NULL to keep time.
+ * @param inputs        Input values, size nSamples*nInputs.
+ * @param startValues   Start values of outputs, size nSamples*nOutputs, or NULL
+ *                      to start from solution of previous sample.
+ * @param outputs       Output values on return, size nSamples*nOutputs.
+ *                      Not changed for failed samples.
+ * @param status        Status of each sample on return, length nSamples.
+ * @return fmi2Status   Return fmi2OK if all samples were evaluated, fmi2Discard
+ *                      if some samples failed and fmi2Error if FMU has no
+ *                      interface for equation eqNumber.
+ */
+fmi2Status myfmi2EvaluateEqBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples,
+                                 const fmi2ValueReference vrInputs[], const size_t nInputs,
+                                 const fmi2ValueReference vrOutputs[], const size_t nOutputs,
+                                 const double* time, const double* inputs, const double* startValues,
+                                 double* outputs, fmi2Status* status)
+{
+  ModelInstance *comp = (ModelInstance *)c;
+  equationFunction eqFunction = getEquationFunction(eqNumber);
+  size_t nFailed = 0;
+
+  if (eqFunction == NULL) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateEqBatch: No interface for equation %u", eqNumber)
+    return fmi2Error;
+  }
+
+  useStream[LOG_NLS] = 0 /* false */;
+  useStream[LOG_NLS_V] = 0 /* false */;
+  useStream[LOG_ASSERT] = 0 /* false */;
+  FILTERED_LOG(comp, fmi2OK, LOG_FMI2_CALL, "myfmi2EvaluateEqBatch: Evaluating equation %u for %u samples", eqNumber, nSamples)
+
+  setThreadData(comp);
+  for (size_t i = 0; i < nSamples; i++) {
+    if (time != NULL) {
+      fmi2SetTime(c, time[i]);
+    }
+    fmi2SetReal(c, vrInputs, nInputs, &inputs[i*nInputs]);
+    if (startValues != NULL) {
+      fmi2SetReal(c, vrOutputs, nOutputs, &startValues[i*nOutputs]);
+    }
+
+    if (evaluateEqSample(comp, eqFunction)) {
+      status[i] = fmi2GetReal(c, vrOutputs, nOutputs, &outputs[i*nOutputs]);
+    } else {
+      status[i] = fmi2Error;
+    }
+    if (status[i] != fmi2OK) {
+      nFailed++;
+    }
+  }
+  resetThreadData(comp);
+
+  if (nFailed > 0) {
+    FILTERED_LOG(comp, fmi2Discard, LOG_FMI2_CALL, "myfmi2EvaluateEqBatch: %u of %u samples failed.", nFailed, nSamples)
+    return fmi2Discard;
+  }
+
+  return fmi2OK;
+}
+
+/* Random number generator of sampler, splitmix64 */
+static inline double sampleUniform(uint64_t* state)
+{
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return (z >> 11) * 0x1.0p-53;
+}
+
+/**
+ * @brief Sample data points of equation and stream them into a binary file.
+ *
+ * Same sampling as generateDataBatch: The first point is searched with up to 10
+ * random inputs. The remaining points are random or a random walk with step
+ * size delta*(inMax-inMin), starting from the solution of the previous point.
+ * After a failed point the start values are reset to zero, sampling stops
+ * after 10 consecutive failures. If time is an input the time of each point
+ * is increasing and random in timeBounds.
+ *
+ * Rows of the sample file are time (if timeBounds isn't NULL), inputs and
+ * outputs, see sample_file.h for the file layout.
+ *
+ * @param c             Pointer to FMU component.
+ * @param eqNumber      Equation to sample.
+ * @param fileName      Path of sample file to write.
+ * @param nSamples      Number of samples to generate.
+ * @param method        0 for random, 1 for random walk.
+ * @param delta         Step size of random walk.
+ * @param seed          Seed of random number generator.
+ * @param vrInputs      Value references of input variables, length nInputs.
+ * @param nInputs       Number of input variables.
+ * @param inMin         Minimum of input variables, length nInputs.
+ * @param inMax         Maximum of input variables, length nInputs.
+ * @param vrOutputs     Value references of output variables, length nOutputs.
+ * @param nOutputs      Number of output variables.
+ * @param timeBounds    Minimum and maximum time or NULL if time is no input.
+ * @param colNames      Column names of sample file.
+ * @param nGenerated    Number of generated samples on return.
+ * @return fmi2Status   Return fmi2OK if nSamples were generated, fmi2Warning if
+ *                      sampling stopped after too many failures and fmi2Error
+ *                      if FMU has no interface for equation eqNumber or the
+ *                      sample file can't be written.
+ */
+fmi2Status myfmi2SampleEq(fmi2Component c, const size_t eqNumber, const char* fileName, const size_t nSamples,
+                          const int method, const double delta, const unsigned long seed,
+                          const fmi2ValueReference vrInputs[], const size_t nInputs,
+                          const double* inMin, const double* inMax,
+                          const fmi2ValueReference vrOutputs[], const size_t nOutputs,
+                          const double* timeBounds, const char** colNames, size_t* nGenerated)
+{
+  ModelInstance *comp = (ModelInstance *)c;
+  equationFunction eqFunction = getEquationFunction(eqNumber);
+  const int maxFailures = 10;
+  const int useTime = timeBounds != NULL;
+  const size_t nCols = useTime + nInputs + nOutputs;
+  uint64_t rngState = (uint64_t) seed;
+  double* inputs;
+  double* startValues;
+  double* row;
+  double time, orderStat = 0.0;
+  int found = 0, nFailures = 0, fileError = 0;
+
+  *nGenerated = 0;
+  if (eqFunction == NULL) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2SampleEq: No interface for equation %u", eqNumber)
+    return fmi2Error;
+  }
+  struct sampleFile* file = openSampleFile(fileName, nCols, colNames);
+  if (file == NULL) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2SampleEq: Can't open sample file %s", fileName)
+    return fmi2Error;
+  }
+  inputs = (double*) malloc(nInputs*sizeof(double));
+  startValues = (double*) calloc(nOutputs, sizeof(double));
+
+  useStream[LOG_NLS] = 0 /* false */;
+  useStream[LOG_NLS_V] = 0 /* false */;
+  useStream[LOG_ASSERT] = 0 /* false */;
+  FILTERED_LOG(comp, fmi2OK, LOG_FMI2_CALL, "myfmi2SampleEq: Sampling equation %u for %u samples", eqNumber, nSamples)
+
+  setThreadData(comp);
+  time = useTime ? timeBounds[0] : 0.0;
+  while (*nGenerated < nSamples && nFailures < maxFailures && !fileError) {
+    /* Next inputs */
+    if (!found || method == 0) {
+      for (size_t i = 0; i < nInputs; i++) {
+        inputs[i] = (inMax[i] - inMin[i]) * sampleUniform(&rngState) + inMin[i];
+      }
+    } else {
+      for (size_t i = 0; i < nInputs; i++) {
+        inputs[i] += (inMax[i] - inMin[i]) * (2.0 * sampleUniform(&rngState) - 1.0) * delta;
+        inputs[i] = fmin(fmax(inputs[i], inMin[i]), inMax[i]);
+      }
+    }
+
+    if (useTime) {
+      fmi2SetTime(c, time);
+    }
+    fmi2SetReal(c, vrInputs, nInputs, inputs);
+    if (found) {
+      fmi2SetReal(c, vrOutputs, nOutputs, startValues);
+    }
+
+    row = sampleFileRow(file);
+    if (row == NULL) {
+      fileError = 1;
+    } else if (evaluateEqSample(comp, eqFunction) && fmi2GetReal(c, vrOutputs, nOutputs, startValues) == fmi2OK) {
+      /* Write time, inputs and outputs */
+      if (useTime) {
+        row[0] = time;
+      }
+      memcpy(row + useTime, inputs, nInputs*sizeof(double));
+      memcpy(row + useTime + nInputs, startValues, nOutputs*sizeof(double));
+      fileError = !commitSampleFileRow(file);
+      (*nGenerated)++;
+      found = 1;
+      nFailures = 0;
+
+      /* Next increasing random time, k-th order statistic of nSamples uniform values */
+      if (useTime) {
+        orderStat = 1.0 - (1.0 - orderStat) * pow(sampleUniform(&rngState), 1.0 / (double)(nSamples - *nGenerated + 1));
+        time = timeBounds[0] + (timeBounds[1] - timeBounds[0]) * orderStat;
+      }
+    } else {
+      /* Reset start value of iteration */
+      memset(startValues, 0, nOutputs*sizeof(double));
+      nFailures++;
+    }
+  }
+  resetThreadData(comp);
+
+  free(inputs);
+  free(startValues);
+  if (!closeSampleFile(file) || fileError) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2SampleEq: Failed to write sample file %s", fileName)
+    return fmi2Error;
+  }
+  if (*nGenerated < nSamples) {
+    FILTERED_LOG(comp, fmi2Warning, LOG_FMI2_CALL, "myfmi2SampleEq: Only %u of %u samples found.", *nGenerated, nSamples)
+    return fmi2Warning;
+  }
+
+  return fmi2OK;
+}
+
+nnTelemetryFunction nnTelemetryHook = NULL;
+
+/**
+ * @brief Get acceptance telemetry of equation replaced by ONNX surrogate.
+ *
+ * Values are the number of calls, accepted, unchecked, rejected by residual,
+ * rejected by singular Jacobian and rejected by the domain gate, the number of
+ * checked predictions with inputs outside of the training area, the number of
+ * fallback solves, the time spent in fallback solves in seconds and the number
+ * of calls served by an accepted extrapolation.
+ *
+ * @param c             Pointer to FMU component.
+ * @param eqNumber      Replaced equation.
+ * @param values        Array of length nValues, filled with telemetry values.
+ * @param nValues       Length of values.
+ * @return fmi2Status   Return fmi2OK on success, fmi2Error if FMU has no ONNX
+ *                      surrogate for equation eqNumber. All values are zero
+ *                      if the session of the surrogate isn't created yet.
+ */
+fmi2Status myfmi2GetNNTelemetry(fmi2Component c, const size_t eqNumber, double* values, const size_t nValues)
+{
+  ModelInstance *comp = (ModelInstance *)c;
+  enum nnSurrogateState state = nnTelemetryHook != NULL ? nnTelemetryHook(comp->fmuData, eqNumber, values, nValues) : NN_SURROGATE_NONE;
+
+  switch (state) {
+  case NN_SURROGATE_NONE:
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2GetNNTelemetry: No ONNX surrogate for equation %u", eqNumber)
+    return fmi2Error;
+  case NN_SURROGATE_NOT_LOADED:
+    memset(values, 0, nValues * sizeof values[0]);
+    FILTERED_LOG(comp, fmi2OK, LOG_FMI2_CALL, "myfmi2GetNNTelemetry: ONNX surrogate for equation %u not loaded yet", eqNumber)
+    return fmi2OK;
+  case NN_SURROGATE_LOADED:
+    break;
+  }
+
+  return fmi2OK;
+}
+
 /**
  * @brief Evaluate residual equation.
  *
@@ -149,88 +495,440 @@ fmi2Status myfmi2EvaluateRes(fmi2Component c, const size_t eqNumber, double* x,
 }
 
 /**
- * @brief Get pointer to Jacobian of non-linear equation system.
+ * @brief Set time and inputs of one sample of a batch.
  *
  * @param c             Pointer to FMU component.
- * @param sysNumber     Number of non-linear system.
- * @return jac          Return pointer to Jacobian matrix in row-major-format or
- *                      NULL in error case.
+ * @param sample        Index of sample.
+ * @param vrInputs      Value references of input variables, length nInputs.
+ * @param nInputs       Number of input variables.
+ * @param time          Time of each sample or NULL to keep time.
+ * @param inputs        Input values, size nSamples*nInputs.
  */
-double* getJac(DATA* data, const size_t sysNumber) {
-  double* jac;
-  NONLINEAR_SYSTEM_DATA* nlsSystem = &(data->simulationInfo->nonlinearSystemData[sysNumber]);
+static void setSampleInputs(fmi2Component c, const size_t sample,
+                            const fmi2ValueReference vrInputs[], const size_t nInputs,
+                            const double* time, const double* inputs)
+{
+  if (time != NULL) {
+    fmi2SetTime(c, time[sample]);
+  }
+  fmi2SetReal(c, vrInputs, nInputs, &inputs[sample*nInputs]);
+}
 
-  switch (nlsSystem->nlsMethod)
-  {
-  case NLS_HOMOTOPY:
-    // Get pointer from DATA_HOMOTOPY struct
-    return getHomotopyJacobian(nlsSystem);
-  default:
-    printf("Unknown NLS method  %d in myfmi2GetJac\n", (int)nlsSystem->nlsMethod);
-    return NULL;
+/**
+ * @brief Evaluate residual function for one sample of a batch.
+ *
+ * @param comp          Pointer to FMU component.
+ * @param resFunction   Residual function to evaluate.
+ * @param x             Iteration variables.
+ * @param res           Residual vector on return.
+ * @return int          Return 1 on success, 0 if residual function threw an error.
+ */
+static int evaluateResSample(ModelInstance* comp, residualFunction resFunction, const double* x, double* res)
+{
+  DATA* data = comp->fmuData;
+  threadData_t *threadData = comp->threadData;
+  int success = 0;
+  int iflag = 0;
+
+  RESIDUAL_USERDATA resUserData = {
+    .data       = data,
+    .threadData = threadData,
+    .solverData = NULL
+  };
+
+  /* try */
+  MMC_TRY_INTERNAL(simulationJumpBuffer)
+
+  resFunction(&resUserData, x, res, &iflag);
+  success = 1;
+
+  /* catch */
+  MMC_CATCH_INTERNAL(simulationJumpBuffer)
+
+  return success;
+}
+
+/**
+ * @brief Evaluate residual equation for a batch of samples.
+ *
+ * For each sample the time and inputs are set and f(x) = res is evaluated.
+ * All arrays are contiguous with one row per sample.
+ *
+ * @param c             Pointer to FMU component.
+ * @param eqNumber      Residual equation to evaluate.
+ * @param nSamples      Number of samples.
+ * @param vrInputs      Value references of input variables, length nInputs.
+ * @param nInputs       Number of input variables.
+ * @param time          Time of each sample, length nSamples, or NULL to keep time.
+ * @param inputs        Input values, size nSamples*nInputs.
+ * @param x             Iteration variables, size nSamples*nX.
+ * @param nX            Number of iteration variables.
+ * @param res           Residual vectors on return, size nSamples*nX.
+ * @param status        Status of each sample on return, length nSamples.
+ * @return fmi2Status   Return fmi2OK if all samples were evaluated, fmi2Discard
+ *                      if some samples failed and fmi2Error if FMU has no
+ *                      interface for equation eqNumber or nX doesn't match
+ *                      the size of the non-linear system.
+ */
+fmi2Status myfmi2EvaluateResBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples,
+                                  const fmi2ValueReference vrInputs[], const size_t nInputs,
+                                  const double* time, const double* inputs,
+                                  const double* x, const size_t nX, double* res, fmi2Status* status)
+{
+  ModelInstance *comp = (ModelInstance *)c;
+  residualFunction resFunction = getResidualFunction(eqNumber);
+  long sysNumber = getNLSSystemNumber(comp->fmuData, eqNumber);
+  size_t nFailed = 0;
+
+  if (resFunction == NULL || sysNumber < 0) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateResBatch: No interface for residual %u", eqNumber)
+    return fmi2Error;
+  }
+  if (nX != comp->fmuData->simulationInfo->nonlinearSystemData[sysNumber].size) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateResBatch: Residual %u has %u iteration variables, got %u",
+                 eqNumber, comp->fmuData->simulationInfo->nonlinearSystemData[sysNumber].size, nX)
+    return fmi2Error;
+  }
+
+  useStream[LOG_NLS] = 0 /* false */;
+  useStream[LOG_NLS_V] = 0 /* false */;
+  useStream[LOG_ASSERT] = 0 /* false */;
+  FILTERED_LOG(comp, fmi2OK, LOG_FMI2_CALL, "myfmi2EvaluateResBatch: Evaluating residual %u for %u samples", eqNumber, nSamples)
+
+  setThreadData(comp);
+  for (size_t i = 0; i < nSamples; i++) {
+    setSampleInputs(c, i, vrInputs, nInputs, time, inputs);
+    status[i] = evaluateResSample(comp, resFunction, &x[i*nX], &res[i*nX]) ? fmi2OK : fmi2Error;
+    if (status[i] != fmi2OK) {
+      nFailed++;
+    }
+  }
+  resetThreadData(comp);
+
+  if (nFailed > 0) {
+    FILTERED_LOG(comp, fmi2Discard, LOG_FMI2_CALL, "myfmi2EvaluateResBatch: %u of %u samples failed.", nFailed, nSamples)
+    return fmi2Discard;
   }
+
+  return fmi2OK;
 }
 
 /**
- * @brief Scale residual vector.
+ * @brief Add column of Jacobian to dense Jacobian and row scaling.
  *
- * @param jac             Pointer to n times n Jacobian in row-major format.
- * @param res             Pointer to residual vector to scale.
- * @param n               Size of jacobian and residual vector.
- * @return isRegular      Return 1 (true) if matrix is regular and 0 (false) if it's singular.
+ * @param jac           Jacobian in row-major format or NULL.
+ * @param scale         Maximum norm of each Jacobian row or NULL.
+ * @param n             Size of non-linear system.
+ * @param col           Column index.
+ * @param row           Row index.
+ * @param value         Value of Jacobian element.
  */
-int scaleResidual(double* jac, double* res, size_t n) {
-  int jac_row_start;
-  int isRegular = 1;
-  double scaling;
+static inline void setJacobianElement(double* jac, double* scale, const size_t n, const size_t col, const size_t row, const double value)
+{
+  if (jac != NULL) {
+    jac[row*n + col] = value;
+  }
+  if (scale != NULL && fabs(value) > scale[row]) {
+    scale[row] = fabs(value);
+  }
+}
 
-  for(int i=0; i<n; i++)
-  {
-    jac_row_start = i*n;
-    scaling = _omc_gen_maximumVectorNorm(&(jac[jac_row_start]), n);
-    if(scaling <= 0.0) {
-      //printf("Jacobian matrix is singular!\n");
-      scaling = 1e-16;
-      isRegular = 0;
+/**
+ * @brief Evaluate Jacobian of non-linear system at current iteration variables.
+ *
+ * Independent of the NLS method. Uses the analytical Jacobian of the model if
+ * available and colored forward differences of the residual function
+ * otherwise. Columns with the same color of the sparsity pattern are evaluated
+ * together, without sparsity pattern every column has its own color.
+ * The residual at x has to be evaluated before, which sets the iteration
+ * variables. On return the iteration variables are set to x again.
+ *
+ * @param data          Pointer to simulation data.
+ * @param threadData    Pointer to thread data.
+ * @param nlsSystem     Non-linear system of equation.
+ * @param x             Iteration variables, length n.
+ * @param res           Residual vector at x, length n.
+ * @param work          Work array of length 2*n.
+ * @param jac           Jacobian in row-major format on return, size n*n, or NULL.
+ * @param scale         Maximum norm of each Jacobian row on return, length n, or NULL.
+ * @return int          Return 1 on success, 0 if the model threw an error.
+ */
+static int evaluateNLSJacobian(DATA* data, threadData_t* threadData, NONLINEAR_SYSTEM_DATA* nlsSystem,
+                               const double* x, const double* res, double* work, double* jac, double* scale)
+{
+  const size_t n = nlsSystem->size;
+  SPARSE_PATTERN* sparsePattern;
+  double* xh = work;
+  double* resh = work + n;
+  unsigned int nColors;
+  int iflag = 0;
+  int success = 0;
+
+  RESIDUAL_USERDATA resUserData = {
+    .data       = data,
+    .threadData = threadData,
+    .solverData = NULL
+  };
+
+  if (jac != NULL) {
+    memset(jac, 0, n*n*sizeof(double));
+  }
+  if (scale != NULL) {
+    memset(scale, 0, n*sizeof(double));
+  }
+
+  /* try */
+  MMC_TRY_INTERNAL(simulationJumpBuffer)
+
+  if (nlsSystem->jacobianIndex != -1 && nlsSystem->analyticalJacobianColumn != NULL) {
+    /* Analytical Jacobian, one directional derivative per color */
+    JACOBIAN* jacobian = &(data->simulationInfo->analyticJacobians[nlsSystem->jacobianIndex]);
+    sparsePattern = jacobian->sparsePattern;
+    if (jacobian->constantEqns != NULL) {
+      jacobian->constantEqns(data, threadData, jacobian, NULL);
+    }
+    for (unsigned int color = 0; color < sparsePattern->maxColors; color++) {
+      for (size_t j = 0; j < n; j++) {
+        if (sparsePattern->colorCols[j]-1 == color) {
+          jacobian->seedVars[j] = 1.0;
+        }
+      }
+      nlsSystem->analyticalJacobianColumn(data, threadData, jacobian, NULL);
+      for (size_t j = 0; j < n; j++) {
+        if (sparsePattern->colorCols[j]-1 == color) {
+          for (unsigned int nz = sparsePattern->leadindex[j]; nz < sparsePattern->leadindex[j+1]; nz++) {
+            setJacobianElement(jac, scale, n, j, sparsePattern->index[nz], jacobian->resultVars[sparsePattern->index[nz]]);
+          }
+          jacobian->seedVars[j] = 0.0;
+        }
+      }
+    }
+  } else {
+    /* Colored forward differences, (f(x + sum h_j*e_j) - f(x)) / h_j for all columns j of one color */
+    sparsePattern = nlsSystem->isPatternAvailable ? nlsSystem->sparsePattern : NULL;
+    nColors = sparsePattern != NULL ? sparsePattern->maxColors : n;
+    memcpy(xh, x, n*sizeof(double));
+    for (unsigned int color = 0; color < nColors; color++) {
+      for (size_t j = 0; j < n; j++) {
+        if (sparsePattern != NULL ? sparsePattern->colorCols[j]-1 == color : j == color) {
+          xh[j] = x[j] + sqrt(DBL_EPSILON) * fmax(fabs(x[j]), 1.0);
+        }
+      }
+      nlsSystem->residualFunc(&resUserData, xh, resh, &iflag);
+      for (size_t j = 0; j < n; j++) {
+        if (xh[j] == x[j]) {
+          continue;
+        }
+        if (sparsePattern != NULL) {
+          for (unsigned int nz = sparsePattern->leadindex[j]; nz < sparsePattern->leadindex[j+1]; nz++) {
+            size_t i = sparsePattern->index[nz];
+            setJacobianElement(jac, scale, n, j, i, (resh[i] - res[i]) / (xh[j] - x[j]));
+          }
+        } else {
+          for (size_t i = 0; i < n; i++) {
+            setJacobianElement(jac, scale, n, j, i, (resh[i] - res[i]) / (xh[j] - x[j]));
+          }
+        }
+        xh[j] = x[j];
+      }
+    }
+
+    /* Reset iteration variables to x */
+    nlsSystem->residualFunc(&resUserData, x, resh, &iflag);
+  }
+  success = 1;
+
+  /* catch */
+  MMC_CATCH_INTERNAL(simulationJumpBuffer)
+
+  return success;
+}
+
+/**
+ * @brief Evaluate Jacobian of residual function at x for one sample of a batch.
+ *
+ * Evaluates the residual at x first, which sets the iteration variables,
+ * see evaluateNLSJacobian.
+ *
+ * @param comp          Pointer to FMU component.
+ * @param nlsSystem     Non-linear system of equation.
+ * @param resFunction   Residual function of equation.
+ * @param x             Iteration variables, length n.
+ * @param n             Size of non-linear system.
+ * @param res           Residual vector at x on return, length n.
+ * @param work          Work array of length 2*n.
+ * @param jac           Jacobian at x in row-major format on return, size n*n.
+ * @return int          Return 1 on success, 0 on error.
+ */
+static int evaluateJacobianSample(ModelInstance* comp, NONLINEAR_SYSTEM_DATA* nlsSystem, residualFunction resFunction,
+                                  const double* x, const size_t n, double* res, double* work, double* jac)
+{
+  if (!evaluateResSample(comp, resFunction, x, res)) {
+    return 0;
+  }
+  return evaluateNLSJacobian(comp->fmuData, comp->threadData, nlsSystem, x, res, work, jac, NULL);
+}
+
+/**
+ * @brief Evaluate residuals and Jacobians of non-linear equation for a batch of samples.
+ *
+ * For each sample the time and inputs are set and f(x) and its Jacobian are
+ * evaluated at x. All arrays are contiguous with one row per sample.
+ *
+ * @param c             Pointer to FMU component.
+ * @param eqNumber      Non-linear equation to evaluate.
+ * @param nSamples      Number of samples.
+ * @param vrInputs      Value references of input variables, length nInputs.
+ * @param nInputs       Number of input variables.
+ * @param time          Time of each sample, length nSamples, or NULL to keep time.
+ * @param inputs        Input values, size nSamples*nInputs.
+ * @param x             Iteration variables, size nSamples*nX.
+ * @param nX            Number of iteration variables.
+ * @param res           Residual vectors on return, size nSamples*nX, or NULL.
+ * @param jac           Jacobians in row-major format on return, size nSamples*nX*nX.
+ * @param status        Status of each sample on return, length nSamples.
+ * @return fmi2Status   Return fmi2OK if all samples were evaluated, fmi2Discard
+ *                      if some samples failed and fmi2Error if FMU has no
+ *                      interface for equation eqNumber or nX doesn't match
+ *                      the size of the non-linear system.
+ */
+fmi2Status myfmi2EvaluateJacobianBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples,
+                                       const fmi2ValueReference vrInputs[], const size_t nInputs,
+                                       const double* time, const double* inputs,
+                                       const double* x, const size_t nX, double* res, double* jac, fmi2Status* status)
+{
+  ModelInstance *comp = (ModelInstance *)c;
+  residualFunction resFunction = getResidualFunction(eqNumber);
+  long sysNumber = getNLSSystemNumber(comp->fmuData, eqNumber);
+  size_t nFailed = 0;
+
+  if (resFunction == NULL || sysNumber < 0) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateJacobianBatch: No interface for non-linear system %u", eqNumber)
+    return fmi2Error;
+  }
+  NONLINEAR_SYSTEM_DATA* nlsSystem = &(comp->fmuData->simulationInfo->nonlinearSystemData[sysNumber]);
+  if (nX != nlsSystem->size) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateJacobianBatch: Non-linear system %u has %u iteration variables, got %u",
+                 eqNumber, nlsSystem->size, nX)
+    return fmi2Error;
+  }
+  double* work = (double*) malloc(3*nX*sizeof(double));
+  if (work == NULL) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateJacobianBatch: Out of memory.")
+    return fmi2Error;
+  }
+
+  useStream[LOG_NLS] = 0 /* false */;
+  useStream[LOG_NLS_V] = 0 /* false */;
+  useStream[LOG_ASSERT] = 0 /* false */;
+  FILTERED_LOG(comp, fmi2OK, LOG_FMI2_CALL, "myfmi2EvaluateJacobianBatch: Evaluating Jacobian %u for %u samples", eqNumber, nSamples)
+
+  setThreadData(comp);
+  for (size_t i = 0; i < nSamples; i++) {
+    setSampleInputs(c, i, vrInputs, nInputs, time, inputs);
+    status[i] = evaluateJacobianSample(comp, nlsSystem, resFunction, &x[i*nX], nX,
+                                       res != NULL ? &res[i*nX] : work + 2*nX, work, &jac[i*nX*nX]) ? fmi2OK : fmi2Error;
+    if (status[i] != fmi2OK) {
+      nFailed++;
     }
-    res[i] = res[i] / scaling;
+  }
+  resetThreadData(comp);
+  free(work);
+
+  if (nFailed > 0) {
+    FILTERED_LOG(comp, fmi2Discard, LOG_FMI2_CALL, "myfmi2EvaluateJacobianBatch: %u of %u samples failed.", nFailed, nSamples)
+    return fmi2Discard;
   }
 
-  return isRegular;
+  return fmi2OK;
+}
+
+/**
+ * @brief Compute residual scaling of non-linear equation system.
+ *
+ * Maximum norm of each row of the Jacobian at x, see evaluateNLSJacobian.
+ * Works for all NLS methods and doesn't allocate the dense Jacobian.
+ *
+ * @param data          Pointer to simulation data.
+ * @param threadData    Pointer to thread data.
+ * @param sysNumber     Number of non-linear system.
+ * @param x             Iteration variables, residual has to be evaluated at x before.
+ * @param res           Residual vector at x.
+ * @param work          Work array of length 2*n.
+ * @param scale         Maximum norm of each Jacobian row on return.
+ * @return int          Return 1 on success, 0 on error.
+ */
+int getResidualScaling(DATA* data, threadData_t* threadData, const size_t sysNumber,
+                       const double* x, const double* res, double* work, double* scale) {
+  NONLINEAR_SYSTEM_DATA* nlsSystem = &(data->simulationInfo->nonlinearSystemData[sysNumber]);
+  return evaluateNLSJacobian(data, threadData, nlsSystem, x, res, work, NULL, scale);
+}
+
+/**
+ * @brief Start next solve of non-linear system from current iteration variables.
+ *
+ * The solver usually starts from values extrapolated from previous solutions.
+ * Resetting the time of the last solve makes solve_nonlinear_system start
+ * from nlsxOld instead, which is read from the iteration variables. Set the
+ * iteration variables to the NN prediction before calling the solver.
+ * Independent of the NLS method.
+ *
+ * @param data          Pointer to simulation data.
+ * @param sysNumber     Number of non-linear system.
+ */
+void warmStartNLS(DATA* data, const size_t sysNumber) {
+  NONLINEAR_SYSTEM_DATA* nlsSystem = &(data->simulationInfo->nonlinearSystemData[sysNumber]);
+  nlsSystem->lastTimeSolved = -DBL_MAX;
+}
+
+/**
+ * @brief Get accumulated solver statistics of non-linear system.
+ *
+ * @param data          Pointer to simulation data.
+ * @param sysNumber     Number of non-linear system.
+ * @param nIterations   On return number of solver iterations.
+ * @param nFEvals       On return number of residual function evaluations.
+ */
+void getNLSStatistics(DATA* data, const size_t sysNumber, unsigned long* nIterations, unsigned long* nFEvals) {
+  NONLINEAR_SYSTEM_DATA* nlsSystem = &(data->simulationInfo->nonlinearSystemData[sysNumber]);
+  *nIterations = nlsSystem->numberOfIterations;
+  *nFEvals = nlsSystem->numberOfFEval;
 }
 
 /**
  * @brief Evaluate Jacobian for a given nonlinear system.
  *
- * This function evaluates the Jacobian matrix for a given nonlinear system.
- * The Jacobian matrix is computed based on the method specified in the system's
- * configuration. Currently, only the homotopy method is supported.
+ * Evaluates the residual at x and the Jacobian at x, independent of the NLS
+ * method of the system, see evaluateNLSJacobian.
  *
  * @param c             Pointer to FMU component.
  * @param sysNumber     Number of non-linear system.
  * @param x             Iteration variables of non-linear system.
  * @param jac           Pointer to allocated memory of size length(x)^2.
  *                      On exit values of Jacobian matrix in row-major-format
- * @return fmi2Status
+ * @return fmi2Status   Return fmi2OK on success, fmi2Error otherwise.
  */
 fmi2Status myfmi2EvaluateJacobian(fmi2Component c, const size_t sysNumber, double* x, double* jac)
 {
   ModelInstance *comp = (ModelInstance *)c;
-  DATA* data = comp->fmuData;
-  threadData_t *threadData = comp->threadData;
-  NONLINEAR_SYSTEM_DATA* nlsSystem = &(data->simulationInfo->nonlinearSystemData[sysNumber]);
-  DATA_HOMOTOPY* solverData;
-  int status;
+  NONLINEAR_SYSTEM_DATA* nlsSystem = &(comp->fmuData->simulationInfo->nonlinearSystemData[sysNumber]);
+  double* work = (double*) malloc(3*nlsSystem->size*sizeof(double));
+  int success;
 
-  switch(nlsSystem->nlsMethod)
-  {
-    case NLS_HOMOTOPY:
-      solverData = (DATA_HOMOTOPY*) nlsSystem->solverData;
-      status = getAnalyticalJacobianHomotopy(solverData, jac);
-      break;
-    default:
-      printf("Unknown NLS method  %d in myfmi2GetJac\n", (int)nlsSystem->nlsMethod);
-      return fmi2Fatal;
+  if (work == NULL) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateJacobian: Out of memory.")
+    return fmi2Error;
   }
+  setThreadData(comp);
+  success = evaluateJacobianSample(comp, nlsSystem, nlsSystem->residualFunc, x, nlsSystem->size,
+                                   work + 2*nlsSystem->size, work, jac);
+  resetThreadData(comp);
+  free(work);
+
+  if (!success) {
+    FILTERED_LOG(comp, fmi2Error, LOG_FMI2_CALL, "myfmi2EvaluateJacobian: Caught an error.")
+    return fmi2Error;
+  }
+
   return fmi2OK;
 }
@@ -26,11 +26,44 @@
 extern "C" {
 #endif
 
+/* State of ONNX surrogate of an equation, returned by nnTelemetryFunction */
+enum nnSurrogateState {
+  NN_SURROGATE_NONE,                  /* Equation isn't replaced */
+  NN_SURROGATE_NOT_LOADED,            /* Session isn't created yet, values untouched */
+  NN_SURROGATE_LOADED                 /* Values filled with telemetry */
+};
+
+/* Telemetry of replaced equations, set by FMUs with ONNX surrogates */
+typedef enum nnSurrogateState (*nnTelemetryFunction)(DATA* data, const size_t eqNumber, double* values, const size_t nValues);
+extern nnTelemetryFunction nnTelemetryHook;
+
 FMI2_Export fmi2Status myfmi2EvaluateEq(fmi2Component c, const size_t eqNumber);
+FMI2_Export fmi2Status myfmi2EvaluateEqBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples,
+                                             const fmi2ValueReference vrInputs[], const size_t nInputs,
+                                             const fmi2ValueReference vrOutputs[], const size_t nOutputs,
+                                             const double* time, const double* inputs, const double* startValues,
+                                             double* outputs, fmi2Status* status);
+FMI2_Export fmi2Status myfmi2SampleEq(fmi2Component c, const size_t eqNumber, const char* fileName, const size_t nSamples,
+                                      const int method, const double delta, const unsigned long seed,
+                                      const fmi2ValueReference vrInputs[], const size_t nInputs,
+                                      const double* inMin, const double* inMax,
+                                      const fmi2ValueReference vrOutputs[], const size_t nOutputs,
+                                      const double* timeBounds, const char** colNames, size_t* nGenerated);
+FMI2_Export fmi2Status myfmi2GetNNTelemetry(fmi2Component c, const size_t eqNumber, double* values, const size_t nValues);
 fmi2Status myfmi2EvaluateRes(fmi2Component c, const size_t eqNumber, double* x, double* res);
 fmi2Status myfmi2EvaluateJacobian(fmi2Component c, const size_t eqNumber, double* x, double* res);
-double* getJac(DATA* data, const size_t sysNumber);
-int scaleResidual(double* jac, double* res, size_t n);
+FMI2_Export fmi2Status myfmi2EvaluateResBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples,
+                                              const fmi2ValueReference vrInputs[], const size_t nInputs,
+                                              const double* time, const double* inputs,
+                                              const double* x, const size_t nX, double* res, fmi2Status* status);
+FMI2_Export fmi2Status myfmi2EvaluateJacobianBatch(fmi2Component c, const size_t eqNumber, const size_t nSamples,
+                                                   const fmi2ValueReference vrInputs[], const size_t nInputs,
+                                                   const double* time, const double* inputs,
+                                                   const double* x, const size_t nX, double* res, double* jac, fmi2Status* status);
+int getResidualScaling(DATA* data, threadData_t* threadData, const size_t sysNumber,
+                       const double* x, const double* res, double* work, double* scale);
+void warmStartNLS(DATA* data, const size_t sysNumber);
+void getNLSStatistics(DATA* data, const size_t sysNumber, unsigned long* nIterations, unsigned long* nFEvals);
 
 #ifdef __cplusplus
 }  /* end of extern "C" { */
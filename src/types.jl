@@ -218,9 +218,11 @@ struct DataGenOptions
   append::Bool
   "Clean up temp CSV files"
   clean::Bool
+  "Where data points are sampled. Allowed values: `:julia`, `:fmu` to sample inside the FMU and stream points to binary files"
+  sampler::Symbol
 
   """
-      DataGenOptions(;method=RandomWalkMethod(delta=1e-3), n=1000:, nBatches=, nThreads=Threads.nthreads(), append=false, clean=true)
+      DataGenOptions(;method=RandomWalkMethod(delta=1e-3), n=1000:, nBatches=, nThreads=Threads.nthreads(), append=false, clean=true, sampler=:julia)
 
   Settings for data generation.
   """
@@ -229,13 +231,139 @@ struct DataGenOptions
                           nBatches::Integer=1,
                           nThreads::Integer=Threads.nthreads(),
                           append::Bool=false,
-                          clean::Bool=true)
+                          clean::Bool=true,
+                          sampler::Symbol=:julia)
     if nThreads <= 0
       error("nThreas=$(nThreads) too low. Use at least one thread.")
     elseif nThreads > Threads.nthreads()
       error("nThreas=$(nThreads) too large. Only $(Threads.nthreads()) threads available.")
     end
-    new(method, n, nBatches, nThreads, append, clean)
+    if !(sampler in (:julia, :fmu))
+      error("Sampler $(sampler) not supported. Has to be :julia or :fmu.")
+    end
+    new(method, n, nBatches, nThreads, append, clean, sampler)
+  end
+end
+
+"""
+    OrtOptions <: Any
+
+Session settings for ONNX Runtime (ORT) of a single replaced equation.
+
+Small networks are usually fastest with the default settings. Large networks
+can profit from own thread pools and parallel execution.
+
+$(DocStringExtensions.TYPEDFIELDS)
+
+See also [`buildWithOnnx`](@ref).
+"""
+struct OrtOptions
+  "Number of intra-op threads of own thread pool. Use 0 to use global thread pool shared by all equations."
+  intraOpNumThreads::Integer
+  "Number of inter-op threads of own thread pool. Use 0 to use global thread pool shared by all equations."
+  interOpNumThreads::Integer
+  "Execute graph nodes in parallel instead of sequential."
+  parallelExecution::Bool
+  "Graph optimization level. Allowed values: `:disable`, `:basic`, `:extended`, `:all`"
+  graphOptimizationLevel::Symbol
+  "Let idle threads spin-wait for new work."
+  allowSpinning::Bool
+  "Enable memory pattern optimization."
+  enableMemPattern::Bool
+  "Enable CPU memory arena."
+  enableCpuMemArena::Bool
+  "Bind input and output tensors once and skip name lookups on each call. Disables memory pattern and CPU memory arena."
+  fastPath::Bool
+  "Inference engine. Allowed values: `:ort` for ONNX Runtime, `:denseMLP` for the built-in engine for dense feed-forward networks, `:aot` to compile dense feed-forward networks into the FMU sources. Unsupported models fall back to ONNX Runtime."
+  backend::Symbol
+  "Number of checked predictions cached per FMU instance. Calls with cached inputs skip inference and residual check. Use 0 to disable the cache."
+  evalCacheSize::Integer
+  "Inputs are rounded to multiples of `evalCacheQuantum` before lookup, predictions of inputs that aren't bit-identical are checked again. Use 0 to only reuse predictions of bit-identical inputs."
+  evalCacheQuantum::Float64
+
+  """
+      OrtOptions(;intraOpNumThreads=0, interOpNumThreads=0, parallelExecution=false, graphOptimizationLevel=:all, allowSpinning=false, enableMemPattern=true, enableCpuMemArena=true, fastPath=false, backend=:ort, evalCacheSize=0, evalCacheQuantum=0.0)
+
+  `OrtOptions` constructor.
+  """
+  function OrtOptions(;intraOpNumThreads::Integer = 0,
+                      interOpNumThreads::Integer = 0,
+                      parallelExecution::Bool = false,
+                      graphOptimizationLevel::Symbol = :all,
+                      allowSpinning::Bool = false,
+                      enableMemPattern::Bool = true,
+                      enableCpuMemArena::Bool = true,
+                      fastPath::Bool = false,
+                      backend::Symbol = :ort,
+                      evalCacheSize::Integer = 0,
+                      evalCacheQuantum::Real = 0.0)
+    if intraOpNumThreads < 0 || interOpNumThreads < 0
+      error("Number of threads has to be non-negative.")
+    end
+    if !in(graphOptimizationLevel, (:disable, :basic, :extended, :all))
+      error("Graph optimization level $(graphOptimizationLevel) not supported. Has to be :disable, :basic, :extended or :all.")
+    end
+    if !in(backend, (:ort, :denseMLP, :aot))
+      error("Backend $(backend) not supported. Has to be :ort, :denseMLP or :aot.")
+    end
+    if evalCacheSize < 0 || evalCacheQuantum < 0
+      error("Evaluation cache size and quantum have to be non-negative.")
+    end
+    new(intraOpNumThreads, interOpNumThreads, parallelExecution, graphOptimizationLevel, allowSpinning, enableMemPattern, enableCpuMemArena, fastPath, backend, evalCacheSize, evalCacheQuantum)
+  end
+end
+
+"""
+    ResidualCheckOptions <: Any
+
+Policy when to check residuals of accepted ONNX predictions.
+
+Checking the residual of every prediction can cost more than the evaluation of
+the ONNX model. Skipping checks increases throughput, but predictions outside
+the trained region are detected later. Checks are never skipped during events
+and within `eventWindow` after an event. After a rejected prediction every call
+is checked again.
+
+Residuals are scaled with the maximum norm of the Jacobian rows. The scaling is
+cached and only updated during events or when inputs or outputs changed by
+more than `scalingTolerance` relative to the last update.
+
+$(DocStringExtensions.TYPEDFIELDS)
+
+See also [`buildWithOnnx`](@ref).
+"""
+struct ResidualCheckOptions
+  "Check every `interval`-th call."
+  interval::Integer
+  "Maximum check interval after back-off."
+  maxInterval::Integer
+  "Number of consecutive accepted checks before the interval is doubled. Use 0 to disable back-off."
+  backoffAccepts::Integer
+  "Check every call within `eventWindow` after an event."
+  eventWindow::Float64
+  "Relative change of inputs or outputs before the residual scaling is updated. Use 0 to update on every check."
+  scalingTolerance::Float64
+
+  """
+      ResidualCheckOptions(;interval=1, maxInterval=interval, backoffAccepts=0, eventWindow=0.0, scalingTolerance=1e-3)
+
+  `ResidualCheckOptions` constructor. Default checks every call.
+  """
+  function ResidualCheckOptions(;interval::Integer = 1,
+                                maxInterval::Integer = interval,
+                                backoffAccepts::Integer = 0,
+                                eventWindow::Real = 0.0,
+                                scalingTolerance::Real = 1e-3)
+    if interval < 1
+      error("Check interval has to be positive.")
+    end
+    if maxInterval < interval
+      error("Maximum check interval has to be greater or equal to interval.")
+    end
+    if backoffAccepts < 0 || eventWindow < 0 || scalingTolerance < 0
+      error("backoffAccepts, eventWindow and scalingTolerance have to be non-negative.")
+    end
+    new(interval, maxInterval, backoffAccepts, Float64(eventWindow), Float64(scalingTolerance))
   end
 end
 
@@ -20,15 +20,15 @@
 using Test
 using NonLinearSystemNeuralNetworkFMU
 
-function runGenDataTest()
+function runGenDataTest(; sampler::Symbol = :julia)
   pathToFMU = abspath(joinpath(@__DIR__, "fmus", "simpleLoop.interface.fmu"))
   workDir = abspath(joinpath(@__DIR__, "data"))
   eqIndex = 14
   inputVars = ["s", "r"]
   outputVars = ["y"]
   inputBoundary = MinMaxBoundaryValues([0.8, 0.95], [1.5, 2.05])
-  fileName = joinpath(workDir, "simpleLoop_eq14.csv")
-  options = DataGenOptions(method=RandomMethod(), n=1984, nBatches=2, nThreads=1, clean=true)
+  fileName = joinpath(workDir, sampler === :julia ? "simpleLoop_eq14.csv" : "simpleLoop_eq14_$(sampler).csv")
+  options = DataGenOptions(method=RandomMethod(), n=1984, nBatches=2, nThreads=1, clean=true, sampler=sampler)
 
   generateTrainingData(pathToFMU,
                        workDir,
@@ -61,3 +61,4 @@ function runGenDataTest()
 end
 
 runGenDataTest()
+runGenDataTest(sampler=:fmu)
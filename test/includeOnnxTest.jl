@@ -30,6 +30,15 @@ function runIncludeOnnxTests()
 
   @assert haskey(ENV, "ORT_DIR") "Environamet variable `ORT_DIR` has to be set and point to ONNX Runtime directory for testing."
 
+  @testset "Compile ONNX into C" begin
+    onnxFile = abspath(@__DIR__, "nn", "simpleLoop_eq14.onnx")
+    network = readDenseNetwork(onnxFile, 2, 1)
+    @test network isa NonLinearSystemNeuralNetworkFMU.DenseNetwork
+    @test [layer.activation for layer in network.layers] == [:tanh, :tanh, :none]
+    @test occursin("static void aotModel_eq14(const double* input, double* output)", aotModelCode(network, "aotModel_eq14"))
+    @test readDenseNetwork(onnxFile, 3, 1) isa String
+  end
+
   @testset "Build FMU with ONNX" begin
     modelname = "simpleLoop"
     fmuDir = abspath(joinpath(@__DIR__, "fmus"))
@@ -48,6 +57,13 @@ function runIncludeOnnxTests()
         NonLinearSystemNeuralNetworkFMU.MinMaxBoundaryValues([0.0, 0.95], [1.4087228258248679, 3.15]))]
     onnxFiles = [abspath(@__DIR__, "nn", "simpleLoop_eq14.onnx")]
 
+    csvFile = abspath(@__DIR__, "data", "simpleLoop_eq14.csv")
+    int8File = joinpath(fmuDir, "simpleLoop_eq14.int8.onnx")
+    accepted, report = quantizeOnnx(onnxFiles[1], int8File, interfaceFmu, profilingInfo[1], csvFile)
+    @test isfile(int8File)
+    @test report.model == ["float", "int8"]
+    @test all(0 .<= report.acceptanceRate .<= 1)
+
     pathToFmu = NonLinearSystemNeuralNetworkFMU.buildWithOnnx(interfaceFmu, modelname, profilingInfo, onnxFiles; tempDir=tempDir)
     @test isfile(pathToFmu)
     # Save FMU for next test
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Batched evaluation: evalModelBatch has to match row-by-row evalModel for
+// float and double models, also after the batch arrays grew. The batched
+// residual norm has to match the scaled norm of the acceptance check.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "onnxWrapper.h"
+#include "mlpModel.h"
+#include "testUtil.h"
+
+#define N_INPUTS 4
+#define N_OUTPUTS 3
+#define MAX_BATCH 37
+
+/* Inputs of residual function set by setInputs */
+struct residualData {
+  double input[N_INPUTS];
+};
+
+static void setInputs(void* userData, const double* input) {
+  memcpy(((struct residualData*) userData)->input, input, sizeof(double)*N_INPUTS);
+}
+
+/* res = x - input, x are the model outputs */
+static void residual(void* userData, const double* x, double* res, const int* iflag) {
+  const struct residualData* data = userData;
+  (void) iflag;
+  for (int i = 0; i < N_OUTPUTS; i++) {
+    res[i] = x[i] - data->input[i];
+  }
+}
+
+static void checkBatch(struct OrtWrapperData* ortData, size_t batchSize, double tol) {
+  double expected[MAX_BATCH*N_OUTPUTS];
+
+  double* input = batchInputDataPtr(ortData, batchSize);
+  CHECK(ortData->batchCapacity >= batchSize);
+  for (size_t i = 0; i < batchSize*N_INPUTS; i++) {
+    input[i] = 4.0 * rand() / RAND_MAX - 2.0;
+  }
+  for (size_t row = 0; row < batchSize; row++) {
+    memcpy(ortData->input, &input[row*N_INPUTS], sizeof(double)*N_INPUTS);
+    evalModel(ortData);
+    memcpy(&expected[row*N_OUTPUTS], ortData->x, sizeof(double)*N_OUTPUTS);
+  }
+
+  evalModelBatch(ortData, batchSize);
+  const double* output = batchOutputDataPtr(ortData);
+  for (size_t i = 0; i < batchSize*N_OUTPUTS; i++) {
+    CHECK_CLOSE(output[i], expected[i], tol);
+  }
+}
+
+static void testEvalModelBatch(int elemType, double tol) {
+  const char* path = elemType == MLP_DOUBLE ? "testBatch_double.onnx" : "testBatch_float.onnx";
+
+  CHECK(writeMLPModelType(path, N_INPUTS, N_OUTPUTS, 8, 1, elemType));
+  struct OrtWrapperData* ortData = initOrtData("testBatch", path, "testBatch", N_INPUTS, N_OUTPUTS, 0, 1, NULL);
+  CHECK(ortData != NULL);
+  if (ortData == NULL) {
+    return;
+  }
+  CHECK(ortData->elementType == (elemType == MLP_DOUBLE ? ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE : ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+
+  checkBatch(ortData, 3, tol);
+  size_t capacity = ortData->batchCapacity;
+  checkBatch(ortData, MAX_BATCH, tol);            /* Arrays grow */
+  CHECK(ortData->batchCapacity > capacity);
+  checkBatch(ortData, 5, tol);                    /* Arrays are reused */
+  checkBatch(ortData, 1, tol);
+
+  deinitOrtData(ortData);
+  remove(path);
+}
+
+static void testResidualNormBatch() {
+  const char* path = "testBatch_residual.onnx";
+  const size_t batchSize = 6;
+  struct residualData data;
+  double res[6*N_OUTPUTS], scaled[6*N_OUTPUTS], scale[6*N_OUTPUTS], norms[6];
+  int isRegular[6], rowIsRegular;
+
+  CHECK(writeMLPModel(path, N_INPUTS, N_OUTPUTS, 8, 1));
+  struct OrtWrapperData* ortData = initOrtData("testBatch", path, "testBatch", N_INPUTS, N_OUTPUTS, 1, 1, NULL);
+  CHECK(ortData != NULL);
+  if (ortData == NULL) {
+    return;
+  }
+
+  double* input = batchInputDataPtr(ortData, batchSize);
+  for (size_t i = 0; i < batchSize*N_INPUTS; i++) {
+    input[i] = 4.0 * rand() / RAND_MAX - 2.0;
+  }
+  for (size_t i = 0; i < batchSize*N_OUTPUTS; i++) {
+    scale[i] = 0.5 + 4.0 * rand() / RAND_MAX;
+  }
+  scale[4*N_OUTPUTS + 1] = 0.0;                   /* Singular Jacobian in row 4 */
+  evalModelBatch(ortData, batchSize);
+  evalResidualBatch(residual, setInputs, &data, ortData, batchSize, res);
+  memcpy(scaled, res, sizeof res);
+  residualNormBatch(scale, scaled, N_OUTPUTS, batchSize, norms, isRegular);
+
+  for (size_t row = 0; row < batchSize; row++) {
+    double expected = scaledResidualNormAt(ortData, &input[row*N_INPUTS], &res[row*N_OUTPUTS], &scale[row*N_OUTPUTS], &rowIsRegular);
+    CHECK(isRegular[row] == (row != 4));
+    CHECK(isRegular[row] == rowIsRegular);
+    if (isRegular[row]) {
+      CHECK_CLOSE(norms[row], expected, 1e-12);
+    }
+  }
+
+  deinitOrtData(ortData);
+  remove(path);
+  remove("testBatch_residuum.csv");
+}
+
+int main() {
+  srand(42);
+  testEvalModelBatch(MLP_FLOAT, 1e-6);
+  testEvalModelBatch(MLP_DOUBLE, 1e-12);
+  testResidualNormBatch();
+  return testResult("testBatch");
+}
@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Built-in dense MLP engine: outputs of Gemm/Tanh networks have to match the
+// ONNX Runtime session of the same model.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "onnxWrapper.h"
+#include "mlpModel.h"
+#include "testUtil.h"
+
+#define N_INPUTS 5
+#define N_OUTPUTS 3
+#define N_SAMPLES 20
+
+static void testParity(int width, int depth) {
+  struct OrtWrapperOptions ortOptions = defaultOrtWrapperOptions();
+  struct OrtWrapperOptions mlpOptions = defaultOrtWrapperOptions();
+  double inputs[N_SAMPLES*N_INPUTS];
+  double maxError;
+  char path[64];
+
+  mlpOptions.backend = ONNX_BACKEND_DENSE_MLP;
+  snprintf(path, sizeof path, "testDenseMLP_w%i_d%i.onnx", width, depth);
+  CHECK(writeMLPModel(path, N_INPUTS, N_OUTPUTS, width, depth));
+  for (int i = 0; i < N_SAMPLES*N_INPUTS; i++) {
+    inputs[i] = 4.0 * rand() / RAND_MAX - 2.0;
+  }
+
+  struct OrtWrapperData* ortData = initOrtData("testDenseMLP", path, "testDenseMLP", N_INPUTS, N_OUTPUTS, 0, 1, &ortOptions);
+  struct OrtWrapperData* mlpData = initOrtData("testDenseMLP", path, "testDenseMLP", N_INPUTS, N_OUTPUTS, 0, 1, &mlpOptions);
+  CHECK(ortData != NULL && ortData->mlp == NULL);
+  CHECK(mlpData != NULL && mlpData->mlp != NULL);
+  if (ortData == NULL || mlpData == NULL) {
+    return;
+  }
+
+  for (int sample = 0; sample < N_SAMPLES; sample++) {
+    for (int i = 0; i < N_INPUTS; i++) {
+      ortData->input[i] = inputs[sample*N_INPUTS + i];
+      mlpData->input[i] = inputs[sample*N_INPUTS + i];
+    }
+    evalModel(ortData);
+    evalModel(mlpData);
+    for (int i = 0; i < N_OUTPUTS; i++) {
+      CHECK_CLOSE(mlpData->x[i], ortData->x[i], 1e-6);
+    }
+  }
+
+  CHECK(checkModelParity(mlpData, path, inputs, N_SAMPLES, &maxError));
+  CHECK(maxError <= 1e-6);
+
+  deinitOrtData(ortData);
+  deinitOrtData(mlpData);
+  remove(path);
+}
+
+int main() {
+  srand(42);
+  testParity(8, 0);
+  testParity(8, 1);
+  testParity(16, 3);
+  return testResult("testDenseMLP");
+}
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Evaluation cache: exact and quantized hits, eviction of least recently
+// used entries and inputs that can't be cached.
+
+#include "onnxWrapper.h"
+#include "testUtil.h"
+
+static void testExactHits() {
+  struct EvalCache* cache = createEvalCache(8, 0, 2, 1);
+  double input[2] = {1.0, 2.0};
+  double output = 0;
+  double prediction = 3.5;
+  int verdict = -1;
+
+  CHECK(lookupEvalCache(cache, input, &output, &verdict) == EVAL_CACHE_MISS);
+  storeEvalCache(cache, input, &prediction, NN_REJECTED_SINGULAR);
+  CHECK(lookupEvalCache(cache, input, &output, &verdict) == EVAL_CACHE_EXACT);
+  CHECK(output == prediction);
+  CHECK(verdict == NN_REJECTED_SINGULAR);
+
+  /* Without quantum only bit-identical inputs match, -0 is the same as 0 */
+  input[0] = nextafter(1.0, 2.0);
+  CHECK(lookupEvalCache(cache, input, &output, &verdict) == EVAL_CACHE_MISS);
+  input[0] = 0.0;
+  storeEvalCache(cache, input, &prediction, NN_ACCEPTED);
+  input[0] = -0.0;
+  CHECK(lookupEvalCache(cache, input, &output, &verdict) == EVAL_CACHE_EXACT);
+  CHECK(verdict == NN_ACCEPTED);
+
+  CHECK(cache->nHits == 2);
+  CHECK(cache->nNearHits == 0);
+  CHECK(cache->nMisses == 2);
+
+  clearEvalCache(cache);
+  CHECK(lookupEvalCache(cache, input, &output, &verdict) == EVAL_CACHE_MISS);
+  CHECK(cache->nHits == 0);
+  freeEvalCache(cache);
+}
+
+static void testQuantizedHits() {
+  struct EvalCache* cache = createEvalCache(8, 0.1, 2, 1);
+  double stored[2] = {1.0, 2.0};
+  double near[2] = {1.02, 1.98};
+  double far[2] = {1.2, 2.0};
+  double output = 0;
+  double prediction = 3.5;
+  int verdict = -1;
+
+  storeEvalCache(cache, stored, &prediction, NN_ACCEPTED);
+
+  /* Same key after rounding, prediction is reused but verdict isn't */
+  CHECK(lookupEvalCache(cache, near, &output, &verdict) == EVAL_CACHE_NEAR);
+  CHECK(output == prediction);
+  CHECK(verdict == -1);
+  CHECK(cache->nNearHits == 1);
+  CHECK(lookupEvalCache(cache, far, &output, &verdict) == EVAL_CACHE_MISS);
+
+  /* Storing the checked prediction makes the new inputs exact */
+  storeEvalCache(cache, near, &prediction, NN_REJECTED_RESIDUAL);
+  CHECK(lookupEvalCache(cache, near, &output, &verdict) == EVAL_CACHE_EXACT);
+  CHECK(verdict == NN_REJECTED_RESIDUAL);
+  verdict = -1;
+  CHECK(lookupEvalCache(cache, stored, &output, &verdict) == EVAL_CACHE_NEAR);
+  CHECK(verdict == -1);
+  freeEvalCache(cache);
+}
+
+static void testEviction() {
+  /* One set of EVAL_CACHE_WAYS entries */
+  struct EvalCache* cache = createEvalCache(EVAL_CACHE_WAYS, 0, 1, 1);
+  double input, output;
+  int verdict;
+
+  CHECK(cache->nSets == 1);
+  for (int i = 0; i < EVAL_CACHE_WAYS; i++) {
+    input = i;
+    output = 10.0 * i;
+    storeEvalCache(cache, &input, &output, NN_ACCEPTED);
+  }
+  CHECK(cache->nEvictions == 0);
+
+  /* Use entry 0, entry 1 is the least recently used one */
+  input = 0;
+  CHECK(lookupEvalCache(cache, &input, &output, &verdict) == EVAL_CACHE_EXACT);
+  input = EVAL_CACHE_WAYS;
+  output = -1;
+  storeEvalCache(cache, &input, &output, NN_ACCEPTED);
+  CHECK(cache->nEvictions == 1);
+
+  input = 1;
+  CHECK(lookupEvalCache(cache, &input, &output, &verdict) == EVAL_CACHE_MISS);
+  for (int i = 0; i < EVAL_CACHE_WAYS + 1; i++) {
+    if (i == 1) {
+      continue;
+    }
+    input = i;
+    CHECK(lookupEvalCache(cache, &input, &output, &verdict) == EVAL_CACHE_EXACT);
+    CHECK(output == (i == EVAL_CACHE_WAYS ? -1 : 10.0 * i));
+  }
+  freeEvalCache(cache);
+}
+
+static void testNotCacheable() {
+  struct EvalCache* cache = createEvalCache(8, 0, 1, 1);
+  double input = NAN;
+  double output = 1;
+  int verdict;
+
+  storeEvalCache(cache, &input, &output, NN_ACCEPTED);
+  CHECK(lookupEvalCache(cache, &input, &output, &verdict) == EVAL_CACHE_MISS);
+  input = INFINITY;
+  storeEvalCache(cache, &input, &output, NN_ACCEPTED);
+  CHECK(lookupEvalCache(cache, &input, &output, &verdict) == EVAL_CACHE_MISS);
+  freeEvalCache(cache);
+
+  CHECK(createEvalCache(0, 0, 1, 1) == NULL);
+}
+
+int main() {
+  testExactHits();
+  testQuantizedHits();
+  testEviction();
+  testNotCacheable();
+  return testResult("testEvalCache");
+}
@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Extrapolation predictor: polynomial extrapolation of the solution history,
+// dropped solutions of rejected steps and the residual check deciding if an
+// extrapolated solution is accepted.
+
+#include <stdio.h>
+
+#include "acceptanceKernel.h"
+#include "onnxWrapper.h"
+#include "mlpModel.h"
+#include "testUtil.h"
+
+#define MAX_REL_ERROR 1e-8
+
+/* Residual of x(t) = a + b*t + c*t^2 at prediction x, checked like in the FMU */
+static int checkPrediction(const double* x, double t, double c) {
+  double res[2] = {x[0] - (1.0 + 2.0*t + c*t*t), x[1] - (-3.0*t)};
+  double scale[2] = {1.0, 1.0};
+  struct acceptanceResult result;
+
+  acceptanceKernelScaled(scale, res, 2, NULL, NULL, NULL, 0, &result);
+  return result.isRegular && result.norm <= MAX_REL_ERROR;
+}
+
+static void storeSolution(struct SolutionHistory* history, double t, double c) {
+  double* x = solutionHistorySlot(history, t);
+  x[0] = 1.0 + 2.0*t + c*t*t;
+  x[1] = -3.0*t;
+}
+
+static void testLinearTrajectory() {
+  struct SolutionHistory history;
+  double x[2];
+
+  initSolutionHistory(&history, 2);
+  CHECK(!extrapolateSolution(&history, EXTRAPOLATION_LINEAR, 0.0, x));
+  storeSolution(&history, 0.0, 0.0);
+  CHECK(!extrapolateSolution(&history, EXTRAPOLATION_LINEAR, 1.0, x));
+  storeSolution(&history, 0.5, 0.0);
+
+  CHECK(extrapolateSolution(&history, EXTRAPOLATION_LINEAR, 1.0, x));
+  CHECK_CLOSE(x[0], 3.0, 1e-12);
+  CHECK_CLOSE(x[1], -3.0, 1e-12);
+  recordExtrapolation(&history, checkPrediction(x, 1.0, 0.0));
+
+  /* Not enough solutions for quadratic extrapolation, none before time */
+  CHECK(!extrapolateSolution(&history, EXTRAPOLATION_QUADRATIC, 1.0, x));
+  CHECK(!extrapolateSolution(&history, EXTRAPOLATION_LINEAR, 0.25, x));
+
+  CHECK(history.nTries == 1);
+  CHECK(history.nAccepted == 1);
+  freeSolutionHistory(&history);
+}
+
+static void testQuadraticTrajectory() {
+  struct SolutionHistory history;
+  double x[2];
+
+  initSolutionHistory(&history, 2);
+  storeSolution(&history, 0.0, 1.0);
+  storeSolution(&history, 1.0, 1.0);
+  storeSolution(&history, 2.0, 1.0);
+
+  /* Line misses the parabola and is rejected, the parabola is accepted */
+  CHECK(extrapolateSolution(&history, EXTRAPOLATION_LINEAR, 3.0, x));
+  CHECK_CLOSE(x[0], 14.0, 1e-12);
+  recordExtrapolation(&history, checkPrediction(x, 3.0, 1.0));
+  CHECK(extrapolateSolution(&history, EXTRAPOLATION_QUADRATIC, 3.0, x));
+  CHECK_CLOSE(x[0], 16.0, 1e-12);
+  recordExtrapolation(&history, checkPrediction(x, 3.0, 1.0));
+
+  CHECK(history.nTries == 2);
+  CHECK(history.nAccepted == 1);
+  freeSolutionHistory(&history);
+}
+
+static void testRejectedStep() {
+  struct SolutionHistory history;
+  double x[2];
+
+  initSolutionHistory(&history, 2);
+  storeSolution(&history, 0.0, 0.0);
+  storeSolution(&history, 1.0, 0.0);
+  storeSolution(&history, 2.0, 0.0);
+
+  /* Step from 1 to 2 was rejected, solution at 2 belongs to another trajectory */
+  storeSolution(&history, 1.5, 1.0);
+  CHECK(history.count == 3);
+  CHECK(history.time[history.head] == 1.5);
+
+  /* Same time overwrites newest solution */
+  storeSolution(&history, 1.5, 0.0);
+  CHECK(history.count == 3);
+  CHECK(extrapolateSolution(&history, EXTRAPOLATION_QUADRATIC, 1.5, x));
+  CHECK_CLOSE(x[0], 4.0, 1e-12);
+
+  clearSolutionHistory(&history);
+  CHECK(!extrapolateSolution(&history, EXTRAPOLATION_LINEAR, 3.0, x));
+  CHECK(history.nTries == 0);
+  freeSolutionHistory(&history);
+}
+
+/* Checked extrapolation is counted and logged once, only if it decides the call */
+static void testTelemetry() {
+  const char* path = "testExtrapolation.onnx";
+  double values[NN_TELEMETRY_N];
+  int isRegular, inBounds;
+
+  CHECK(writeMLPModel(path, 2, 2, 4, 0));
+  struct OrtWrapperData* ortData = initOrtData("testExtrapolation", path, "testExtrapolation", 2, 2, 1, 1, NULL);
+  CHECK(ortData != NULL);
+  if (ortData == NULL) {
+    return;
+  }
+  ortData->max[0] = 1.0;
+  ortData->max[1] = 1.0;
+  ortData->input[0] = 2.0;
+  ortData->input[1] = 0.5;
+  ortData->res[0] = 1e-10;
+  ortData->res[1] = 0.0;
+  ortData->scaling.scale[0] = 1.0;
+  ortData->scaling.scale[1] = 1.0;
+  ortData->scaling.valid = 1;
+
+  /* Rejected extrapolation leaves no trace */
+  double norm = checkScaledResidual(ortData, &isRegular, &inBounds);
+  CHECK(isRegular);
+  CHECK(!inBounds);
+  CHECK(ortData->telemetry.nOutOfBounds == 0);
+
+  /* Accepted extrapolation */
+  recordResidualCheck(0.0, ortData, norm, isRegular, inBounds);
+  recordNNOutcome(&ortData->telemetry, NN_EXTRAPOLATED);
+  CHECK(nnTelemetryValues(ortData, values, NN_TELEMETRY_N) == NN_TELEMETRY_N);
+  CHECK(values[NN_TELEMETRY_CALLS] == 1);
+  CHECK(values[NN_TELEMETRY_EXTRAPOLATED] == 1);
+  CHECK(values[NN_TELEMETRY_ACCEPTED] == 0);
+  CHECK(values[NN_TELEMETRY_OUT_OF_BOUNDS] == 1);
+
+  deinitOrtData(ortData);
+  remove(path);
+  remove("testExtrapolation_residuum.csv");
+}
+
+int main() {
+  testLinearTrajectory();
+  testQuadraticTrajectory();
+  testRejectedStep();
+  testTelemetry();
+  return testResult("testExtrapolation");
+}
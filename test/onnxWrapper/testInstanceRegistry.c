@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Instance registry: instances are found by key from any thread, and the
+// instance a thread found last isn't returned after it was unregistered.
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "onnxWrapper.h"
+#include "testUtil.h"
+
+#define N_KEYS 10000
+
+static char keys[N_KEYS];
+static int instances[N_KEYS];
+
+static void testRegister() {
+  for (int i = 0; i < N_KEYS; i++) {
+    registerOrtInstance(&keys[i], &instances[i]);
+  }
+  for (int i = 0; i < N_KEYS; i++) {
+    CHECK(findOrtInstance(&keys[i]) == &instances[i]);
+  }
+  CHECK(findOrtInstance(NULL) == NULL);
+  CHECK(findOrtInstance(&instances[0]) == NULL);
+}
+
+static void testUnregister() {
+  int other = 0;
+
+  /* Remembered instance is dropped and the entry reused */
+  CHECK(findOrtInstance(&keys[0]) == &instances[0]);
+  unregisterOrtInstance(&keys[0]);
+  CHECK(findOrtInstance(&keys[0]) == NULL);
+  registerOrtInstance(&keys[0], &other);
+  CHECK(findOrtInstance(&keys[0]) == &other);
+
+  /* Unregistering another instance keeps all others */
+  unregisterOrtInstance(&keys[1]);
+  CHECK(findOrtInstance(&keys[0]) == &other);
+  CHECK(findOrtInstance(&keys[1]) == NULL);
+  CHECK(findOrtInstance(&keys[2]) == &instances[2]);
+  unregisterOrtInstance(&keys[1]);
+
+  unregisterOrtInstance(&keys[0]);
+  registerOrtInstance(&keys[0], &instances[0]);
+  registerOrtInstance(&keys[1], &instances[1]);
+}
+
+static void* findAll(void* arg) {
+  int* nFound = (int*) arg;
+  /* Second lookup is served by the instance the thread found last */
+  for (int i = 0; i < N_KEYS; i++) {
+    if (findOrtInstance(&keys[i]) == &instances[i] && findOrtInstance(&keys[i]) == &instances[i]) {
+      (*nFound)++;
+    }
+  }
+  return NULL;
+}
+
+static void testThreads() {
+  pthread_t threads[4];
+  int nFound[4] = {0};
+
+  for (int i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, findAll, &nFound[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+    CHECK(nFound[i] == N_KEYS);
+  }
+}
+
+int main() {
+  testRegister();
+  testUnregister();
+  testThreads();
+  for (int i = 0; i < N_KEYS; i++) {
+    unregisterOrtInstance(&keys[i]);
+    CHECK(findOrtInstance(&keys[i]) == NULL);
+  }
+  return testResult("testInstanceRegistry");
+}
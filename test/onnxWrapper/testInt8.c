@@ -0,0 +1,223 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// INT8 models: initOrtData has to load QDQ models in the layout written by
+// writeQuantizedOnnx of quantize.jl and evaluate them like the dequantized
+// float network.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "onnxWrapper.h"
+#include "mlpModel.h"
+#include "testUtil.h"
+
+#define N_LAYERS 2
+#define N_SAMPLES 20
+
+static const int64_t layerSize[N_LAYERS + 1] = {3, 6, 2};
+
+/* Quantized layer, see QuantizedLayer of quantize.jl */
+struct quantizedLayer {
+  int8_t* weights;                    /* Row-major, size nIn*nOut */
+  float weightScale;
+  float inputScale;
+  uint8_t inputZeroPoint;
+  float* bias;
+  int tanh;                           /* Tanh activation, last layer is linear */
+};
+
+/* Scalar or tensor initializer of any element type */
+static void qdqInitializer(struct pbBuffer* graph, const char* name, const int64_t* dims, int nDims,
+                           int dataType, const void* values, size_t size) {
+  struct pbBuffer tensor = {0};
+
+  for (int i = 0; i < nDims; i++) {
+    pbInt(&tensor, 1, dims[i]);
+  }
+  pbInt(&tensor, 2, dataType);
+  pbString(&tensor, 8, name);
+  pbBytes(&tensor, 9, values, size);
+  pbMessage(graph, 5, &tensor);
+}
+
+static int writeQDQModel(const char* path, const struct quantizedLayer* layers) {
+  struct pbBuffer graph = {0}, opset = {0}, model = {0};
+  char name[6][32], current[32] = "x", z[32], a[32];
+  const int8_t weightZeroPoint = 0;
+
+  for (int l = 0; l < N_LAYERS; l++) {
+    const int64_t nIn = layerSize[l], nOut = layerSize[l + 1];
+    const int64_t wDims[] = {nIn, nOut};
+    const int64_t bDims[] = {nOut};
+    const int isLast = l == N_LAYERS - 1;
+
+    snprintf(name[0], sizeof name[0], "x_scale%d", l + 1);
+    snprintf(name[1], sizeof name[1], "x_zero_point%d", l + 1);
+    snprintf(name[2], sizeof name[2], "W_quantized%d", l + 1);
+    snprintf(name[3], sizeof name[3], "W_scale%d", l + 1);
+    snprintf(name[4], sizeof name[4], "W_zero_point%d", l + 1);
+    snprintf(name[5], sizeof name[5], "b%d", l + 1);
+    qdqInitializer(&graph, name[0], NULL, 0, 1, &layers[l].inputScale, sizeof(float));
+    qdqInitializer(&graph, name[1], NULL, 0, 2, &layers[l].inputZeroPoint, 1);
+    qdqInitializer(&graph, name[2], wDims, 2, 3, layers[l].weights, nIn*nOut);
+    qdqInitializer(&graph, name[3], NULL, 0, 1, &layers[l].weightScale, sizeof(float));
+    qdqInitializer(&graph, name[4], NULL, 0, 3, &weightZeroPoint, 1);
+    qdqInitializer(&graph, name[5], bDims, 1, 1, layers[l].bias, nOut*sizeof(float));
+
+    char xq[32], xdq[32], w[32], m[32];
+    snprintf(xq, sizeof xq, "x_quantized%d", l + 1);
+    snprintf(xdq, sizeof xdq, "x_dequantized%d", l + 1);
+    snprintf(w, sizeof w, "W%d", l + 1);
+    snprintf(m, sizeof m, "m%d", l + 1);
+    snprintf(z, sizeof z, isLast && !layers[l].tanh ? "y" : "z%d", l + 1);
+    const char* quantize[] = {current, name[0], name[1]};
+    const char* dequantize[] = {xq, name[0], name[1]};
+    const char* dequantizeWeights[] = {name[2], name[3], name[4]};
+    const char* matMul[] = {xdq, w};
+    const char* add[] = {m, name[5]};
+    mlpNode(&graph, "QuantizeLinear", quantize, 3, xq);
+    mlpNode(&graph, "DequantizeLinear", dequantize, 3, xdq);
+    mlpNode(&graph, "DequantizeLinear", dequantizeWeights, 3, w);
+    mlpNode(&graph, "MatMul", matMul, 2, m);
+    mlpNode(&graph, "Add", add, 2, z);
+    snprintf(current, sizeof current, "%s", z);
+    if (layers[l].tanh) {
+      snprintf(a, sizeof a, isLast ? "y" : "a%d", l + 1);
+      const char* tanhInputs[] = {z};
+      mlpNode(&graph, "Tanh", tanhInputs, 1, a);
+      snprintf(current, sizeof current, "%s", a);
+    }
+  }
+  pbString(&graph, 2, "quantized");
+  mlpValueInfo(&graph, 11, "x", layerSize[0]);
+  mlpValueInfo(&graph, 12, "y", layerSize[N_LAYERS]);
+
+  pbInt(&model, 1, 7);                      /* ir_version */
+  pbString(&model, 2, "NonLinearSystemNeuralNetworkFMU");
+  pbString(&opset, 1, "");
+  pbInt(&opset, 2, 13);
+  pbMessage(&model, 8, &opset);
+  pbMessage(&model, 7, &graph);
+
+  FILE* file = fopen(path, "wb");
+  int success = file != NULL && fwrite(model.data, 1, model.len, file) == model.len;
+  if (file != NULL) {
+    fclose(file);
+  }
+  free(model.data);
+  return success;
+}
+
+/* QuantizeLinear followed by DequantizeLinear, in float like ONNX Runtime */
+static float fakeQuantize(float x, float scale, uint8_t zeroPoint) {
+  float q = nearbyintf(x / scale) + zeroPoint;
+  q = q < 0 ? 0 : q > 255 ? 255 : q;
+  return (q - zeroPoint) * scale;
+}
+
+static void evalReference(const struct quantizedLayer* layers, const double* input, double* output) {
+  float a[8], next[8];
+
+  for (int i = 0; i < layerSize[0]; i++) {
+    a[i] = (float) input[i];
+  }
+  for (int l = 0; l < N_LAYERS; l++) {
+    for (int j = 0; j < layerSize[l + 1]; j++) {
+      float m = 0;
+      for (int i = 0; i < layerSize[l]; i++) {
+        m += fakeQuantize(a[i], layers[l].inputScale, layers[l].inputZeroPoint)
+             * (layers[l].weights[i*layerSize[l + 1] + j] * layers[l].weightScale);
+      }
+      next[j] = m + layers[l].bias[j];
+      if (layers[l].tanh) {
+        next[j] = tanhf(next[j]);
+      }
+    }
+    for (int j = 0; j < layerSize[l + 1]; j++) {
+      a[j] = next[j];
+    }
+  }
+  for (int j = 0; j < layerSize[N_LAYERS]; j++) {
+    output[j] = a[j];
+  }
+}
+
+static void testLoadQDQ(const struct quantizedLayer* layers, int backend) {
+  struct OrtWrapperOptions options = defaultOrtWrapperOptions();
+  const char* path = "testInt8.onnx";
+  double expected[8];
+
+  options.backend = backend;
+  CHECK(writeQDQModel(path, layers));
+  struct OrtWrapperData* ortData = initOrtData("testInt8", path, "testInt8", layerSize[0], layerSize[N_LAYERS], 0, 1, &options);
+  CHECK(ortData != NULL);
+  if (ortData == NULL) {
+    return;
+  }
+  /* Dense MLP engine doesn't support QDQ nodes and falls back to ORT */
+  CHECK(ortData->mlp == NULL);
+  CHECK(ortData->session != NULL);
+
+  for (int sample = 0; sample < N_SAMPLES; sample++) {
+    for (int i = 0; i < layerSize[0]; i++) {
+      ortData->input[i] = 2.0 * rand() / RAND_MAX - 1.0;
+    }
+    evalModel(ortData);
+    evalReference(layers, ortData->input, expected);
+    for (int j = 0; j < layerSize[N_LAYERS]; j++) {
+      CHECK_CLOSE(ortData->x[j], expected[j], 1e-5);
+    }
+  }
+
+  deinitOrtData(ortData);
+  remove(path);
+}
+
+int main() {
+  struct quantizedLayer layers[N_LAYERS];
+
+  srand(42);
+  for (int l = 0; l < N_LAYERS; l++) {
+    const int64_t n = layerSize[l]*layerSize[l + 1];
+    layers[l].weights = malloc(n);
+    layers[l].bias = malloc(layerSize[l + 1]*sizeof(float));
+    for (int64_t i = 0; i < n; i++) {
+      layers[l].weights[i] = (int8_t)(rand() % 255 - 127);
+    }
+    for (int64_t j = 0; j < layerSize[l + 1]; j++) {
+      layers[l].bias[j] = (float)(0.2 * rand() / RAND_MAX - 0.1);
+    }
+    layers[l].weightScale = 1.0f / 127 / layerSize[l];
+    layers[l].inputScale = 2.0f / 255;
+    layers[l].inputZeroPoint = 128;
+    layers[l].tanh = l < N_LAYERS - 1;
+  }
+
+  testLoadQDQ(layers, ONNX_BACKEND_ORT);
+  testLoadQDQ(layers, ONNX_BACKEND_DENSE_MLP);
+
+  for (int l = 0; l < N_LAYERS; l++) {
+    free(layers[l].weights);
+    free(layers[l].bias);
+  }
+  return testResult("testInt8");
+}
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Session loader: every slot is created exactly once, no matter how many
+// loader threads and simulation threads ask for it, and instances of the
+// same model share one ORT session.
+
+#include <stdio.h>
+
+#include "onnxWrapper.h"
+#include "mlpModel.h"
+#include "testUtil.h"
+
+#define N_SLOTS 16
+#define N_MODELS 4
+
+/* Dummy ORT data, only the address is compared */
+static struct OrtWrapperData* dummyOrtData = (struct OrtWrapperData*) &testFailures;
+
+static struct OrtWrapperData* countingInit(void* userData) {
+  __atomic_fetch_add((int*) userData, 1, __ATOMIC_RELAXED);
+  return dummyOrtData;
+}
+
+static struct OrtWrapperData* failingInit(void* userData) {
+  __atomic_fetch_add((int*) userData, 1, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static struct OrtWrapperData* modelInit(void* userData) {
+  return initOrtData("testSessionLoader", (const char*) userData, "testSessionLoader", 2, 2, 0, 1, NULL);
+}
+
+static void testLoadOnce() {
+  struct ortDataSlot slots[N_SLOTS];
+  int nCalls[N_SLOTS] = {0};
+
+  for (int i = 0; i < N_SLOTS; i++) {
+    initOrtDataSlot(&slots[i], countingInit, &nCalls[i]);
+  }
+  struct sessionLoader* loader = startSessionLoader(slots, N_SLOTS, 4);
+
+  /* Simulation thread races with loader threads */
+  for (int i = N_SLOTS - 1; i >= 0; i--) {
+    struct OrtWrapperData* ortData = getOrtDataSlot(&slots[i], 1);
+    CHECK(ortData == NULL || ortData == dummyOrtData);
+  }
+  joinSessionLoader(loader);
+
+  for (int i = 0; i < N_SLOTS; i++) {
+    CHECK(nCalls[i] == 1);
+    CHECK(slots[i].state == ORT_SLOT_READY);
+    CHECK(getOrtDataSlot(&slots[i], 1) == dummyOrtData);
+    CHECK(!loadOrtDataSlot(&slots[i]));
+  }
+}
+
+static void testLazyAndFailed() {
+  struct ortDataSlot slot;
+  int nCalls = 0;
+
+  /* Without load nothing is created */
+  initOrtDataSlot(&slot, countingInit, &nCalls);
+  CHECK(getOrtDataSlot(&slot, 0) == NULL);
+  CHECK(slot.state == ORT_SLOT_EMPTY);
+  CHECK(nCalls == 0);
+  CHECK(getOrtDataSlot(&slot, 1) == dummyOrtData);
+  CHECK(nCalls == 1);
+
+  /* Failed creation is ready and not retried */
+  nCalls = 0;
+  initOrtDataSlot(&slot, failingInit, &nCalls);
+  CHECK(loadOrtDataSlot(&slot));
+  CHECK(slot.state == ORT_SLOT_READY);
+  CHECK(getOrtDataSlot(&slot, 1) == NULL);
+  CHECK(!loadOrtDataSlot(&slot));
+  CHECK(nCalls == 1);
+
+  /* No slots */
+  joinSessionLoader(startSessionLoader(NULL, 0, 4));
+  joinSessionLoader(NULL);
+}
+
+static void testSharedSessions() {
+  const char* paths[] = {"testSessionLoader_a.onnx", "testSessionLoader_b.onnx"};
+  struct ortDataSlot slots[N_MODELS];
+
+  srand(42);
+  CHECK(writeMLPModel(paths[0], 2, 2, 8, 1));
+  CHECK(writeMLPModel(paths[1], 2, 2, 8, 2));
+
+  /* Three instances of model a, one of model b, created in parallel */
+  for (int i = 0; i < N_MODELS; i++) {
+    initOrtDataSlot(&slots[i], modelInit, (void*) paths[i == N_MODELS - 1]);
+  }
+  joinSessionLoader(startSessionLoader(slots, N_MODELS, N_MODELS));
+
+  for (int i = 0; i < N_MODELS; i++) {
+    CHECK(slots[i].ortData != NULL);
+  }
+  if (slots[0].ortData != NULL && slots[N_MODELS - 1].ortData != NULL) {
+    for (int i = 1; i < N_MODELS - 1; i++) {
+      CHECK(slots[i].ortData != NULL && slots[i].ortData->session == slots[0].ortData->session);
+      CHECK(slots[i].ortData != slots[0].ortData);
+    }
+    CHECK(slots[N_MODELS - 1].ortData->session != slots[0].ortData->session);
+  }
+
+  /* Instances evaluate independently */
+  for (int i = 0; i < N_MODELS - 1; i++) {
+    if (slots[i].ortData != NULL) {
+      slots[i].ortData->input[0] = i;
+      slots[i].ortData->input[1] = -i;
+      evalModel(slots[i].ortData);
+    }
+  }
+  if (slots[0].ortData != NULL && slots[1].ortData != NULL) {
+    CHECK(slots[0].ortData->x[0] != slots[1].ortData->x[0]);
+  }
+
+  for (int i = 0; i < N_MODELS; i++) {
+    if (slots[i].ortData != NULL) {
+      deinitOrtData(slots[i].ortData);
+    }
+  }
+  remove(paths[0]);
+  remove(paths[1]);
+}
+
+int main() {
+  testLoadOnce();
+  testLazyAndFailed();
+  testSharedSessions();
+  return testResult("testSessionLoader");
+}
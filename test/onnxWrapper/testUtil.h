@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2023 Andreas Heuermann
+//
+// This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Checks shared by the onnxWrapper tests. A failed check is printed and
+// counted, the test returns a non-zero exit code if any check failed.
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <math.h>
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(expr)                                                         \
+  do {                                                                      \
+    if (!(expr)) {                                                          \
+      fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #expr); \
+      testFailures++;                                                       \
+    }                                                                       \
+  } while (0)
+
+#define CHECK_CLOSE(a, b, tol)                                              \
+  do {                                                                      \
+    double va = (a), vb = (b);                                              \
+    if (!(fabs(va - vb) <= (tol))) {                                        \
+      fprintf(stderr, "%s:%d: Check failed: %s = %g, %s = %g, tolerance %g\n", \
+              __FILE__, __LINE__, #a, va, #b, vb, (double) (tol));          \
+      testFailures++;                                                       \
+    }                                                                       \
+  } while (0)
+
+/* Exit code of test */
+static inline int testResult(const char* name) {
+  if (testFailures > 0) {
+    fprintf(stderr, "%s: %d checks failed\n", name, testFailures);
+    return 1;
+  }
+  printf("%s: passed\n", name);
+  return 0;
+}
+
+#endif // TEST_UTIL_H
@@ -0,0 +1,117 @@
+#
+# Copyright (c) 2022-2023 Andreas Heuermann
+#
+# This file is part of NonLinearSystemNeuralNetworkFMU.jl.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# NonLinearSystemNeuralNetworkFMU.jl is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with NonLinearSystemNeuralNetworkFMU.jl. If not, see <http://www.gnu.org/licenses/>.
+#
+
+import CSV
+import DataFrames
+import Libdl
+using NonLinearSystemNeuralNetworkFMU
+using Test
+
+"""
+Evaluate quantized layers like the QDQ model in ONNX Runtime, in Float32.
+"""
+function evalQuantizedLayers(layers::Vector{NonLinearSystemNeuralNetworkFMU.QuantizedLayer}, x::AbstractVector{Float64})
+  a = Float32.(x)
+  for layer in layers
+    q = clamp.(round.(a ./ layer.inputScale) .+ layer.inputZeroPoint, 0, 255)
+    xDequantized = (q .- layer.inputZeroPoint) .* layer.inputScale
+    W = Float32.(layer.weights) .* layer.weightScale
+    a = NonLinearSystemNeuralNetworkFMU.activate.(W * xDequantized .+ layer.bias, layer.activation)
+  end
+  return Float64.(a)
+end
+
+function runOnnxWrapperTests()
+  if Sys.iswindows()
+    @warn "Automated test for ONNX wrapper can't succeed on Windows. ORT is incompatbility with MSYS."
+  end
+
+  @assert haskey(ENV, "ORT_DIR") "Environamet variable `ORT_DIR` has to be set and point to ONNX Runtime directory for testing."
+
+  workDir = mktempdir()
+  lib = Libdl.dlopen(NonLinearSystemNeuralNetworkFMU.buildOnnxWrapperLib(joinpath(workDir, "build")))
+
+  @testset "Domain index" begin
+    usingVars = ["a", "b"]
+    boundary = NonLinearSystemNeuralNetworkFMU.MinMaxBoundaryValues([0.0, -1.0], [1.0, 1.0])
+    nBins = 4
+    csvFile = joinpath(workDir, "domain.csv")
+    indexFile = joinpath(workDir, "domain.bin")
+
+    # Cells (0,0), (2,2) and (3,3), points on min and max are inside, last point is outside
+    CSV.write(csvFile, DataFrames.DataFrame(a = [0.1, 0.0, 0.6, 1.0, 2.0],
+                                            b = [-0.9, -1.0, 0.2, 1.0, 0.0]))
+    @test writeDomainIndex(csvFile, usingVars, boundary, indexFile; nBins=nBins) == 3
+
+    index = ccall(Libdl.dlsym(lib, :loadDomainIndex), Ptr{Nothing}, (Cstring,), indexFile)
+    @test index != C_NULL
+    inIndex(x) = ccall(Libdl.dlsym(lib, :inDomainIndex), Cint, (Ptr{Nothing}, Ptr{Cdouble}), index, x) == 1
+
+    hits = [[0.1, -0.9], [0.2, -0.55], [0.0, -1.0], [0.6, 0.2], [0.5, 0.0], [0.75, 0.5], [1.0, 1.0], [0.8, 0.6]]
+    misses = [[0.9, -0.9], [0.3, 0.2], [0.5, -0.01], [prevfloat(0.75), 0.5], [nextfloat(1.0), 1.0],
+              [0.1, prevfloat(-1.0)], [2.0, 0.0], [NaN, 0.0]]
+    for x in hits
+      @test inIndex(x)
+      @test NonLinearSystemNeuralNetworkFMU.domainCellHash(x, boundary.min, boundary.max, nBins) !== nothing
+    end
+    for x in misses
+      @test !inIndex(x)
+    end
+    @test NonLinearSystemNeuralNetworkFMU.domainCellHash([nextfloat(1.0), 1.0], boundary.min, boundary.max, nBins) === nothing
+
+    ccall(Libdl.dlsym(lib, :freeDomainIndex), Cvoid, (Ptr{Nothing},), index)
+    @test ccall(Libdl.dlsym(lib, :loadDomainIndex), Ptr{Nothing}, (Cstring,), csvFile) == C_NULL
+  end
+
+  @testset "Quantized ONNX writer" begin
+    W1 = [0.5 -1.2; 0.3 0.8; -0.7 0.1]
+    W2 = [1.1 -0.4 0.6]
+    network = NonLinearSystemNeuralNetworkFMU.DenseNetwork(
+      [NonLinearSystemNeuralNetworkFMU.DenseLayer(W1, [0.1, -0.2, 0.05], :tanh),
+       NonLinearSystemNeuralNetworkFMU.DenseLayer(W2, [0.3], :none)],
+      false)
+    X = [range(0.0, 1.4, length=50)'; range(0.95, 3.15, length=50)']
+    layers = NonLinearSystemNeuralNetworkFMU.quantizeNetwork(network, X)
+    @test [size(layer.weights) for layer in layers] == [(3, 2), (1, 3)]
+
+    int8File = joinpath(workDir, "network.int8.onnx")
+    NonLinearSystemNeuralNetworkFMU.writeQuantizedOnnx(layers, int8File)
+    @test NonLinearSystemNeuralNetworkFMU.readDenseNetwork(int8File, 2, 1) isa String
+
+    ortData, predictions = NonLinearSystemNeuralNetworkFMU.wrapperPredictions(lib, int8File, X, 1, "onnxWrapperTest")
+    expected = reduce(hcat, [evalQuantizedLayers(layers, x) for x in eachcol(X)])
+    floatPredictions = reduce(hcat, [NonLinearSystemNeuralNetworkFMU.evalDenseNetwork(network, x) for x in eachcol(X)])
+    @test maximum(abs.(predictions .- expected)) < 1e-5
+    @test maximum(abs.(predictions .- floatPredictions)) < 0.05
+    ccall(Libdl.dlsym(lib, :deinitOrtData), Cvoid, (Ptr{Nothing},), ortData)
+  end
+
+  @testset "C tests" begin
+    testDir = joinpath(@__DIR__, "onnxWrapper")
+    buildDir = joinpath(workDir, "tests")
+    run(`cmake -S $(testDir) -B $(buildDir) -DORT_DIR=$(ENV["ORT_DIR"])`)
+    run(`cmake --build $(buildDir)`)
+    @test success(Cmd(`ctest --output-on-failure`; dir=buildDir))
+  end
+
+  Libdl.dlclose(lib)
+  rm(workDir, force=true, recursive=true)
+end
+
+runOnnxWrapperTests()
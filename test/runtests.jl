@@ -25,3 +25,4 @@ using SafeTestsets
 @safetestset "Generate data" begin include("genDataTest.jl") end
 @safetestset "Train ANN" begin include("trainNNTest.jl") end
 @safetestset "Generate ONNX FMU" begin include("includeOnnxTest.jl") end
+@safetestset "ONNX wrapper" begin include("onnxWrapperTest.jl") end